@@ -0,0 +1,146 @@
+#include "Adler32.h"
+#include "CpuFeatures.h"
+#include <emmintrin.h>
+#include <immintrin.h>
+
+#define ADLER32_BASE 65521
+//largest n such that 255n(n+1)/2 + (n+1)(BASE-1) fits in 32 bits, the modulo is only needed every NMAX bytes
+#define ADLER32_NMAX 5552
+
+typedef void (*ADLER32BLOCK)(DWORD* a, DWORD* b, const unsigned char* data, size_t len);
+
+//all kernels add len (<= NMAX) bytes to a and b without reducing them
+
+static void adler32_block_scalar(DWORD* pa, DWORD* pb, const unsigned char* data, size_t len)
+{
+    DWORD a = *pa, b = *pb;
+    while(len >= 8)
+    {
+        a += data[0];
+        b += a;
+        a += data[1];
+        b += a;
+        a += data[2];
+        b += a;
+        a += data[3];
+        b += a;
+        a += data[4];
+        b += a;
+        a += data[5];
+        b += a;
+        a += data[6];
+        b += a;
+        a += data[7];
+        b += a;
+        data += 8;
+        len -= 8;
+    }
+    while(len--)
+    {
+        a += *data++;
+        b += a;
+    }
+    *pa = a;
+    *pb = b;
+}
+
+TARGET_SSE2 static DWORD hsum_sse2(__m128i v)
+{
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return (DWORD)_mm_cvtsi128_si32(v);
+}
+
+TARGET_SSE2 static void adler32_block_sse2(DWORD* pa, DWORD* pb, const unsigned char* data, size_t len)
+{
+    size_t vlen = len & ~(size_t)15;
+    if(vlen)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        //byte i of a 16 byte vector contributes (16 - i) times to b
+        const __m128i weightslo = _mm_setr_epi16(16, 15, 14, 13, 12, 11, 10, 9);
+        const __m128i weightshi = _mm_setr_epi16(8, 7, 6, 5, 4, 3, 2, 1);
+        __m128i va = _mm_cvtsi32_si128((int)*pa);
+        __m128i vb = _mm_cvtsi32_si128((int)*pb);
+        __m128i vprev = zero; //sum of a before every vector, each one adds 16 * a to b
+        for(size_t i = 0; i < vlen; i += 16)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+            vprev = _mm_add_epi32(vprev, va);
+            va = _mm_add_epi32(va, _mm_sad_epu8(v, zero));
+            vb = _mm_add_epi32(vb, _mm_madd_epi16(_mm_unpacklo_epi8(v, zero), weightslo));
+            vb = _mm_add_epi32(vb, _mm_madd_epi16(_mm_unpackhi_epi8(v, zero), weightshi));
+        }
+        vb = _mm_add_epi32(vb, _mm_slli_epi32(vprev, 4));
+        *pa = hsum_sse2(va);
+        *pb = hsum_sse2(vb);
+    }
+    adler32_block_scalar(pa, pb, data + vlen, len - vlen);
+}
+
+TARGET_AVX2 static void adler32_block_avx2(DWORD* pa, DWORD* pb, const unsigned char* data, size_t len)
+{
+    size_t vlen = len & ~(size_t)31;
+    if(vlen)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i ones = _mm256_set1_epi16(1);
+        //byte i of a 32 byte vector contributes (32 - i) times to b
+        const __m256i weights = _mm256_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17,
+                                16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+        __m256i va = _mm256_setr_epi32((int)*pa, 0, 0, 0, 0, 0, 0, 0);
+        __m256i vb = _mm256_setr_epi32((int)*pb, 0, 0, 0, 0, 0, 0, 0);
+        __m256i vprev = zero;
+        for(size_t i = 0; i < vlen; i += 32)
+        {
+            __m256i v = _mm256_loadu_si256((const __m256i*)(data + i));
+            vprev = _mm256_add_epi32(vprev, va);
+            va = _mm256_add_epi32(va, _mm256_sad_epu8(v, zero));
+            vb = _mm256_add_epi32(vb, _mm256_madd_epi16(_mm256_maddubs_epi16(v, weights), ones));
+        }
+        vb = _mm256_add_epi32(vb, _mm256_slli_epi32(vprev, 5));
+        *pa = hsum_sse2(_mm_add_epi32(_mm256_castsi256_si128(va), _mm256_extracti128_si256(va, 1)));
+        *pb = hsum_sse2(_mm_add_epi32(_mm256_castsi256_si128(vb), _mm256_extracti128_si256(vb, 1)));
+    }
+    adler32_block_scalar(pa, pb, data + vlen, len - vlen);
+}
+
+static ADLER32BLOCK adler32_select_block()
+{
+    const cpu_features & features = cpu_get_features();
+    if(features.avx2)
+        return adler32_block_avx2;
+    if(features.sse2)
+        return adler32_block_sse2;
+    return adler32_block_scalar;
+}
+
+Adler32::Adler32()
+{
+    Reset();
+}
+
+void Adler32::Reset()
+{
+    a = 1;
+    b = 0;
+}
+
+void Adler32::Update(const unsigned char* data, size_t len)
+{
+    ADLER32BLOCK block = adler32_select_block();
+    while(len)
+    {
+        size_t n = len < ADLER32_NMAX ? len : ADLER32_NMAX;
+        block(&a, &b, data, n);
+        a %= ADLER32_BASE;
+        b %= ADLER32_BASE;
+        data += n;
+        len -= n;
+    }
+}
+
+DWORD Adler32::Digest() const
+{
+    return (b << 16) | a;
+}
@@ -0,0 +1,20 @@
+#ifndef _ADLER32_H
+#define _ADLER32_H
+
+#include <windows.h>
+
+//streaming Adler-32, feed the data in as many Update calls as needed
+class Adler32
+{
+public:
+    Adler32();
+    void Reset();
+    void Update(const unsigned char* data, size_t len);
+    DWORD Digest() const;
+
+private:
+    DWORD a;
+    DWORD b;
+};
+
+#endif //_ADLER32_H
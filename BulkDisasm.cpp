@@ -0,0 +1,238 @@
+#include "BulkDisasm.h"
+#include "ThreadPool.h"
+#include "pluginsdk\capstone\capstone.h"
+#include <algorithm>
+
+#define DUMP_MAX_INSTRUCTION 16
+#define DUMP_BYTES_WIDTH 20 //hex digits of the bytes column in text dumps
+
+#ifdef _WIN64
+#define DUMP_MODE CS_MODE_64
+#else
+#define DUMP_MODE CS_MODE_32
+#endif //_WIN64
+
+//decoded part of the range, instructions are recorded by where they start in the data
+struct dump_chunk
+{
+    size_t begin; //first offset to decode
+    size_t end; //instructions starting at or after end belong to the next chunk
+    size_t next; //offset after the last instruction
+    std::vector<size_t> offsets; //instruction starts
+    std::vector<size_t> textpos; //matching positions in text
+    std::string text; //formatted text lines or binary records
+    std::vector<size_t> invalid; //offsets of bytes that did not decode
+};
+
+static void puthex(std::string & out, ULONGLONG value, int digits)
+{
+    const char* hex = "0123456789ABCDEF";
+    for(int i = digits - 1; i >= 0; i--)
+        out.push_back(hex[(value >> (i * 4)) & 0xF]);
+}
+
+template<typename T>
+static void putvalue(std::string & out, T value)
+{
+    out.append((const char*)&value, sizeof(value));
+}
+
+//formats one instruction, insn is 0 for a byte that did not decode
+static void emit(csh handle, const cs_insn* insn, const unsigned char* data, ULONG_PTR addr, const dump_options & options, std::string & out)
+{
+    unsigned int size = insn ? insn->size : 1;
+    if(options.format == DUMP_BINARY)
+    {
+        out.push_back((char)size);
+        out.append((const char*)data, size);
+        putvalue(out, (unsigned short)(insn ? insn->id : 0));
+        if(options.detail)
+        {
+            unsigned char count = insn && insn->detail ? insn->detail->groups_count : 0;
+            out.push_back((char)count);
+            if(count)
+                out.append((const char*)insn->detail->groups, count);
+        }
+        return;
+    }
+
+    puthex(out, addr, sizeof(ULONG_PTR) * 2);
+    out.append("  ");
+    for(unsigned int i = 0; i < size; i++)
+        puthex(out, data[i], 2);
+    for(unsigned int i = size * 2; i < DUMP_BYTES_WIDTH; i++)
+        out.push_back(' ');
+    out.push_back(' ');
+    if(!insn)
+    {
+        out.append("db ");
+        puthex(out, data[0], 2);
+        out.push_back('\n');
+        return;
+    }
+    out.append(insn->mnemonic);
+    if(*insn->op_str)
+    {
+        out.push_back(' ');
+        out.append(insn->op_str);
+    }
+    if(options.detail && insn->detail && insn->detail->groups_count)
+    {
+        out.append("\t;");
+        for(unsigned char i = 0; i < insn->detail->groups_count; i++)
+        {
+            const char* name = cs_group_name(handle, insn->detail->groups[i]);
+            out.push_back(' ');
+            out.append(name ? name : "?");
+        }
+    }
+    out.push_back('\n');
+}
+
+//size of the instruction at offset, 0 for a byte that did not decode (it is dumped on its own)
+static size_t decode(csh handle, cs_insn* insn, const unsigned char* data, size_t size, ULONG_PTR start, size_t offset, const dump_options & options, std::string & out)
+{
+    const uint8_t* code = data + offset;
+    size_t codesize = size - offset + DUMP_MAX_INSTRUCTION - 1;
+    uint64_t address = start + offset;
+    if(cs_disasm_iter(handle, &code, &codesize, &address, insn))
+    {
+        emit(handle, insn, data + offset, start + offset, options, out);
+        return insn->size;
+    }
+    emit(handle, 0, data + offset, start + offset, options, out);
+    return 0;
+}
+
+static void decodechunk(csh handle, const unsigned char* data, size_t size, ULONG_PTR start, const dump_options & options, dump_chunk & chunk)
+{
+    cs_insn* insn = cs_malloc(handle);
+    //roughly four bytes and forty characters per instruction
+    chunk.offsets.reserve((chunk.end - chunk.begin) / 4);
+    chunk.textpos.reserve((chunk.end - chunk.begin) / 4);
+    chunk.text.reserve((chunk.end - chunk.begin) * (options.format == DUMP_TEXT ? 10 : 2));
+    size_t offset = chunk.begin;
+    while(offset < chunk.end)
+    {
+        chunk.offsets.push_back(offset);
+        chunk.textpos.push_back(chunk.text.size());
+        size_t length = decode(handle, insn, data, size, start, offset, options, chunk.text);
+        if(!length)
+        {
+            chunk.invalid.push_back(offset);
+            length = 1;
+        }
+        offset += length;
+    }
+    chunk.next = offset;
+    cs_free(insn, 1);
+}
+
+//a nominal boundary is moved behind the next run of int3 padding, which usually separates functions
+static size_t syncpoint(const unsigned char* data, size_t size, size_t boundary)
+{
+    size_t limit = boundary + DUMP_SYNC_SEARCH < size ? boundary + DUMP_SYNC_SEARCH : size;
+    for(size_t i = boundary; i + 1 < limit; i++)
+    {
+        if(data[i] != 0xCC || data[i + 1] != 0xCC)
+            continue;
+        while(i < size && data[i] == 0xCC)
+            i++;
+        return i;
+    }
+    return boundary;
+}
+
+bool disasm_dump(const unsigned char* data, size_t size, ULONG_PTR start, const dump_options & options, OutputSink & output, dump_stats & stats)
+{
+    memset(&stats, 0, sizeof(stats));
+    ThreadPool pool(options.threads);
+    std::vector<csh> handles(pool.Size(), 0);
+    bool opened = true;
+    for(size_t i = 0; i < handles.size() && opened; i++)
+    {
+        opened = cs_open(CS_ARCH_X86, DUMP_MODE, &handles[i]) == CS_ERR_OK;
+        if(opened && options.detail)
+            cs_option(handles[i], CS_OPT_DETAIL, CS_OPT_ON);
+    }
+
+    BufferedWriter out(output);
+    if(opened && options.format == DUMP_BINARY)
+    {
+        std::string header;
+        putvalue(header, (unsigned int)DUMP_BINARY_MAGIC);
+        putvalue(header, (unsigned int)(sizeof(ULONG_PTR) * 8));
+        putvalue(header, (ULONGLONG)start);
+        putvalue(header, (unsigned int)(options.detail ? 1 : 0));
+        out.Write(header.data(), header.size());
+    }
+
+    //one round is a chunk per worker, written in order before the next round starts so memory stays bounded
+    cs_insn* insn = opened ? cs_malloc(handles[0]) : 0;
+    std::vector<dump_chunk> chunks(handles.size());
+    std::string scratch;
+    size_t next = 0; //where the single threaded sweep would be
+    size_t boundary = 0;
+    while(opened && boundary < size && !out.Failed())
+    {
+        size_t count = 0;
+        for(; count < chunks.size() && boundary < size; count++)
+        {
+            dump_chunk & chunk = chunks[count];
+            chunk.begin = boundary;
+            chunk.end = size - boundary > DUMP_CHUNK_SIZE ? syncpoint(data, size, boundary + DUMP_CHUNK_SIZE) : size;
+            chunk.offsets.clear();
+            chunk.textpos.clear();
+            chunk.text.clear();
+            chunk.invalid.clear();
+            boundary = chunk.end;
+        }
+        for(size_t i = 0; i < count; i++)
+        {
+            csh handle = handles[i];
+            dump_chunk* chunk = &chunks[i];
+            pool.Enqueue([handle, data, size, start, &options, chunk]()
+            {
+                decodechunk(handle, data, size, start, options, *chunk);
+            });
+        }
+        pool.Wait();
+
+        for(size_t i = 0; i < count; i++)
+        {
+            const dump_chunk & chunk = chunks[i];
+            //the previous chunk ended inside an instruction, decode until both sweeps meet
+            size_t index = std::lower_bound(chunk.offsets.begin(), chunk.offsets.end(), next) - chunk.offsets.begin();
+            while(next < chunk.end && (index == chunk.offsets.size() || chunk.offsets[index] != next))
+            {
+                scratch.clear();
+                size_t length = decode(handles[0], insn, data, size, start, next, options, scratch);
+                if(!length)
+                {
+                    stats.invalid++;
+                    length = 1;
+                }
+                next += length;
+                out.Write(scratch.data(), scratch.size());
+                stats.instructions++;
+                stats.resynced++;
+                while(index < chunk.offsets.size() && chunk.offsets[index] < next)
+                    index++;
+            }
+            if(next >= chunk.end)
+                continue;
+            size_t textpos = chunk.textpos[index];
+            out.Write(chunk.text.data() + textpos, chunk.text.size() - textpos);
+            stats.instructions += chunk.offsets.size() - index;
+            stats.invalid += chunk.invalid.end() - std::lower_bound(chunk.invalid.begin(), chunk.invalid.end(), next);
+            next = chunk.next;
+        }
+    }
+
+    if(insn)
+        cs_free(insn, 1);
+    for(size_t i = 0; i < handles.size(); i++)
+        if(handles[i])
+            cs_close(&handles[i]);
+    return opened && out.Flush();
+}
@@ -0,0 +1,35 @@
+#ifndef _BULKDISASM_H
+#define _BULKDISASM_H
+
+#include <windows.h>
+#include "OutputSink.h"
+
+#define DUMP_CHUNK_SIZE 0x40000 //bytes decoded by one worker at a time
+#define DUMP_SYNC_SEARCH 0x100 //how far past a chunk boundary to look for int3 padding
+#define DUMP_BINARY_MAGIC 0x31534944 //DIS1
+
+enum dump_format
+{
+    DUMP_TEXT, //address, bytes and instruction text, one line per instruction
+    DUMP_BINARY //DUMP_BINARY_MAGIC, mode and start address followed by one record per instruction
+};
+
+struct dump_options
+{
+    dump_format format;
+    bool detail; //decode instruction groups as well, slower
+    size_t threads; //0 uses one thread per logical processor
+};
+
+struct dump_stats
+{
+    ULONGLONG instructions;
+    ULONGLONG invalid; //bytes that did not decode, dumped one at a time
+    ULONGLONG resynced; //instructions decoded again because a chunk did not start on an instruction
+};
+
+//linear sweep of size bytes at start, at least 15 readable bytes must follow data[size - 1]
+//chunks are decoded in parallel with one capstone handle per worker, the output matches a single threaded sweep
+bool disasm_dump(const unsigned char* data, size_t size, ULONG_PTR start, const dump_options & options, OutputSink & output, dump_stats & stats);
+
+#endif //_BULKDISASM_H
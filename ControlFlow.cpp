@@ -0,0 +1,433 @@
+#include "ControlFlow.h"
+#include <algorithm>
+
+ControlFlowGraph::ControlFlowGraph()
+{
+    Clear();
+}
+
+void ControlFlowGraph::Clear()
+{
+    entryPoint = 0;
+    nodes.clear();
+    instrs.clear();
+    exits.clear();
+    decoded = 0;
+}
+
+bool ControlFlowGraph::Build(ULONG_PTR entry, ULONG_PTR start, ULONG_PTR end, InstrDecoder & decoder)
+{
+    return Run(entry, start, end, decoder, std::vector<cfg_instr>(), RANGELIST());
+}
+
+bool ControlFlowGraph::Rebuild(const std::vector<std::pair<ULONG_PTR, ULONG_PTR>> & patched, ULONG_PTR start, ULONG_PTR end, InstrDecoder & decoder)
+{
+    std::vector<cfg_instr> previous;
+    previous.swap(instrs);
+    return Run(entryPoint, start, end, decoder, previous, patched);
+}
+
+//previous instruction at addr when none of its bytes were patched
+static const cfg_instr* reusable(ULONG_PTR addr, const std::vector<cfg_instr> & previous, const std::vector<std::pair<ULONG_PTR, ULONG_PTR>> & patched)
+{
+    std::vector<cfg_instr>::const_iterator found = std::lower_bound(previous.begin(), previous.end(), addr, [](const cfg_instr & instr, ULONG_PTR addr)
+    {
+        return instr.addr < addr;
+    });
+    if(found == previous.end() || found->addr != addr)
+        return 0;
+    //first patch ending at or after the instruction start
+    std::vector<std::pair<ULONG_PTR, ULONG_PTR>>::const_iterator patch = std::lower_bound(patched.begin(), patched.end(), addr, [](const std::pair<ULONG_PTR, ULONG_PTR> & range, ULONG_PTR addr)
+    {
+        return range.second < addr;
+    });
+    if(patch != patched.end() && patch->first < addr + found->size)
+        return 0;
+    return &*found;
+}
+
+bool ControlFlowGraph::Run(ULONG_PTR entry, ULONG_PTR start, ULONG_PTR end, InstrDecoder & decoder, const std::vector<cfg_instr> & previous, const RANGELIST & patched)
+{
+    Clear();
+    if(entry < start || entry > end)
+        return false;
+    entryPoint = entry;
+    LeaderBitmap leaders(start, end);
+    TABLELIST tables;
+    Decode(entry, start, end, decoder, previous, patched, leaders, tables);
+    if(instrs.empty())
+        return false;
+    std::stable_sort(tables.begin(), tables.end(), [](const std::pair<ULONG_PTR, ULONG_PTR> & a, const std::pair<ULONG_PTR, ULONG_PTR> & b)
+    {
+        return a.first < b.first;
+    });
+    Split(leaders, tables, start, end);
+    return true;
+}
+
+size_t ControlFlowGraph::FindNode(ULONG_PTR start) const
+{
+    size_t lo = 0, hi = nodes.size();
+    while(lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if(nodes[mid].start < start)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo < nodes.size() && nodes[lo].start == start ? lo : nodes.size();
+}
+
+//only conditional jumps have labeled exits, brtrue is always stored first
+cfg_edge ControlFlowGraph::ExitType(const cfg_node & node, size_t index) const
+{
+    if(!node.brfalse || node.split)
+        return EDGE_PLAIN;
+    return index == 0 && node.brtrue ? EDGE_TRUE : EDGE_FALSE;
+}
+
+#define CFG_SAVE_MAGIC 0x31474643 //CFG1
+
+static void put32(std::vector<unsigned char> & data, unsigned int value)
+{
+    data.insert(data.end(), (unsigned char*)&value, (unsigned char*)&value + sizeof(value));
+}
+
+static void put64(std::vector<unsigned char> & data, ULONGLONG value)
+{
+    data.insert(data.end(), (unsigned char*)&value, (unsigned char*)&value + sizeof(value));
+}
+
+//bounds checked reader for Load
+struct save_reader
+{
+    const unsigned char* data;
+    size_t size;
+    bool failed;
+
+    template<typename T>
+    T get()
+    {
+        T value = 0;
+        if(size < sizeof(T))
+            failed = true;
+        else
+        {
+            memcpy(&value, data, sizeof(T));
+            data += sizeof(T);
+            size -= sizeof(T);
+        }
+        return value;
+    }
+};
+
+//0 (no address) stays 0, everything else is relative to base with wrap-around
+static ULONGLONG tobase(ULONG_PTR addr, ULONG_PTR base)
+{
+    return addr ? (ULONGLONG)(ULONG_PTR)(addr - base) : 0;
+}
+
+static ULONG_PTR frombase(ULONGLONG offset, ULONG_PTR base)
+{
+    return offset ? (ULONG_PTR)offset + base : 0;
+}
+
+void ControlFlowGraph::Save(ULONG_PTR base, std::vector<unsigned char> & data) const
+{
+    data.reserve(data.size() + 16 + nodes.size() * 41 + instrs.size() * 26 + exits.size() * 8);
+    put32(data, CFG_SAVE_MAGIC);
+    put32(data, (unsigned int)nodes.size());
+    put32(data, (unsigned int)instrs.size());
+    put32(data, (unsigned int)exits.size());
+    put64(data, tobase(entryPoint, base));
+    for(size_t i = 0; i < instrs.size(); i++)
+    {
+        const cfg_instr & instr = instrs[i];
+        put64(data, tobase(instr.addr, base));
+        put64(data, tobase(instr.target, base));
+        put64(data, tobase(instr.table, base));
+        data.push_back((unsigned char)instr.size);
+        data.push_back((unsigned char)instr.flow);
+    }
+    //firstInstr and firstExit follow from the counts
+    for(size_t i = 0; i < nodes.size(); i++)
+    {
+        const cfg_node & node = nodes[i];
+        put64(data, tobase(node.start, base));
+        put64(data, tobase(node.end, base));
+        put64(data, tobase(node.brtrue, base));
+        put64(data, tobase(node.brfalse, base));
+        put32(data, (unsigned int)node.icount);
+        put32(data, (unsigned int)node.exitCount);
+        data.push_back((unsigned char)((node.terminal ? 1 : 0) | (node.split ? 2 : 0)));
+    }
+    for(size_t i = 0; i < exits.size(); i++)
+        put64(data, tobase(exits[i], base));
+}
+
+bool ControlFlowGraph::Load(ULONG_PTR base, const unsigned char* data, size_t size)
+{
+    Clear();
+    save_reader in = { data, size, false };
+    if(in.get<unsigned int>() != CFG_SAVE_MAGIC)
+        return false;
+    size_t nodecount = in.get<unsigned int>();
+    size_t instrcount = in.get<unsigned int>();
+    size_t exitcount = in.get<unsigned int>();
+    entryPoint = frombase(in.get<ULONGLONG>(), base);
+    if(in.failed || in.size < instrcount * 26 + nodecount * 41 + exitcount * 8)
+        return false;
+    instrs.resize(instrcount);
+    for(size_t i = 0; i < instrcount; i++)
+    {
+        cfg_instr & instr = instrs[i];
+        instr.addr = frombase(in.get<ULONGLONG>(), base);
+        instr.target = frombase(in.get<ULONGLONG>(), base);
+        instr.table = frombase(in.get<ULONGLONG>(), base);
+        instr.size = in.get<unsigned char>();
+        instr.flow = (cfg_flow)in.get<unsigned char>();
+    }
+    nodes.resize(nodecount);
+    size_t firstInstr = 0, firstExit = 0;
+    for(size_t i = 0; i < nodecount; i++)
+    {
+        cfg_node & node = nodes[i];
+        node.start = frombase(in.get<ULONGLONG>(), base);
+        node.end = frombase(in.get<ULONGLONG>(), base);
+        node.brtrue = frombase(in.get<ULONGLONG>(), base);
+        node.brfalse = frombase(in.get<ULONGLONG>(), base);
+        node.icount = in.get<unsigned int>();
+        node.exitCount = in.get<unsigned int>();
+        unsigned char flags = in.get<unsigned char>();
+        node.terminal = (flags & 1) != 0;
+        node.split = (flags & 2) != 0;
+        node.firstInstr = firstInstr;
+        node.firstExit = firstExit;
+        firstInstr += node.icount;
+        firstExit += node.exitCount;
+    }
+    exits.resize(exitcount);
+    for(size_t i = 0; i < exitcount; i++)
+        exits[i] = frombase(in.get<ULONGLONG>(), base);
+    if(in.failed || firstInstr > instrcount || firstExit != exitcount)
+    {
+        Clear();
+        return false;
+    }
+    return true;
+}
+
+#ifdef _WIN32
+//filled through the C structures, the BridgeCFGraph classes only exist for MSVC
+BridgeCFGraphList ControlFlowGraph::ToGraphList() const
+{
+    std::vector<BridgeCFNodeList> nodeList(nodes.size());
+    std::vector<duint> nodeExits;
+    for(size_t i = 0; i < nodes.size(); i++)
+    {
+        const cfg_node & node = nodes[i];
+        BridgeCFNodeList & bridgeNode = nodeList[i];
+        memset(&bridgeNode, 0, sizeof(bridgeNode));
+        bridgeNode.parentGraph = entryPoint;
+        bridgeNode.start = node.start;
+        bridgeNode.end = node.end;
+        //the GUI expects every edge to end in a block, targets that did not decode are left out
+        bridgeNode.brtrue = FindNode(node.brtrue) != nodes.size() ? node.brtrue : 0;
+        bridgeNode.brfalse = FindNode(node.brfalse) != nodes.size() ? node.brfalse : 0;
+        bridgeNode.icount = node.icount;
+        bridgeNode.terminal = node.terminal;
+        bridgeNode.split = node.split;
+        nodeExits.clear();
+        for(size_t j = 0; j < node.exitCount; j++)
+            if(FindNode(Exit(node, j)) != nodes.size())
+                nodeExits.push_back(Exit(node, j));
+        BridgeList<duint>::CopyData(&bridgeNode.exits, nodeExits);
+        BridgeList<unsigned char>::CopyData(&bridgeNode.data, std::vector<unsigned char>());
+    }
+    BridgeCFGraphList graph;
+    graph.entryPoint = entryPoint;
+    graph.userdata = 0;
+    BridgeList<BridgeCFNodeList>::CopyData(&graph.nodes, nodeList);
+    return graph;
+}
+#endif //_WIN32
+
+//first pass - decode along every path from the entry, each address once
+void ControlFlowGraph::Decode(ULONG_PTR entry, ULONG_PTR start, ULONG_PTR end, InstrDecoder & decoder, const std::vector<cfg_instr> & previous, const RANGELIST & patched, LeaderBitmap & leaders, TABLELIST & tables)
+{
+    LeaderBitmap visited(start, end);
+    std::vector<ULONG_PTR> worklist(1, entry);
+    leaders.Set(entry);
+    while(!worklist.empty())
+    {
+        ULONG_PTR addr = worklist.back();
+        worklist.pop_back();
+        while(addr >= start && addr <= end && !visited.Test(addr))
+        {
+            cfg_instr instr;
+            const cfg_instr* known = previous.empty() ? 0 : reusable(addr, previous, patched);
+            if(known)
+                instr = *known;
+            else
+            {
+                memset(&instr, 0, sizeof(instr));
+                decoded++;
+                if(!decoder.Decode(addr, instr) || !instr.size)
+                    break;
+                instr.addr = addr;
+            }
+            visited.Set(addr);
+            instrs.push_back(instr);
+
+            bool inrange = instr.target >= start && instr.target <= end;
+            if(instr.flow == FLOW_JUMP || instr.flow == FLOW_CONDITIONAL)
+            {
+                if(inrange)
+                {
+                    leaders.Set(instr.target);
+                    worklist.push_back(instr.target);
+                }
+                if(instr.flow == FLOW_JUMP)
+                    break;
+                leaders.Set(addr + instr.size);
+            }
+            else if(instr.flow == FLOW_INDIRECT)
+            {
+                //heuristic: a table of absolute pointers into the range, ended by the first entry outside of it
+                for(size_t i = 0; instr.table && i < CFG_MAX_TABLE_ENTRIES; i++)
+                {
+                    ULONG_PTR target;
+                    if(!decoder.ReadPointer(instr.table + i * sizeof(ULONG_PTR), target) || target < start || target > end)
+                        break;
+                    tables.push_back(std::make_pair(addr, target));
+                    leaders.Set(target);
+                    worklist.push_back(target);
+                }
+                break;
+            }
+            else if(instr.flow == FLOW_RETURN)
+                break;
+            addr += instr.size;
+        }
+    }
+    std::sort(instrs.begin(), instrs.end(), [](const cfg_instr & a, const cfg_instr & b)
+    {
+        return a.addr < b.addr;
+    });
+    //a jump into the middle of an instruction decodes a second, overlapping stream
+    //the instruction after the overlapped one starts a block, so its fall through edge has a destination
+    for(size_t i = 1; i < instrs.size(); i++)
+    {
+        ULONG_PTR next = instrs[i - 1].addr + instrs[i - 1].size;
+        if(next > instrs[i].addr && next <= end)
+            leaders.Set(next);
+    }
+}
+
+static bool hasinstr(const std::vector<cfg_instr> & instrs, ULONG_PTR addr)
+{
+    std::vector<cfg_instr>::const_iterator found = std::lower_bound(instrs.begin(), instrs.end(), addr, [](const cfg_instr & instr, ULONG_PTR addr)
+    {
+        return instr.addr < addr;
+    });
+    return found != instrs.end() && found->addr == addr;
+}
+
+//second pass - cut the sorted instructions into blocks at leaders, branches and gaps
+void ControlFlowGraph::Split(const LeaderBitmap & leaders, const TABLELIST & tables, ULONG_PTR start, ULONG_PTR end)
+{
+    ULONG_PTR nextleader = 0;
+    bool more = leaders.Next(start, nextleader);
+    size_t nexttable = 0;
+    bool open = false;
+    for(size_t i = 0; i < instrs.size(); i++)
+    {
+        const cfg_instr & instr = instrs[i];
+        if(more && nextleader < instr.addr)
+            more = leaders.Next(instr.addr, nextleader);
+        bool leader = more && nextleader == instr.addr;
+        if(open)
+        {
+            const cfg_instr & prev = instrs[i - 1];
+            ULONG_PTR fallthrough = prev.addr + prev.size;
+            bool contiguous = fallthrough == instr.addr;
+            if(leader || !contiguous)
+            {
+                //instr overlaps prev, which still falls through to the instruction after it
+                if(contiguous || (instr.addr < fallthrough && hasinstr(instrs, fallthrough)))
+                {
+                    cfg_node & node = nodes.back();
+                    node.split = true;
+                    node.brtrue = fallthrough;
+                    exits.push_back(fallthrough);
+                    node.exitCount++;
+                }
+                open = false;
+            }
+        }
+        if(!open)
+        {
+            cfg_node node;
+            memset(&node, 0, sizeof(node));
+            node.start = instr.addr;
+            node.firstInstr = i;
+            node.firstExit = exits.size();
+            nodes.push_back(node);
+            open = true;
+        }
+
+        cfg_node & node = nodes.back();
+        node.end = instr.addr;
+        node.icount++;
+        ULONG_PTR next = instr.addr + instr.size;
+        bool inrange = instr.target >= start && instr.target <= end;
+        switch(instr.flow)
+        {
+        case FLOW_JUMP:
+            if(inrange)
+            {
+                node.brtrue = instr.target;
+                exits.push_back(instr.target);
+                node.exitCount++;
+            }
+            open = false;
+            break;
+
+        case FLOW_CONDITIONAL:
+            if(inrange)
+            {
+                node.brtrue = instr.target;
+                exits.push_back(instr.target);
+                node.exitCount++;
+            }
+            if(next <= end)
+            {
+                node.brfalse = next;
+                exits.push_back(next);
+                node.exitCount++;
+            }
+            open = false;
+            break;
+
+        case FLOW_INDIRECT:
+            while(nexttable < tables.size() && tables[nexttable].first < instr.addr)
+                nexttable++;
+            for(; nexttable < tables.size() && tables[nexttable].first == instr.addr; nexttable++)
+            {
+                exits.push_back(tables[nexttable].second);
+                node.exitCount++;
+            }
+            open = false;
+            break;
+
+        case FLOW_RETURN:
+            node.terminal = true;
+            open = false;
+            break;
+
+        default:
+            break;
+        }
+    }
+}
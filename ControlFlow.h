@@ -0,0 +1,109 @@
+#ifndef _CONTROLFLOW_H
+#define _CONTROLFLOW_H
+
+#include <windows.h>
+#include <utility>
+#include <vector>
+#include "LeaderBitmap.h"
+#ifdef _WIN32
+#include "pluginsdk\bridgemain.h"
+#endif //_WIN32
+
+//how an instruction passes control on
+enum cfg_flow
+{
+    FLOW_NORMAL, //falls through
+    FLOW_CALL, //falls through after the call returns
+    FLOW_JUMP, //unconditional direct jump
+    FLOW_CONDITIONAL, //direct jump or fall through
+    FLOW_INDIRECT, //jump through a register or memory (jump tables)
+    FLOW_RETURN //ends the path (ret, int3, hlt, ...)
+};
+
+struct cfg_instr
+{
+    ULONG_PTR addr;
+    ULONG_PTR target; //direct branch or call destination, 0 if none
+    ULONG_PTR table; //memory operand of an indirect jump, 0 if none
+    unsigned int size;
+    cfg_flow flow;
+};
+
+//label of a node exit
+enum cfg_edge
+{
+    EDGE_PLAIN,
+    EDGE_FALSE,
+    EDGE_TRUE
+};
+
+//basic block, its instructions are ControlFlowGraph::Instr(firstInstr) onwards
+struct cfg_node
+{
+    ULONG_PTR start; //first instruction
+    ULONG_PTR end; //last instruction
+    ULONG_PTR brtrue; //jump destination, or the next node on a split
+    ULONG_PTR brfalse; //fall through of a conditional jump
+    size_t firstInstr;
+    size_t icount;
+    size_t firstExit;
+    size_t exitCount; //every successor, including brtrue and brfalse
+    bool terminal; //node ends in a return
+    bool split; //node falls into the next leader without a branch
+};
+
+//decoding backend, instructions are only requested for reachable addresses
+class InstrDecoder
+{
+public:
+    virtual ~InstrDecoder() {}
+    virtual bool Decode(ULONG_PTR addr, cfg_instr & instr) = 0; //false on undecodable bytes
+    virtual bool ReadPointer(ULONG_PTR addr, ULONG_PTR & value) = 0; //used for jump tables
+};
+
+#define CFG_MAX_TABLE_ENTRIES 1024
+
+//control flow graph of the code reachable from an entry point, stored in flat arrays
+class ControlFlowGraph
+{
+public:
+    ControlFlowGraph();
+    void Clear();
+    //follows every path from entry, only decoding inside [start, end]
+    bool Build(ULONG_PTR entry, ULONG_PTR start, ULONG_PTR end, InstrDecoder & decoder);
+    //follows the paths again after the bytes in patched (sorted inclusive ranges) changed
+    //instructions that do not touch a patched byte are taken from this graph instead of being decoded again
+    bool Rebuild(const std::vector<std::pair<ULONG_PTR, ULONG_PTR>> & patched, ULONG_PTR start, ULONG_PTR end, InstrDecoder & decoder);
+    size_t DecodeCount() const { return decoded; } //instructions the last Build or Rebuild passed to the decoder
+    ULONG_PTR EntryPoint() const { return entryPoint; }
+    size_t NodeCount() const { return nodes.size(); }
+    const cfg_node & Node(size_t index) const { return nodes[index]; }
+    size_t InstrCount() const { return instrs.size(); }
+    const cfg_instr & Instr(size_t index) const { return instrs[index]; }
+    ULONG_PTR Exit(const cfg_node & node, size_t index) const { return exits[node.firstExit + index]; }
+    cfg_edge ExitType(const cfg_node & node, size_t index) const;
+    size_t FindNode(ULONG_PTR start) const; //index of the node starting at start, NodeCount() if none
+    //compact binary form, addresses are stored relative to base so a rebased module loads the same data
+    void Save(ULONG_PTR base, std::vector<unsigned char> & data) const;
+    bool Load(ULONG_PTR base, const unsigned char* data, size_t size);
+#ifdef _WIN32
+    BridgeCFGraphList ToGraphList() const; //x64dbg graph list for GuiLoadGraph, the block data is left empty
+#endif //_WIN32
+
+private:
+    typedef std::vector<std::pair<ULONG_PTR, ULONG_PTR>> TABLELIST; //indirect jump -> table entry
+
+    typedef std::vector<std::pair<ULONG_PTR, ULONG_PTR>> RANGELIST;
+
+    bool Run(ULONG_PTR entry, ULONG_PTR start, ULONG_PTR end, InstrDecoder & decoder, const std::vector<cfg_instr> & previous, const RANGELIST & patched);
+    void Decode(ULONG_PTR entry, ULONG_PTR start, ULONG_PTR end, InstrDecoder & decoder, const std::vector<cfg_instr> & previous, const RANGELIST & patched, LeaderBitmap & leaders, TABLELIST & tables);
+    void Split(const LeaderBitmap & leaders, const TABLELIST & tables, ULONG_PTR start, ULONG_PTR end);
+
+    ULONG_PTR entryPoint;
+    std::vector<cfg_node> nodes; //sorted by start
+    std::vector<cfg_instr> instrs; //sorted by address
+    std::vector<ULONG_PTR> exits;
+    size_t decoded;
+};
+
+#endif //_CONTROLFLOW_H
@@ -0,0 +1,70 @@
+#include "CpuFeatures.h"
+#include <string.h>
+#include <mutex>
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <immintrin.h>
+#else
+#include <cpuid.h>
+#endif //_MSC_VER
+
+static void cpuid(int leaf, int subleaf, int regs[4])
+{
+#ifdef _MSC_VER
+    __cpuidex(regs, leaf, subleaf);
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif //_MSC_VER
+}
+
+static unsigned long long xgetbv0()
+{
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    unsigned int eax, edx;
+    __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((unsigned long long)edx << 32) | eax;
+#endif //_MSC_VER
+}
+
+static cpu_features detect()
+{
+    cpu_features features;
+    memset(&features, 0, sizeof(features));
+    int regs[4];
+    cpuid(0, 0, regs);
+    int maxleaf = regs[0];
+    if(maxleaf < 1)
+        return features;
+    cpuid(1, 0, regs);
+    features.sse2 = (regs[3] & (1 << 26)) != 0;
+    features.ssse3 = (regs[2] & (1 << 9)) != 0;
+    features.sse41 = (regs[2] & (1 << 19)) != 0;
+    features.sse42 = (regs[2] & (1 << 20)) != 0;
+    bool osxsave = (regs[2] & (1 << 27)) != 0;
+    bool avx = (regs[2] & (1 << 28)) != 0;
+    //the OS has to save the YMM state before AVX2 code can be used
+    bool ymmstate = osxsave && avx && (xgetbv0() & 6) == 6;
+    if(maxleaf >= 7)
+    {
+        cpuid(7, 0, regs);
+        features.avx2 = ymmstate && (regs[1] & (1 << 5)) != 0;
+        features.sha = (regs[1] & (1 << 29)) != 0;
+    }
+    return features;
+}
+
+static cpu_features features;
+static std::once_flag features_once;
+
+static void detectonce()
+{
+    features = detect();
+}
+
+const cpu_features & cpu_get_features()
+{
+    std::call_once(features_once, detectonce);
+    return features;
+}
@@ -0,0 +1,30 @@
+#ifndef _CPUFEATURES_H
+#define _CPUFEATURES_H
+
+//attribute to compile a single function for a wider instruction set (GCC needs it, MSVC does not)
+#ifdef _MSC_VER
+#define TARGET_SSE2
+#define TARGET_SSE42
+#define TARGET_AVX2
+#define TARGET_SHA
+#else
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_SSE42 __attribute__((target("sse4.2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_SHA __attribute__((target("sha,sse4.1")))
+#endif //_MSC_VER
+
+struct cpu_features
+{
+    bool sse2;
+    bool ssse3;
+    bool sse41;
+    bool sse42;
+    bool avx2;
+    bool sha;
+};
+
+//detected once, safe to call from any thread afterwards
+const cpu_features & cpu_get_features();
+
+#endif //_CPUFEATURES_H
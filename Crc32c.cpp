@@ -0,0 +1,110 @@
+#include "Crc32c.h"
+#include "CpuFeatures.h"
+#include <nmmintrin.h>
+
+#define CRC32C_POLY 0x82F63B78
+
+typedef DWORD (*CRC32CUPDATE)(DWORD crc, const unsigned char* data, size_t len);
+
+//slicing-by-8 tables for the software fallback
+static DWORD crc32c_table[8][256];
+static volatile bool crc32c_table_ready = false;
+
+static void crc32c_init_table()
+{
+    for(DWORD i = 0; i < 256; i++)
+    {
+        DWORD crc = i;
+        for(int j = 0; j < 8; j++)
+            crc = (crc >> 1) ^ (CRC32C_POLY & (0 - (crc & 1)));
+        crc32c_table[0][i] = crc;
+    }
+    for(DWORD i = 0; i < 256; i++)
+        for(int t = 1; t < 8; t++)
+            crc32c_table[t][i] = (crc32c_table[t - 1][i] >> 8) ^ crc32c_table[0][crc32c_table[t - 1][i] & 0xFF];
+    crc32c_table_ready = true;
+}
+
+static DWORD crc32c_update_sw(DWORD crc, const unsigned char* data, size_t len)
+{
+    if(!crc32c_table_ready)
+        crc32c_init_table();
+    while(len && ((ULONG_PTR)data & 7))
+    {
+        crc = (crc >> 8) ^ crc32c_table[0][(crc ^ *data++) & 0xFF];
+        len--;
+    }
+    while(len >= 8)
+    {
+        DWORD lo = *(const DWORD*)data ^ crc;
+        DWORD hi = *(const DWORD*)(data + 4);
+        crc = crc32c_table[7][lo & 0xFF] ^ crc32c_table[6][(lo >> 8) & 0xFF] ^
+              crc32c_table[5][(lo >> 16) & 0xFF] ^ crc32c_table[4][lo >> 24] ^
+              crc32c_table[3][hi & 0xFF] ^ crc32c_table[2][(hi >> 8) & 0xFF] ^
+              crc32c_table[1][(hi >> 16) & 0xFF] ^ crc32c_table[0][hi >> 24];
+        data += 8;
+        len -= 8;
+    }
+    while(len--)
+        crc = (crc >> 8) ^ crc32c_table[0][(crc ^ *data++) & 0xFF];
+    return crc;
+}
+
+TARGET_SSE42 static DWORD crc32c_update_hw(DWORD crc, const unsigned char* data, size_t len)
+{
+    while(len && ((ULONG_PTR)data & 7))
+    {
+        crc = _mm_crc32_u8(crc, *data++);
+        len--;
+    }
+#ifdef _WIN64
+    unsigned long long crc64 = crc;
+    while(len >= 32)
+    {
+        crc64 = _mm_crc32_u64(crc64, *(const unsigned long long*)data);
+        crc64 = _mm_crc32_u64(crc64, *(const unsigned long long*)(data + 8));
+        crc64 = _mm_crc32_u64(crc64, *(const unsigned long long*)(data + 16));
+        crc64 = _mm_crc32_u64(crc64, *(const unsigned long long*)(data + 24));
+        data += 32;
+        len -= 32;
+    }
+    while(len >= 8)
+    {
+        crc64 = _mm_crc32_u64(crc64, *(const unsigned long long*)data);
+        data += 8;
+        len -= 8;
+    }
+    crc = (DWORD)crc64;
+#else
+    while(len >= 4)
+    {
+        crc = _mm_crc32_u32(crc, *(const DWORD*)data);
+        data += 4;
+        len -= 4;
+    }
+#endif //_WIN64
+    while(len--)
+        crc = _mm_crc32_u8(crc, *data++);
+    return crc;
+}
+
+Crc32c::Crc32c()
+{
+    Reset();
+}
+
+void Crc32c::Reset()
+{
+    crc = 0xFFFFFFFF;
+}
+
+void Crc32c::Update(const unsigned char* data, size_t len)
+{
+    CRC32CUPDATE update = cpu_get_features().sse42 ? crc32c_update_hw : crc32c_update_sw;
+    crc = update(crc, data, len);
+}
+
+DWORD Crc32c::Digest() const
+{
+    return ~crc;
+}
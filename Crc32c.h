@@ -0,0 +1,19 @@
+#ifndef _CRC32C_H
+#define _CRC32C_H
+
+#include <windows.h>
+
+//streaming CRC-32C (Castagnoli), uses the SSE4.2 crc32 instruction when available
+class Crc32c
+{
+public:
+    Crc32c();
+    void Reset();
+    void Update(const unsigned char* data, size_t len);
+    DWORD Digest() const;
+
+private:
+    DWORD crc;
+};
+
+#endif //_CRC32C_H
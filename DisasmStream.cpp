@@ -0,0 +1,41 @@
+#include "DisasmStream.h"
+
+DisasmStream::DisasmStream(StreamSource & source, ULONG_PTR start, ULONG_PTR end, size_t windowSize)
+    : source(source),
+      end(end),
+      addr(start),
+      windowStart(start),
+      windowUsed(0),
+      done(end < start),
+      window((windowSize ? windowSize : STREAM_WINDOW_SIZE) + STREAM_MAX_INSTRUCTION)
+{
+}
+
+//moves the window to the next instruction, the padding is read along so it never has to be copied
+void DisasmStream::Fill()
+{
+    size_t windowSize = window.size() - STREAM_MAX_INSTRUCTION;
+    ULONG_PTR left = end - addr; //one less than the bytes left, so a range up to the top of the address space does not overflow
+    windowStart = addr;
+    windowUsed = left < windowSize ? (size_t)left + 1 : windowSize;
+    source.Read(windowStart, window.data(), windowUsed + STREAM_MAX_INSTRUCTION);
+}
+
+bool DisasmStream::Next(stream_instr & instr)
+{
+    if(done)
+        return false;
+    if(addr - windowStart >= windowUsed)
+        Fill();
+    instr.addr = addr;
+    instr.bytes = window.data() + (addr - windowStart);
+    instr.size = source.Decode(instr.bytes, addr);
+    instr.valid = instr.size && instr.size <= STREAM_MAX_INSTRUCTION;
+    if(!instr.valid)
+        instr.size = 1;
+    if(end - addr < instr.size)
+        done = true;
+    else
+        addr += instr.size;
+    return true;
+}
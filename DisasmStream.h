@@ -0,0 +1,52 @@
+#ifndef _DISASMSTREAM_H
+#define _DISASMSTREAM_H
+
+#include <windows.h>
+#include <vector>
+
+#define STREAM_WINDOW_SIZE 0x10000
+#define STREAM_MAX_INSTRUCTION 16 //bytes kept past the window so the last instruction in it is complete
+
+//memory and decoding backend of a DisasmStream
+class StreamSource
+{
+public:
+    virtual ~StreamSource() {}
+    //fills data with the bytes at addr, unreadable bytes must be zero filled
+    virtual void Read(ULONG_PTR addr, unsigned char* data, size_t size) = 0;
+    //size of the instruction at data (at least STREAM_MAX_INSTRUCTION bytes are valid), 0 if it is invalid
+    //anything else the decoder finds out is kept by the source until the next call
+    virtual unsigned int Decode(const unsigned char* data, ULONG_PTR addr) = 0;
+};
+
+struct stream_instr
+{
+    ULONG_PTR addr;
+    unsigned int size; //1 for invalid bytes, which are skipped one at a time
+    bool valid;
+    const unsigned char* bytes; //only valid until the next call to Next
+};
+
+//linear sweep of [start, end] that reads the memory one window at a time, memory use does not depend on the range
+class DisasmStream
+{
+public:
+    DisasmStream(StreamSource & source, ULONG_PTR start, ULONG_PTR end, size_t windowSize = STREAM_WINDOW_SIZE);
+    bool Next(stream_instr & instr); //false once the whole range was decoded
+    ULONG_PTR Position() const { return addr; }
+
+private:
+    DisasmStream(const DisasmStream &);
+    DisasmStream & operator=(const DisasmStream &);
+    void Fill();
+
+    StreamSource & source;
+    ULONG_PTR end;
+    ULONG_PTR addr; //next instruction
+    ULONG_PTR windowStart;
+    size_t windowUsed; //range bytes in the window, the padding after them is not counted
+    bool done;
+    std::vector<unsigned char> window;
+};
+
+#endif //_DISASMSTREAM_H
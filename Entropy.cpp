@@ -0,0 +1,152 @@
+#include "Entropy.h"
+#include "CpuFeatures.h"
+#include <emmintrin.h>
+#include <immintrin.h>
+#include <math.h>
+#include <string.h>
+#include <mutex>
+
+#define ENTROPY_TABLES 4
+
+typedef unsigned short ENTROPYCOUNTS[ENTROPY_TABLES][256];
+//sum of count * log2(count) over the byte values of a window, leaves counts zeroed
+typedef float (*ENTROPYSUM)(const unsigned char* data, size_t size, ENTROPYCOUNTS & counts);
+
+//count * log2(count) for every count a window can have, filled once by the first worker that needs it
+static float entropy_table[ENTROPY_MAX_WINDOW + 1];
+static std::once_flag entropy_table_once;
+
+static void entropy_init_table()
+{
+    entropy_table[0] = 0;
+    for(int i = 1; i <= ENTROPY_MAX_WINDOW; i++)
+        entropy_table[i] = (float)(i * log2((double)i));
+}
+
+//consecutive bytes go to different tables, so a run of one value does not wait on its own increments
+static void entropy_count(const unsigned char* data, size_t size, ENTROPYCOUNTS & counts)
+{
+    size_t i = 0;
+    for(; i + 4 <= size; i += 4)
+    {
+        counts[0][data[i]]++;
+        counts[1][data[i + 1]]++;
+        counts[2][data[i + 2]]++;
+        counts[3][data[i + 3]]++;
+    }
+    for(; i < size; i++)
+        counts[0][data[i]]++;
+}
+
+static float entropysum_sw(const unsigned char* data, size_t size, ENTROPYCOUNTS & counts)
+{
+    entropy_count(data, size, counts);
+    float sum = 0;
+    for(int i = 0; i < 256; i++)
+        sum += entropy_table[counts[0][i] + counts[1][i] + counts[2][i] + counts[3][i]];
+    memset(counts, 0, sizeof(counts));
+    return sum;
+}
+
+TARGET_SSE2 static float entropysum_sse2(const unsigned char* data, size_t size, ENTROPYCOUNTS & counts)
+{
+    //zero filled pages are most of a process, a window of one value needs no histogram
+    if(size >= 16)
+    {
+        __m128i first = _mm_set1_epi8((char)data[0]);
+        __m128i same = _mm_set1_epi8(-1);
+        size_t i = 0;
+        for(; i + 16 <= size; i += 16)
+            same = _mm_and_si128(same, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(data + i)), first));
+        if(_mm_movemask_epi8(same) == 0xFFFF)
+        {
+            for(; i < size && data[i] == data[0]; i++);
+            if(i == size)
+                return entropy_table[size];
+        }
+    }
+    entropy_count(data, size, counts);
+    float sum = 0;
+    unsigned short merged[8];
+    __m128i zero = _mm_setzero_si128();
+    for(int i = 0; i < 256; i += 8)
+    {
+        __m128i c = _mm_add_epi16(_mm_add_epi16(_mm_loadu_si128((const __m128i*)&counts[0][i]), _mm_loadu_si128((const __m128i*)&counts[1][i])),
+                                  _mm_add_epi16(_mm_loadu_si128((const __m128i*)&counts[2][i]), _mm_loadu_si128((const __m128i*)&counts[3][i])));
+        for(int t = 0; t < ENTROPY_TABLES; t++)
+            _mm_storeu_si128((__m128i*)&counts[t][i], zero);
+        _mm_storeu_si128((__m128i*)merged, c);
+        for(int j = 0; j < 8; j++)
+            sum += entropy_table[merged[j]];
+    }
+    return sum;
+}
+
+TARGET_AVX2 static float entropysum_avx2(const unsigned char* data, size_t size, ENTROPYCOUNTS & counts)
+{
+    if(size >= 32)
+    {
+        __m256i first = _mm256_set1_epi8((char)data[0]);
+        __m256i same = _mm256_set1_epi8(-1);
+        size_t i = 0;
+        for(; i + 32 <= size; i += 32)
+            same = _mm256_and_si256(same, _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(data + i)), first));
+        if((unsigned int)_mm256_movemask_epi8(same) == 0xFFFFFFFF)
+        {
+            for(; i < size && data[i] == data[0]; i++);
+            if(i == size)
+            {
+                _mm256_zeroupper();
+                return entropy_table[size];
+            }
+        }
+    }
+    entropy_count(data, size, counts);
+    //sixteen merged counts per step, the table lookups are gathers
+    __m256 sum = _mm256_setzero_ps();
+    __m256i zero = _mm256_setzero_si256();
+    for(int i = 0; i < 256; i += 16)
+    {
+        __m256i c = _mm256_add_epi16(_mm256_add_epi16(_mm256_loadu_si256((const __m256i*)&counts[0][i]), _mm256_loadu_si256((const __m256i*)&counts[1][i])),
+                                     _mm256_add_epi16(_mm256_loadu_si256((const __m256i*)&counts[2][i]), _mm256_loadu_si256((const __m256i*)&counts[3][i])));
+        for(int t = 0; t < ENTROPY_TABLES; t++)
+            _mm256_storeu_si256((__m256i*)&counts[t][i], zero);
+        __m256i lo = _mm256_cvtepu16_epi32(_mm256_castsi256_si128(c));
+        __m256i hi = _mm256_cvtepu16_epi32(_mm256_extracti128_si256(c, 1));
+        sum = _mm256_add_ps(sum, _mm256_i32gather_ps(entropy_table, lo, 4));
+        sum = _mm256_add_ps(sum, _mm256_i32gather_ps(entropy_table, hi, 4));
+    }
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+    float result = _mm_cvtss_f32(half);
+    _mm256_zeroupper();
+    return result;
+}
+
+static ENTROPYSUM entropysum()
+{
+    const cpu_features & features = cpu_get_features();
+    if(features.avx2)
+        return entropysum_avx2;
+    if(features.sse2)
+        return entropysum_sse2;
+    return entropysum_sw;
+}
+
+void entropy_map(const unsigned char* data, size_t size, size_t window, unsigned char* out)
+{
+    std::call_once(entropy_table_once, entropy_init_table);
+    ENTROPYSUM sum = entropysum();
+    ENTROPYCOUNTS counts;
+    memset(counts, 0, sizeof(counts));
+    float fullBits = (float)log2((double)window);
+    for(size_t pos = 0; pos < size; pos += window)
+    {
+        size_t n = size - pos < window ? size - pos : window;
+        //H = log2(n) - sum(c * log2(c)) / n
+        float bits = (n == window ? fullBits : (float)log2((double)n)) - sum(data + pos, n, counts) / n;
+        int value = (int)(bits * ENTROPY_SCALE + 0.5f);
+        *out++ = (unsigned char)(value < 0 ? 0 : value > 255 ? 255 : value);
+    }
+}
@@ -0,0 +1,13 @@
+#ifndef _ENTROPY_H
+#define _ENTROPY_H
+
+#include <windows.h>
+
+#define ENTROPY_MAX_WINDOW 0x1000
+#define ENTROPY_SCALE 32 //map values are bits per byte times this, 8 bits saturates at 255
+
+//shannon entropy of every window bytes of data, the last window can be shorter
+//out holds (size + window - 1) / window values, window is at most ENTROPY_MAX_WINDOW
+void entropy_map(const unsigned char* data, size_t size, size_t window, unsigned char* out);
+
+#endif //_ENTROPY_H
@@ -1,7 +1,5 @@
 #include "FunctionGraph.h"
-#include <list>
-#include <set>
-#include <stdio.h>
+#include "LeaderBitmap.h"
 
 struct previous_edge_struct_s
 {
@@ -10,7 +8,12 @@ struct previous_edge_struct_s
     ULONG_PTR targettrue;
 };
 
-#define TEXTLEN 256
+struct flow_edge
+{
+    ULONG_PTR source;
+    ULONG_PTR target;
+    cfg_edge type;
+};
 
 static char vcg_params[] =  "manhattan_edges: yes\n"
                             "layoutalgorithm: mindepth\n"
@@ -74,162 +77,312 @@ static char vcg_params[] =  "manhattan_edges: yes\n"
                             "colorentry 83: 100 255 255\n";
 
 //escape comments
-static void sanitize(const char* comment, char* cleaned)
+static void sanitize(BufferedWriter & out, const char* comment)
 {
-    char* t;
-    for(t = cleaned; *comment; comment++)
+    for(; *comment; comment++)
     {
-        if(*comment == '"')
-        {
-            *t++ = '\\';
-            *t = '"';
-        }
-        else if(*comment == '\\')
-        {
-            *t++ = '\\';
-            *t = '\\';
-        }
-        else
-        {
-            *t = *comment;
-        }
-        t++;
+        if(*comment == '"' || *comment == '\\')
+            out.Putc('\\');
+        out.Putc(*comment);
     }
-    *t = '\0';
 }
 
-bool make_flowchart(ULONG_PTR start, ULONG_PTR end, const wchar_t* szTargetFile, GETINSTRINFO getInstrInfo)
+static void write_header(BufferedWriter & out, ULONG_PTR start)
 {
-    HANDLE temp_file = CreateFileW(szTargetFile, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
-    if(temp_file == INVALID_HANDLE_VALUE)
-        return false;
+    out.Puts("graph: {\ntitle: \"Graph of ");
+    out.Pointer(start);
+    out.Puts("\"\n");
+    out.Write(vcg_params, sizeof(vcg_params) - 1);
+}
 
-    char buffer[TEXTLEN * 2 + 4];
-    ULONG_PTR currentnode = start;
+static void write_edge(BufferedWriter & out, const flow_edge & edge)
+{
+    out.Puts("edge: { sourcename: \"");
+    out.Pointer(edge.source);
+    out.Puts("\" targetname: \"");
+    out.Pointer(edge.target);
+    if(edge.type == EDGE_FALSE)
+        out.Puts("\" label: \"false\" color: red }\n");
+    else if(edge.type == EDGE_TRUE)
+        out.Puts("\" label: \"true\" color: darkgreen }\n");
+    else
+        out.Puts("\" }\n");
+}
+
+InstrList::InstrList()
+{
+    Clear();
+}
+
+void InstrList::Clear()
+{
+    entries.clear();
+    strings.clear();
+    strings.push_back('\0'); //offset 0 is the shared empty string
+}
 
-    int writelen = sprintf(buffer, "graph: {\ntitle: \"Graph of %p\"\n", start);
-    DWORD len_written;
-    WriteFile(temp_file, buffer, (DWORD) writelen, &len_written, NULL);
-    WriteFile(temp_file, vcg_params, (DWORD) strlen(vcg_params), &len_written, NULL);
-    writelen = sprintf(buffer, "node: { title: \"%p\" vertical_order: 0 color: 83 fontname: \"courR12\" label: \"%p:", currentnode, currentnode);
-    WriteFile(temp_file, buffer, (DWORD) writelen, &len_written, NULL);
+void InstrList::Reserve(size_t count, size_t textbytes)
+{
+    entries.reserve(count);
+    strings.reserve(textbytes);
+}
+
+void InstrList::Add(ULONG_PTR addr, ULONG_PTR jmpaddr, const char* instrText, const char* comment)
+{
+    instr_entry entry;
+    entry.addr = addr;
+    entry.jmpaddr = jmpaddr;
+    entry.instrText = AddString(instrText);
+    entry.comment = AddString(comment);
+    entries.push_back(entry);
+}
 
-    std::set<ULONG_PTR> nodelist; //list of node addresses, just to make sure we are not handling nodes multiple times
-    std::list<instr_info> disasmlist;
+size_t InstrList::AddString(const char* str)
+{
+    if(!*str)
+        return 0;
+    size_t offset = strings.size();
+    strings.insert(strings.end(), str, str + strlen(str) + 1);
+    return offset;
+}
+
+//first pass - disassemble instructions one by one
+static void collect_instructions(ULONG_PTR start, ULONG_PTR end, GETINSTRINFO getInstrInfo, InstrList & disasmlist)
+{
+    //rough guess (4 bytes and 32 characters per instruction) to avoid most reallocations
+    disasmlist.Reserve((end - start) / 4 + 1, (end - start) * 8 + 1);
+    instr_info disasm_result;
     ULONG_PTR psize = 0;
     ULONG_PTR current_addr = start;
-
-    // first pass - disassemble instructions and enumerate nodes
     do
     {
         current_addr += psize;
 
         //get instr_info
-        instr_info disasm_result;
+        disasm_result.comment[0] = '\0';
+        disasm_result.instrText[0] = '\0';
         ULONG_PTR next_addr = getInstrInfo(current_addr, &disasm_result);
         psize = next_addr - current_addr;
         if(psize <= 0)
             psize = 1;
 
         //add instr_info to list
-        disasmlist.push_back(disasm_result);
+        disasmlist.Add(disasm_result.addr, disasm_result.jmpaddr, disasm_result.instrText, disasm_result.comment);
+    }
+    while(current_addr + psize <= end);
+}
+
+static bool write_flowchart(ULONG_PTR start, ULONG_PTR end, const InstrList & disasmlist, OutputSink & output)
+{
+    BufferedWriter out(output);
+    ULONG_PTR currentnode = start;
+    ULONG_PTR current_addr;
+
+    write_header(out, start);
+    out.Puts("node: { title: \"");
+    out.Pointer(currentnode);
+    out.Puts("\" vertical_order: 0 color: 83 fontname: \"courR12\" label: \"");
+    out.Pointer(currentnode);
+    out.Putc(':');
 
-        // enumerate nodes
+    // enumerate nodes
+    LeaderBitmap nodelist(start, end); //node addresses
+    for(size_t i = 0; i < disasmlist.Count(); i++)
+    {
+        const instr_entry & instr = disasmlist[i];
         if(currentnode == 0)
         {
-            currentnode = current_addr;
-            nodelist.insert(currentnode);
+            currentnode = instr.addr;
+            nodelist.Set(currentnode);
         }
-        if((disasm_result.jmpaddr >= start) && (disasm_result.jmpaddr < end))
+        if((instr.jmpaddr >= start) && (instr.jmpaddr < end))
         {
             // this is a jump - start of an edge and pointer to a node
-            nodelist.insert(disasm_result.jmpaddr);
-            currentnode = 0; // update current_addrnode on next pass
+            nodelist.Set(instr.jmpaddr);
+            currentnode = 0; // update currentnode on the next instruction
         }
     }
-    while(current_addr + psize <= end);
 
     // walk through saved disasm list and split into nodes
     currentnode = start;
     bool orphannode = true;
     previous_edge_struct_s previous_edge;
     memset(&previous_edge, 0, sizeof(previous_edge_struct_s));
-    std::string edgelist;
-    for(std::list<instr_info>::iterator i = disasmlist.begin(); i != disasmlist.end(); ++i)
+    std::vector<flow_edge> edgelist; //edges follow all nodes in the output
+    ULONG_PTR nextnode = 0; //the instructions are sorted, so the next node is scanned for alongside them
+    bool morenodes = nodelist.Next(start, nextnode);
+    for(size_t i = 0; i < disasmlist.Count(); i++)
     {
-        instr_info disasm_result = *i;
-        current_addr = disasm_result.addr;
+        const instr_entry & instr = disasmlist[i];
+        const char* instrText = disasmlist.Text(i);
+        const char* comment = disasmlist.Comment(i);
+        current_addr = instr.addr;
 
         //node contents (address)
-        if(nodelist.find(current_addr) != nodelist.end()) //found current_addr in set
+        if(morenodes && nextnode < current_addr)
+            morenodes = nodelist.Next(current_addr, nextnode);
+        if(morenodes && nextnode == current_addr) //found current_addr in node list
         {
             if(orphannode)
             {
-                writelen = sprintf(buffer, "edge: { sourcename: \"%p\" targetname: \"%p\" }\n", currentnode, current_addr);
-                edgelist += buffer;
+                flow_edge edge = { currentnode, current_addr, EDGE_PLAIN };
+                edgelist.push_back(edge);
             }
             orphannode = true;
             currentnode = current_addr;
-            writelen = sprintf(buffer, "\" }\n");
-            WriteFile(temp_file, buffer, (DWORD) writelen, &len_written, NULL);
-            writelen = sprintf(buffer, "node: { title: \"%p\" color: 83 fontname: \"courR12\" label: \"%p:", current_addr, current_addr);
-            WriteFile(temp_file, buffer, (DWORD) writelen, &len_written, NULL);
+            out.Puts("\" }\nnode: { title: \"");
+            out.Pointer(current_addr);
+            out.Puts("\" color: 83 fontname: \"courR12\" label: \"");
+            out.Pointer(current_addr);
+            out.Putc(':');
         }
 
         //node contents (disassembly)
-        if(disasm_result.comment.length())
+        out.Putc('\n');
+        out.Puts(instrText);
+        if(*comment)
         {
-            char clean_comment[TEXTLEN * 2];
-            sanitize(disasm_result.comment.c_str(), clean_comment);
-            writelen = sprintf(buffer, "\n%s\t; %s", disasm_result.instrText.c_str(), clean_comment);
+            out.Puts("\t; ");
+            sanitize(out, comment);
         }
-        else
-        {
-            writelen = sprintf(buffer, "\n%s", disasm_result.instrText.c_str());
-        }
-
-        WriteFile(temp_file, buffer, (DWORD)writelen, &len_written, NULL);
 
         if(previous_edge.source != 0)
         {
-            // append stored edge info with currentnode info to edgelist buffer
+            // append stored edge info with currentnode info to edgelist
             previous_edge.targetfalse = currentnode;
-            writelen = sprintf(buffer, "edge: { sourcename: \"%p\" targetname: \"%p\" label: \"false\" color: red }\n", previous_edge.source, previous_edge.targetfalse);
-            edgelist += buffer;
-            writelen = sprintf(buffer, "edge: { sourcename: \"%p\" targetname: \"%p\" label: \"true\" color: darkgreen }\n", previous_edge.source, previous_edge.targettrue);
-            edgelist += buffer;
+            flow_edge falseedge = { previous_edge.source, previous_edge.targetfalse, EDGE_FALSE };
+            edgelist.push_back(falseedge);
+            flow_edge trueedge = { previous_edge.source, previous_edge.targettrue, EDGE_TRUE };
+            edgelist.push_back(trueedge);
             previous_edge.source = 0;
         }
 
-        if((disasm_result.jmpaddr >= start) && (disasm_result.jmpaddr < end))
+        if((instr.jmpaddr >= start) && (instr.jmpaddr < end))
         {
             // this is a jump - start of an edge and pointer to a node
             orphannode = false;
             previous_edge.source = currentnode;
-            previous_edge.targettrue = disasm_result.jmpaddr;
+            previous_edge.targettrue = instr.jmpaddr;
             previous_edge.targetfalse = 0;
 
-            if(!_stricmp(disasm_result.instrText.substr(0, 3).c_str(), "jmp"))
+            if(!_strnicmp(instrText, "jmp", 3))
             {
                 // straight jmp, no true/false
-                writelen = sprintf(buffer, "edge: { sourcename: \"%p\" targetname: \"%p\" }\n", previous_edge.source, previous_edge.targettrue);
-                edgelist += buffer;
+                flow_edge edge = { previous_edge.source, previous_edge.targettrue, EDGE_PLAIN };
+                edgelist.push_back(edge);
                 previous_edge.source = 0;
             }
         }
     }
 
     // close last node
-    writelen = sprintf(buffer, "\" vertical_order: %d }\n", nodelist.size());
-    WriteFile(temp_file, buffer, (DWORD)writelen, &len_written, NULL);
+    out.Puts("\" vertical_order: ");
+    out.Decimal(nodelist.Count());
+    out.Puts(" }\n");
 
     // write edgelist
-    WriteFile(temp_file, edgelist.c_str(), (DWORD)edgelist.length(), &len_written, NULL);
+    for(size_t i = 0; i < edgelist.size(); i++)
+        write_edge(out, edgelist[i]);
+
+    out.Puts("}\n");
+
+    return out.Flush();
+}
+
+static bool write_flowchart(const ControlFlowGraph & graph, const InstrList & disasmlist, OutputSink & output)
+{
+    if(disasmlist.Count() != graph.InstrCount())
+        return false;
+    BufferedWriter out(output);
+    write_header(out, graph.EntryPoint());
+
+    // nodes, the instruction lists are parallel so each node is a slice of both
+    for(size_t i = 0; i < graph.NodeCount(); i++)
+    {
+        const cfg_node & node = graph.Node(i);
+        out.Puts("node: { title: \"");
+        out.Pointer(node.start);
+        if(node.start == graph.EntryPoint())
+            out.Puts("\" vertical_order: 0");
+        else
+            out.Putc('"');
+        out.Puts(" color: 83 fontname: \"courR12\" label: \"");
+        out.Pointer(node.start);
+        out.Putc(':');
+        for(size_t j = node.firstInstr; j < node.firstInstr + node.icount; j++)
+        {
+            const char* comment = disasmlist.Comment(j);
+            out.Putc('\n');
+            out.Puts(disasmlist.Text(j));
+            if(*comment)
+            {
+                out.Puts("\t; ");
+                sanitize(out, comment);
+            }
+        }
+        out.Puts("\" }\n");
+    }
 
-    writelen = sprintf(buffer, "}\n");
-    WriteFile(temp_file, buffer, (DWORD)writelen, &len_written, NULL);
+    // edges, only to nodes that were decoded
+    for(size_t i = 0; i < graph.NodeCount(); i++)
+    {
+        const cfg_node & node = graph.Node(i);
+        for(size_t j = 0; j < node.exitCount; j++)
+        {
+            flow_edge edge = { node.start, graph.Exit(node, j), graph.ExitType(node, j) };
+            if(graph.FindNode(edge.target) == graph.NodeCount())
+                continue;
+            write_edge(out, edge);
+        }
+    }
 
-    CloseHandle(temp_file);
+    out.Puts("}\n");
+
+    return out.Flush();
+}
 
-    return true;
+bool make_flowchart(ULONG_PTR start, ULONG_PTR end, OutputSink & output, GETINSTRINFO getInstrInfo)
+{
+    InstrList disasmlist;
+    collect_instructions(start, end, getInstrInfo, disasmlist);
+    return write_flowchart(start, end, disasmlist, output);
+}
+
+bool make_flowchart(ULONG_PTR start, ULONG_PTR end, OutputSink & output, GETINSTRINFOBATCH getInstrInfoBatch)
+{
+    InstrList disasmlist;
+    if(!getInstrInfoBatch(start, end, &disasmlist))
+        return false;
+    return write_flowchart(start, end, disasmlist, output);
+}
+
+bool make_flowchart(const ControlFlowGraph & graph, const InstrList & disasmlist, OutputSink & output)
+{
+    return write_flowchart(graph, disasmlist, output);
+}
+
+#ifdef _WIN32
+bool make_flowchart(ULONG_PTR start, ULONG_PTR end, const wchar_t* szTargetFile, GETINSTRINFO getInstrInfo)
+{
+    FileSink file(szTargetFile);
+    if(!file.IsOpen())
+        return false;
+    return make_flowchart(start, end, file, getInstrInfo);
+}
+
+bool make_flowchart(ULONG_PTR start, ULONG_PTR end, const wchar_t* szTargetFile, GETINSTRINFOBATCH getInstrInfoBatch)
+{
+    FileSink file(szTargetFile);
+    if(!file.IsOpen())
+        return false;
+    return make_flowchart(start, end, file, getInstrInfoBatch);
+}
+
+bool make_flowchart(const ControlFlowGraph & graph, const InstrList & disasmlist, const wchar_t* szTargetFile)
+{
+    FileSink file(szTargetFile);
+    if(!file.IsOpen())
+        return false;
+    return make_flowchart(graph, disasmlist, file);
 }
+#endif //_WIN32
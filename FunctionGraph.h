@@ -2,18 +2,65 @@
 #define _FUNCTIONGRAPH_H
 
 #include <windows.h>
-#include <string>
+#include <vector>
+#include "ControlFlow.h"
+#include "OutputSink.h"
 
+#define INSTR_TEXT_SIZE 2048 //GUI_MAX_DISASSEMBLY_SIZE
+#define INSTR_COMMENT_SIZE 512 //MAX_COMMENT_SIZE
+
+//scratch structure filled by GETINSTRINFO, reused for every instruction
 struct instr_info
 {
     ULONG_PTR addr;
     ULONG_PTR jmpaddr;
-    std::string instrText;
-    std::string comment;
+    char instrText[INSTR_TEXT_SIZE];
+    char comment[INSTR_COMMENT_SIZE];
 };
 
 typedef ULONG_PTR(*GETINSTRINFO)(ULONG_PTR addr, instr_info* info);
 
+//stored instruction, the strings are offsets into the InstrList string arena
+struct instr_entry
+{
+    ULONG_PTR addr;
+    ULONG_PTR jmpaddr;
+    size_t instrText;
+    size_t comment;
+};
+
+//contiguous instruction storage, all strings share one growing buffer
+class InstrList
+{
+public:
+    InstrList();
+    void Clear();
+    void Reserve(size_t count, size_t textbytes);
+    void Add(ULONG_PTR addr, ULONG_PTR jmpaddr, const char* instrText, const char* comment);
+    size_t Count() const { return entries.size(); }
+    const instr_entry & operator[](size_t index) const { return entries[index]; }
+    const char* Text(size_t index) const { return &strings[entries[index].instrText]; }
+    const char* Comment(size_t index) const { return &strings[entries[index].comment]; }
+
+private:
+    size_t AddString(const char* str);
+
+    std::vector<instr_entry> entries;
+    std::vector<char> strings;
+};
+
+//fills the list with every instruction in [start, end] at once, sorted by address
+typedef bool(*GETINSTRINFOBATCH)(ULONG_PTR start, ULONG_PTR end, InstrList* list);
+
+//writes a VCG graph of [start, end] to any sink
+bool make_flowchart(ULONG_PTR start, ULONG_PTR end, OutputSink & output, GETINSTRINFO getInstrInfo);
+bool make_flowchart(ULONG_PTR start, ULONG_PTR end, OutputSink & output, GETINSTRINFOBATCH getInstrInfoBatch);
+//writes a VCG graph of the reachable code only, disasmlist holds the text of every graph instruction in the same order
+bool make_flowchart(const ControlFlowGraph & graph, const InstrList & disasmlist, OutputSink & output);
+#ifdef _WIN32
 bool make_flowchart(ULONG_PTR start, ULONG_PTR end, const wchar_t* szTargetFile, GETINSTRINFO getInstrInfo);
+bool make_flowchart(ULONG_PTR start, ULONG_PTR end, const wchar_t* szTargetFile, GETINSTRINFOBATCH getInstrInfoBatch);
+bool make_flowchart(const ControlFlowGraph & graph, const InstrList & disasmlist, const wchar_t* szTargetFile);
+#endif //_WIN32
 
-#endif //_FUNCTIONGRAPH_H
\ No newline at end of file
+#endif //_FUNCTIONGRAPH_H
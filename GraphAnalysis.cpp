@@ -0,0 +1,312 @@
+#include "GraphAnalysis.h"
+#include <algorithm>
+
+void GraphAnalysis::Analyze(const ControlFlowGraph & graph)
+{
+    std::vector<std::pair<size_t, size_t>> edges;
+    edges.reserve(graph.NodeCount() * 2);
+    for(size_t i = 0; i < graph.NodeCount(); i++)
+    {
+        const cfg_node & node = graph.Node(i);
+        for(size_t j = 0; j < node.exitCount; j++)
+        {
+            size_t target = graph.FindNode(graph.Exit(node, j));
+            if(target != graph.NodeCount())
+                edges.push_back(std::make_pair(i, target));
+        }
+    }
+    Analyze(graph.NodeCount(), edges, graph.FindNode(graph.EntryPoint()));
+}
+
+void GraphAnalysis::Analyze(size_t nodeCount, const std::vector<std::pair<size_t, size_t>> & edges, size_t entry)
+{
+    //counting sort of the edges into both row arrays
+    succStart.assign(nodeCount + 1, 0);
+    predStart.assign(nodeCount + 1, 0);
+    for(size_t i = 0; i < edges.size(); i++)
+    {
+        succStart[edges[i].first + 1]++;
+        predStart[edges[i].second + 1]++;
+    }
+    for(size_t i = 0; i < nodeCount; i++)
+    {
+        succStart[i + 1] += succStart[i];
+        predStart[i + 1] += predStart[i];
+    }
+    succ.resize(edges.size());
+    pred.resize(edges.size());
+    std::vector<size_t> succFill(succStart.begin(), succStart.end() - 1);
+    std::vector<size_t> predFill(predStart.begin(), predStart.end() - 1);
+    for(size_t i = 0; i < edges.size(); i++)
+    {
+        succ[succFill[edges[i].first]++] = edges[i].second;
+        pred[predFill[edges[i].second]++] = edges[i].first;
+    }
+    Run(entry);
+}
+
+bool GraphAnalysis::Dominates(size_t a, size_t b) const
+{
+    if(!Reachable(a) || !Reachable(b))
+        return false;
+    return domIn[a] <= domIn[b] && domOut[b] <= domOut[a];
+}
+
+void GraphAnalysis::Run(size_t entry)
+{
+    size_t nodeCount = succStart.size() - 1;
+    order.assign(nodeCount, CFG_NONE);
+    rpo.clear();
+    idom.assign(nodeCount, CFG_NONE);
+    domIn.assign(nodeCount, 0);
+    domOut.assign(nodeCount, 0);
+    loops.clear();
+    loopOf.assign(nodeCount, CFG_NONE);
+    scc.assign(nodeCount, CFG_NONE);
+    sccCount = 0;
+    if(entry < nodeCount)
+    {
+        Order(entry);
+        Dominators(entry);
+        DominatorTree(entry);
+        Loops();
+    }
+    Components();
+}
+
+//iterative depth first search, an explicit stack keeps 100k node chains off the call stack
+void GraphAnalysis::Order(size_t entry)
+{
+    size_t nodeCount = order.size();
+    std::vector<size_t> next(nodeCount, 0); //successor to visit next, per node
+    std::vector<unsigned char> visited(nodeCount, 0);
+    std::vector<size_t> stack(1, entry);
+    visited[entry] = 1;
+    while(!stack.empty())
+    {
+        size_t node = stack.back();
+        size_t & edge = next[node];
+        if(succStart[node] + edge < succStart[node + 1])
+        {
+            size_t target = succ[succStart[node] + edge++];
+            if(!visited[target])
+            {
+                visited[target] = 1;
+                stack.push_back(target);
+            }
+        }
+        else
+        {
+            rpo.push_back(node); //postorder for now
+            stack.pop_back();
+        }
+    }
+    std::reverse(rpo.begin(), rpo.end());
+    for(size_t i = 0; i < rpo.size(); i++)
+        order[rpo[i]] = i;
+}
+
+//Cooper, Harvey and Kennedy: iterate over reverse postorder, intersecting along the idom chains
+void GraphAnalysis::Dominators(size_t entry)
+{
+    idom[entry] = entry;
+    bool changed = true;
+    while(changed)
+    {
+        changed = false;
+        for(size_t i = 1; i < rpo.size(); i++)
+        {
+            size_t node = rpo[i];
+            size_t newIdom = CFG_NONE;
+            for(size_t j = predStart[node]; j < predStart[node + 1]; j++)
+            {
+                size_t p = pred[j];
+                if(idom[p] == CFG_NONE)
+                    continue;
+                if(newIdom == CFG_NONE)
+                {
+                    newIdom = p;
+                    continue;
+                }
+                size_t a = p, b = newIdom;
+                while(a != b)
+                {
+                    while(order[a] > order[b])
+                        a = idom[a];
+                    while(order[b] > order[a])
+                        b = idom[b];
+                }
+                newIdom = a;
+            }
+            if(idom[node] != newIdom)
+            {
+                idom[node] = newIdom;
+                changed = true;
+            }
+        }
+    }
+    idom[entry] = CFG_NONE;
+}
+
+//preorder intervals of the dominator tree, a dominates b when b's interval lies within a's
+void GraphAnalysis::DominatorTree(size_t entry)
+{
+    size_t nodeCount = idom.size();
+    std::vector<size_t> childStart(nodeCount + 1, 0);
+    for(size_t i = 0; i < nodeCount; i++)
+        if(idom[i] != CFG_NONE)
+            childStart[idom[i] + 1]++;
+    for(size_t i = 0; i < nodeCount; i++)
+        childStart[i + 1] += childStart[i];
+    std::vector<size_t> children(childStart[nodeCount]);
+    std::vector<size_t> fill(childStart.begin(), childStart.end() - 1);
+    for(size_t i = 0; i < nodeCount; i++)
+        if(idom[i] != CFG_NONE)
+            children[fill[idom[i]]++] = i;
+
+    size_t counter = 0;
+    std::vector<size_t> next(nodeCount, 0);
+    std::vector<size_t> stack(1, entry);
+    domIn[entry] = counter++;
+    while(!stack.empty())
+    {
+        size_t node = stack.back();
+        if(childStart[node] + next[node] < childStart[node + 1])
+        {
+            size_t child = children[childStart[node] + next[node]++];
+            domIn[child] = counter++;
+            stack.push_back(child);
+        }
+        else
+        {
+            domOut[node] = counter++;
+            stack.pop_back();
+        }
+    }
+}
+
+//natural loops: every back edge (target dominates source) adds the nodes reaching the source without passing the header
+void GraphAnalysis::Loops()
+{
+    size_t nodeCount = idom.size();
+    std::vector<size_t> headerLoop(nodeCount, CFG_NONE);
+    std::vector<std::vector<size_t>> bodies;
+    std::vector<size_t> mark(nodeCount, CFG_NONE);
+    std::vector<size_t> worklist;
+    for(size_t i = 0; i < rpo.size(); i++)
+    {
+        size_t header = rpo[i];
+        for(size_t j = predStart[header]; j < predStart[header + 1]; j++)
+        {
+            size_t source = pred[j];
+            if(!Dominates(header, source))
+                continue;
+            //back edges to the same header share one loop
+            if(headerLoop[header] == CFG_NONE)
+            {
+                headerLoop[header] = bodies.size();
+                bodies.push_back(std::vector<size_t>(1, header));
+                mark[header] = headerLoop[header];
+            }
+            size_t loop = headerLoop[header];
+            if(mark[source] != loop)
+            {
+                mark[source] = loop;
+                bodies[loop].push_back(source);
+                worklist.push_back(source);
+            }
+            while(!worklist.empty())
+            {
+                size_t node = worklist.back();
+                worklist.pop_back();
+                for(size_t k = predStart[node]; k < predStart[node + 1]; k++)
+                {
+                    size_t p = pred[k];
+                    if(mark[p] != loop && Reachable(p))
+                    {
+                        mark[p] = loop;
+                        bodies[loop].push_back(p);
+                        worklist.push_back(p);
+                    }
+                }
+            }
+        }
+    }
+
+    //larger bodies first, so each smaller loop overwrites its nodes and finds its parent at its header
+    std::vector<size_t> bySize(bodies.size());
+    for(size_t i = 0; i < bySize.size(); i++)
+        bySize[i] = i;
+    std::stable_sort(bySize.begin(), bySize.end(), [&bodies](size_t a, size_t b)
+    {
+        return bodies[a].size() > bodies[b].size();
+    });
+    loops.resize(bodies.size());
+    for(size_t i = 0; i < bySize.size(); i++)
+    {
+        const std::vector<size_t> & body = bodies[bySize[i]];
+        cfg_loop & loop = loops[i];
+        loop.header = body[0];
+        loop.parent = loopOf[loop.header];
+        loop.depth = loop.parent == CFG_NONE ? 0 : loops[loop.parent].depth + 1;
+        loop.size = body.size();
+        for(size_t j = 0; j < body.size(); j++)
+            loopOf[body[j]] = i;
+    }
+}
+
+//Tarjan, iterative, over every node (unreachable ones included)
+void GraphAnalysis::Components()
+{
+    size_t nodeCount = scc.size();
+    std::vector<size_t> index(nodeCount, CFG_NONE);
+    std::vector<size_t> lowlink(nodeCount, 0);
+    std::vector<unsigned char> onStack(nodeCount, 0);
+    std::vector<size_t> next(nodeCount, 0);
+    std::vector<size_t> sccStack;
+    std::vector<size_t> callStack;
+    size_t counter = 0;
+    for(size_t root = 0; root < nodeCount; root++)
+    {
+        if(index[root] != CFG_NONE)
+            continue;
+        callStack.push_back(root);
+        index[root] = lowlink[root] = counter++;
+        sccStack.push_back(root);
+        onStack[root] = 1;
+        while(!callStack.empty())
+        {
+            size_t node = callStack.back();
+            if(succStart[node] + next[node] < succStart[node + 1])
+            {
+                size_t target = succ[succStart[node] + next[node]++];
+                if(index[target] == CFG_NONE)
+                {
+                    index[target] = lowlink[target] = counter++;
+                    sccStack.push_back(target);
+                    onStack[target] = 1;
+                    callStack.push_back(target);
+                }
+                else if(onStack[target] && index[target] < lowlink[node])
+                    lowlink[node] = index[target];
+                continue;
+            }
+            callStack.pop_back();
+            if(!callStack.empty() && lowlink[node] < lowlink[callStack.back()])
+                lowlink[callStack.back()] = lowlink[node];
+            if(lowlink[node] == index[node])
+            {
+                size_t member;
+                do
+                {
+                    member = sccStack.back();
+                    sccStack.pop_back();
+                    onStack[member] = 0;
+                    scc[member] = sccCount;
+                }
+                while(member != node);
+                sccCount++;
+            }
+        }
+    }
+}
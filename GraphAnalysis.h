@@ -0,0 +1,62 @@
+#ifndef _GRAPHANALYSIS_H
+#define _GRAPHANALYSIS_H
+
+#include <windows.h>
+#include <utility>
+#include <vector>
+#include "ControlFlow.h"
+
+#define CFG_NONE ((size_t)-1)
+
+struct cfg_loop
+{
+    size_t header; //node index
+    size_t parent; //enclosing loop, CFG_NONE for outermost loops
+    size_t depth; //0 for outermost loops
+    size_t size; //nodes in the body, including nested loops
+};
+
+//dominators, natural loops and strongly connected components over node indices
+//everything lives in flat arrays, graphs are given as successor lists in compressed rows
+class GraphAnalysis
+{
+public:
+    void Analyze(const ControlFlowGraph & graph); //node indices match graph.Node()
+    void Analyze(size_t nodeCount, const std::vector<std::pair<size_t, size_t>> & edges, size_t entry);
+
+    size_t NodeCount() const { return idom.size(); }
+    bool Reachable(size_t node) const { return order[node] != CFG_NONE; }
+    size_t Idom(size_t node) const { return idom[node]; } //CFG_NONE for the entry and unreachable nodes
+    bool Dominates(size_t a, size_t b) const; //constant time, through the dominator tree intervals
+    size_t LoopCount() const { return loops.size(); }
+    const cfg_loop & Loop(size_t index) const { return loops[index]; } //outer loops come before the loops they contain
+    size_t LoopOf(size_t node) const { return loopOf[node]; } //innermost loop, CFG_NONE outside of loops
+    size_t SccCount() const { return sccCount; }
+    size_t SccOf(size_t node) const { return scc[node]; } //components are numbered in reverse topological order
+
+private:
+    void Run(size_t entry);
+    void Order(size_t entry);
+    void Dominators(size_t entry);
+    void DominatorTree(size_t entry);
+    void Loops();
+    void Components();
+
+    //successors and predecessors in compressed rows
+    std::vector<size_t> succStart;
+    std::vector<size_t> succ;
+    std::vector<size_t> predStart;
+    std::vector<size_t> pred;
+
+    std::vector<size_t> order; //reverse postorder number, CFG_NONE when unreachable
+    std::vector<size_t> rpo; //nodes in reverse postorder
+    std::vector<size_t> idom;
+    std::vector<size_t> domIn; //dominator tree preorder interval
+    std::vector<size_t> domOut;
+    std::vector<cfg_loop> loops;
+    std::vector<size_t> loopOf;
+    std::vector<size_t> scc;
+    size_t sccCount;
+};
+
+#endif //_GRAPHANALYSIS_H
@@ -0,0 +1,219 @@
+#include "GraphCache.h"
+#include <errno.h>
+#include <stdio.h>
+#ifdef _WIN32
+#include "pluginsdk\lz4\lz4.h"
+#endif //_WIN32
+
+#define GRAPHCACHE_MAGIC 0x32484347 //GCH2
+#define GRAPHCACHE_COMPRESS_MIN 256 //smaller records are stored as they are
+#define GRAPHCACHE_MAX_RECORD 0x4000000 //larger sizes in a record header mean the file is damaged
+#define GRAPHCACHE_MAX_VERSIONS 4 //code hashes kept per function range when the file is compacted
+
+//record header in the cache file, followed by storedsize bytes
+struct cache_record
+{
+    ULONGLONG start;
+    ULONGLONG end;
+    ULONGLONG codehash;
+    unsigned int rawsize;
+    unsigned int storedsize; //equal to rawsize when the data is not compressed
+};
+
+//header and (compressed) data of one graph
+static void writerecord(FILE* file, ULONGLONG start, ULONGLONG end, ULONGLONG codehash, const std::vector<unsigned char> & data)
+{
+    cache_record record;
+    record.start = start;
+    record.end = end;
+    record.codehash = codehash;
+    record.rawsize = (unsigned int)data.size();
+    record.storedsize = record.rawsize;
+    const char* stored = (const char*)data.data();
+    std::vector<char> compressed;
+#ifdef _WIN32
+    if(data.size() >= GRAPHCACHE_COMPRESS_MIN)
+    {
+        compressed.resize(LZ4_compressBound((int)data.size()));
+        int size = LZ4_compress((const char*)data.data(), compressed.data(), (int)data.size());
+        if(size > 0 && (unsigned int)size < record.rawsize)
+        {
+            record.storedsize = size;
+            stored = compressed.data();
+        }
+    }
+#endif //_WIN32
+    fwrite(&record, sizeof(record), 1, file);
+    fwrite(stored, 1, record.storedsize, file);
+}
+
+GraphCache::GraphCache()
+{
+}
+
+void GraphCache::SetDirectory(const char* directory)
+{
+    std::unique_lock<std::mutex> guard(lock);
+    this->directory = directory;
+}
+
+bool GraphCache::Get(ULONGLONG modhash, ULONG_PTR base, ULONG_PTR start, ULONG_PTR end, ULONGLONG codehash, ControlFlowGraph & graph)
+{
+    std::unique_lock<std::mutex> guard(lock);
+    MODULEGRAPHS & graphs = Module(modhash);
+    MODULEGRAPHS::const_iterator found = graphs.find(RANGE(std::make_pair(start - base, end - base), codehash));
+    if(found == graphs.end())
+        return false;
+    return graph.Load(base, found->second.data(), found->second.size());
+}
+
+void GraphCache::Put(ULONGLONG modhash, ULONG_PTR base, ULONG_PTR start, ULONG_PTR end, ULONGLONG codehash, const ControlFlowGraph & graph)
+{
+    std::vector<unsigned char> data;
+    graph.Save(base, data);
+    std::unique_lock<std::mutex> guard(lock);
+    MODULEGRAPHS & graphs = Module(modhash);
+    RANGE range(std::make_pair(start - base, end - base), codehash);
+    if(graphs.count(range))
+        return;
+
+    if(!directory.empty())
+    {
+        //records are only ever appended, the file is compacted when it is loaded again
+        FILE* file = fopen(FileName(modhash).c_str(), "ab");
+        if(file)
+        {
+            if(!ftell(file))
+            {
+                unsigned int magic = GRAPHCACHE_MAGIC;
+                fwrite(&magic, sizeof(magic), 1, file);
+            }
+            writerecord(file, range.first.first, range.first.second, codehash, data);
+            fclose(file);
+        }
+    }
+    graphs[range].swap(data);
+}
+
+void GraphCache::Clear()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    modules.clear();
+}
+
+//graphs of one module, read from its file the first time
+GraphCache::MODULEGRAPHS & GraphCache::Module(ULONGLONG modhash)
+{
+    std::map<ULONGLONG, MODULEGRAPHS>::iterator found = modules.find(modhash);
+    if(found != modules.end())
+        return found->second;
+    MODULEGRAPHS & graphs = modules[modhash];
+    if(directory.empty())
+        return graphs;
+    std::string fileName = FileName(modhash);
+    FILE* file = fopen(fileName.c_str(), "rb");
+    if(!file)
+        return graphs;
+    fseek(file, 0, SEEK_END);
+    long long left = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    //records in file order, a later record of the same key wins
+    std::vector<std::pair<RANGE, std::vector<unsigned char>>> records;
+    bool damaged = false;
+    unsigned int magic = 0;
+    if(fread(&magic, sizeof(magic), 1, file) == 1 && magic == GRAPHCACHE_MAGIC)
+    {
+        left -= sizeof(magic);
+        cache_record record;
+        std::vector<char> stored;
+        while(left && !damaged)
+        {
+            //the sizes come from disk, a damaged or truncated record must not turn into a huge allocation
+            if(left < (long long)sizeof(record) || fread(&record, sizeof(record), 1, file) != 1)
+            {
+                damaged = true;
+                break;
+            }
+            left -= sizeof(record);
+            if(record.rawsize > GRAPHCACHE_MAX_RECORD || record.storedsize > record.rawsize || record.storedsize > left)
+            {
+                damaged = true;
+                break;
+            }
+            stored.resize(record.storedsize);
+            if(fread(stored.data(), 1, stored.size(), file) != stored.size())
+            {
+                damaged = true;
+                break;
+            }
+            left -= record.storedsize;
+            std::vector<unsigned char> data(record.rawsize);
+            if(record.storedsize == record.rawsize)
+                memcpy(data.data(), stored.data(), data.size());
+#ifdef _WIN32
+            else if(LZ4_decompress_safe(stored.data(), (char*)data.data(), (int)stored.size(), (int)data.size()) != (int)data.size())
+                damaged = true;
+#else
+            else
+                continue;
+#endif //_WIN32
+            records.push_back(std::make_pair(RANGE(std::make_pair(record.start, record.end), record.codehash), std::vector<unsigned char>()));
+            records.back().second.swap(data);
+        }
+    }
+    else
+        damaged = true; //an older format or no header at all
+    fclose(file);
+    if(damaged)
+    {
+        //anything appended after a bad record would be read at the wrong offsets, the file is started again
+        remove(fileName.c_str());
+        return graphs;
+    }
+
+    //the newest GRAPHCACHE_MAX_VERSIONS code hashes per range are kept, every rebased load of a relocated function adds one
+    std::map<std::pair<ULONGLONG, ULONGLONG>, size_t> versions;
+    std::vector<bool> keep(records.size(), false);
+    size_t kept = 0;
+    for(size_t i = records.size(); i--;)
+    {
+        const RANGE & range = records[i].first;
+        if(graphs.count(range))
+            continue;
+        size_t & count = versions[range.first];
+        if(count == GRAPHCACHE_MAX_VERSIONS)
+            continue;
+        count++;
+        keep[i] = true;
+        kept++;
+        graphs[range].swap(records[i].second);
+    }
+
+    //superseded records make up most of the file, it is written again with the live ones only
+    if(records.size() - kept > kept)
+    {
+        std::string tempName = fileName + ".tmp";
+        FILE* temp = fopen(tempName.c_str(), "wb");
+        if(temp)
+        {
+            fwrite(&magic, sizeof(magic), 1, temp);
+            for(size_t i = 0; i < records.size(); i++)
+                if(keep[i])
+                    writerecord(temp, records[i].first.first.first, records[i].first.first.second, records[i].first.second, graphs[records[i].first]);
+            bool written = !ferror(temp);
+            fclose(temp);
+            if(written && (remove(fileName.c_str()) == 0 || errno == ENOENT) && rename(tempName.c_str(), fileName.c_str()) == 0)
+                return graphs;
+            remove(tempName.c_str());
+        }
+    }
+    return graphs;
+}
+
+std::string GraphCache::FileName(ULONGLONG modhash) const
+{
+    char name[32] = "";
+    sprintf(name, "%016llX.cfg", modhash);
+    return directory + "\\" + name;
+}
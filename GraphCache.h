@@ -0,0 +1,39 @@
+#ifndef _GRAPHCACHE_H
+#define _GRAPHCACHE_H
+
+#include <windows.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "ControlFlow.h"
+
+//built graphs per (module file hash, function range, code hash), in memory and appended to one file per module
+//the file is checked record by record when it is loaded and written again once superseded records outnumber the live ones
+//the code hash covers the bytes the graph was decoded from, so code changed in memory never hits a stale graph
+class GraphCache
+{
+public:
+    GraphCache();
+    void SetDirectory(const char* directory); //empty keeps the cache in memory only
+    bool Get(ULONGLONG modhash, ULONG_PTR base, ULONG_PTR start, ULONG_PTR end, ULONGLONG codehash, ControlFlowGraph & graph);
+    void Put(ULONGLONG modhash, ULONG_PTR base, ULONG_PTR start, ULONG_PTR end, ULONGLONG codehash, const ControlFlowGraph & graph);
+    void Clear(); //drops the memory copy, the files stay
+
+private:
+    GraphCache(const GraphCache &);
+    GraphCache & operator=(const GraphCache &);
+
+    typedef std::pair<std::pair<ULONGLONG, ULONGLONG>, ULONGLONG> RANGE; //start and end relative to the module base, code hash
+    typedef std::map<RANGE, std::vector<unsigned char>> MODULEGRAPHS; //uncompressed ControlFlowGraph::Save data
+
+    MODULEGRAPHS & Module(ULONGLONG modhash);
+    std::string FileName(ULONGLONG modhash) const;
+
+    std::map<ULONGLONG, MODULEGRAPHS> modules;
+    std::string directory;
+    std::mutex lock;
+};
+
+#endif //_GRAPHCACHE_H
@@ -0,0 +1,353 @@
+#include "GraphExport.h"
+
+//escapes for the string contexts of each format, written straight into the buffer
+static void escape_dot(BufferedWriter & out, const char* str)
+{
+    for(; *str; str++)
+    {
+        if(*str == '"' || *str == '\\')
+            out.Putc('\\');
+        out.Putc(*str);
+    }
+}
+
+static void escape_xml(BufferedWriter & out, const char* str)
+{
+    for(; *str; str++)
+    {
+        switch(*str)
+        {
+        case '&':
+            out.Puts("&amp;");
+            break;
+        case '<':
+            out.Puts("&lt;");
+            break;
+        case '>':
+            out.Puts("&gt;");
+            break;
+        case '"':
+            out.Puts("&quot;");
+            break;
+        default:
+            out.Putc(*str);
+            break;
+        }
+    }
+}
+
+static void escape_json(BufferedWriter & out, const char* str)
+{
+    const char* digits = "0123456789abcdef";
+    for(; *str; str++)
+    {
+        unsigned char c = *str;
+        if(c == '"' || c == '\\')
+        {
+            out.Putc('\\');
+            out.Putc(c);
+        }
+        else if(c < 0x20)
+        {
+            out.Puts("\\u00");
+            out.Putc(digits[c >> 4]);
+            out.Putc(digits[c & 0xF]);
+        }
+        else
+            out.Putc(c);
+    }
+}
+
+static bool has_node(const ControlFlowGraph & graph, ULONG_PTR addr)
+{
+    return graph.FindNode(addr) != graph.NodeCount();
+}
+
+//one block per line: start end [exits...], terminal blocks end with "ret"
+class TextExporter : public GraphExporter
+{
+public:
+    static GraphExporter* Create() { return new TextExporter(); }
+
+    void Graph(BufferedWriter & out, const ControlFlowGraph & graph, const InstrList* disasmlist)
+    {
+        out.Puts("function ");
+        out.Pointer(graph.EntryPoint());
+        out.Puts(" blocks ");
+        out.Decimal(graph.NodeCount());
+        out.Puts(" instructions ");
+        out.Decimal(graph.InstrCount());
+        out.Putc('\n');
+        for(size_t i = 0; i < graph.NodeCount(); i++)
+        {
+            const cfg_node & node = graph.Node(i);
+            out.Putc(' ');
+            out.Pointer(node.start);
+            out.Putc(' ');
+            out.Pointer(node.end);
+            for(size_t j = 0; j < node.exitCount; j++)
+            {
+                out.Putc(' ');
+                out.Pointer(graph.Exit(node, j));
+            }
+            if(node.terminal)
+                out.Puts(" ret");
+            out.Putc('\n');
+            for(size_t j = node.firstInstr; disasmlist && j < node.firstInstr + node.icount; j++)
+            {
+                out.Puts("  ");
+                out.Puts(disasmlist->Text(j));
+                out.Putc('\n');
+            }
+        }
+    }
+};
+
+//Graphviz, one digraph per function
+class DotExporter : public GraphExporter
+{
+public:
+    static GraphExporter* Create() { return new DotExporter(); }
+
+    void Graph(BufferedWriter & out, const ControlFlowGraph & graph, const InstrList* disasmlist)
+    {
+        out.Puts("digraph \"");
+        out.Pointer(graph.EntryPoint());
+        out.Puts("\" {\nnode [shape=box fontname=\"Courier\"];\n");
+        for(size_t i = 0; i < graph.NodeCount(); i++)
+        {
+            const cfg_node & node = graph.Node(i);
+            out.Puts("n");
+            out.Pointer(node.start);
+            out.Puts(" [label=\"");
+            out.Pointer(node.start);
+            out.Puts(":\\l");
+            for(size_t j = node.firstInstr; disasmlist && j < node.firstInstr + node.icount; j++)
+            {
+                escape_dot(out, disasmlist->Text(j));
+                out.Puts("\\l");
+            }
+            out.Puts("\"];\n");
+        }
+        for(size_t i = 0; i < graph.NodeCount(); i++)
+        {
+            const cfg_node & node = graph.Node(i);
+            for(size_t j = 0; j < node.exitCount; j++)
+            {
+                ULONG_PTR target = graph.Exit(node, j);
+                if(!has_node(graph, target))
+                    continue;
+                out.Puts("n");
+                out.Pointer(node.start);
+                out.Puts(" -> n");
+                out.Pointer(target);
+                cfg_edge type = graph.ExitType(node, j);
+                if(type == EDGE_TRUE)
+                    out.Puts(" [color=darkgreen]");
+                else if(type == EDGE_FALSE)
+                    out.Puts(" [color=red]");
+                out.Puts(";\n");
+            }
+        }
+        out.Puts("}\n");
+    }
+};
+
+//GraphML, node ids are prefixed with the graph so shared blocks stay unique in the document
+class GraphMLExporter : public GraphExporter
+{
+public:
+    static GraphExporter* Create() { return new GraphMLExporter(); }
+
+    void Begin(BufferedWriter & out)
+    {
+        out.Puts("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                 "<graphml xmlns=\"http://graphml.graphdrawing.org/xmlns\">\n"
+                 "<key id=\"start\" for=\"node\" attr.name=\"start\" attr.type=\"string\"/>\n"
+                 "<key id=\"end\" for=\"node\" attr.name=\"end\" attr.type=\"string\"/>\n"
+                 "<key id=\"text\" for=\"node\" attr.name=\"text\" attr.type=\"string\"/>\n"
+                 "<key id=\"terminal\" for=\"node\" attr.name=\"terminal\" attr.type=\"boolean\"/>\n"
+                 "<key id=\"type\" for=\"edge\" attr.name=\"type\" attr.type=\"string\"/>\n");
+    }
+
+    void Graph(BufferedWriter & out, const ControlFlowGraph & graph, const InstrList* disasmlist)
+    {
+        out.Puts("<graph id=\"g");
+        out.Pointer(graph.EntryPoint());
+        out.Puts("\" edgedefault=\"directed\">\n");
+        for(size_t i = 0; i < graph.NodeCount(); i++)
+        {
+            const cfg_node & node = graph.Node(i);
+            out.Puts("<node id=\"");
+            Id(out, graph, node.start);
+            out.Puts("\"><data key=\"start\">");
+            out.Pointer(node.start);
+            out.Puts("</data><data key=\"end\">");
+            out.Pointer(node.end);
+            out.Puts("</data>");
+            if(node.terminal)
+                out.Puts("<data key=\"terminal\">true</data>");
+            if(disasmlist)
+            {
+                out.Puts("<data key=\"text\">");
+                for(size_t j = node.firstInstr; j < node.firstInstr + node.icount; j++)
+                {
+                    escape_xml(out, disasmlist->Text(j));
+                    out.Putc('\n');
+                }
+                out.Puts("</data>");
+            }
+            out.Puts("</node>\n");
+        }
+        for(size_t i = 0; i < graph.NodeCount(); i++)
+        {
+            const cfg_node & node = graph.Node(i);
+            for(size_t j = 0; j < node.exitCount; j++)
+            {
+                ULONG_PTR target = graph.Exit(node, j);
+                if(!has_node(graph, target))
+                    continue;
+                out.Puts("<edge source=\"");
+                Id(out, graph, node.start);
+                out.Puts("\" target=\"");
+                Id(out, graph, target);
+                cfg_edge type = graph.ExitType(node, j);
+                if(type == EDGE_PLAIN)
+                    out.Puts("\"/>\n");
+                else
+                    out.Puts(type == EDGE_TRUE ? "\"><data key=\"type\">true</data></edge>\n" : "\"><data key=\"type\">false</data></edge>\n");
+            }
+        }
+        out.Puts("</graph>\n");
+    }
+
+    void End(BufferedWriter & out)
+    {
+        out.Puts("</graphml>\n");
+    }
+
+private:
+    static void Id(BufferedWriter & out, const ControlFlowGraph & graph, ULONG_PTR start)
+    {
+        out.Putc('g');
+        out.Pointer(graph.EntryPoint());
+        out.Putc('_');
+        out.Pointer(start);
+    }
+};
+
+//compact JSON: [{"entry":N,"blocks":[{"start":N,"end":N,"exits":[N...],"true":N,"false":N,"ret":1,"text":[...]}]}]
+//addresses are plain numbers, user mode addresses fit in a double without loss
+class JsonExporter : public GraphExporter
+{
+public:
+    JsonExporter() : first(true) {}
+    static GraphExporter* Create() { return new JsonExporter(); }
+
+    void Begin(BufferedWriter & out)
+    {
+        out.Putc('[');
+    }
+
+    void Graph(BufferedWriter & out, const ControlFlowGraph & graph, const InstrList* disasmlist)
+    {
+        if(!first)
+            out.Putc(',');
+        first = false;
+        out.Puts("{\"entry\":");
+        out.Decimal(graph.EntryPoint());
+        out.Puts(",\"blocks\":[");
+        for(size_t i = 0; i < graph.NodeCount(); i++)
+        {
+            const cfg_node & node = graph.Node(i);
+            if(i)
+                out.Putc(',');
+            out.Puts("{\"start\":");
+            out.Decimal(node.start);
+            out.Puts(",\"end\":");
+            out.Decimal(node.end);
+            out.Puts(",\"exits\":[");
+            bool firstexit = true;
+            for(size_t j = 0; j < node.exitCount; j++)
+            {
+                ULONG_PTR target = graph.Exit(node, j);
+                if(!has_node(graph, target))
+                    continue;
+                if(!firstexit)
+                    out.Putc(',');
+                firstexit = false;
+                out.Decimal(target);
+            }
+            out.Putc(']');
+            if(node.brfalse && !node.split)
+            {
+                if(node.brtrue)
+                {
+                    out.Puts(",\"true\":");
+                    out.Decimal(node.brtrue);
+                }
+                out.Puts(",\"false\":");
+                out.Decimal(node.brfalse);
+            }
+            if(node.terminal)
+                out.Puts(",\"ret\":1");
+            if(disasmlist)
+            {
+                out.Puts(",\"text\":[");
+                for(size_t j = node.firstInstr; j < node.firstInstr + node.icount; j++)
+                {
+                    if(j != node.firstInstr)
+                        out.Putc(',');
+                    out.Putc('"');
+                    escape_json(out, disasmlist->Text(j));
+                    out.Putc('"');
+                }
+                out.Putc(']');
+            }
+            out.Putc('}');
+        }
+        out.Puts("]}");
+    }
+
+    void End(BufferedWriter & out)
+    {
+        out.Puts("]\n");
+    }
+
+private:
+    bool first;
+};
+
+static graph_format registered[] =
+{
+    { "text", "graphs", TextExporter::Create },
+    { "dot", "dot", DotExporter::Create },
+    { "graphml", "graphml", GraphMLExporter::Create },
+    { "json", "json", JsonExporter::Create },
+    { 0, 0, 0 }
+};
+
+const graph_format* graph_formats()
+{
+    return registered;
+}
+
+const graph_format* graph_format_find(const char* name)
+{
+    for(const graph_format* format = registered; format->name; format++)
+        if(!_stricmp(format->name, name))
+            return format;
+    return 0;
+}
+
+bool graph_export(const graph_format* format, OutputSink & output, const ControlFlowGraph* const* graphs, size_t count, const InstrList* const* disasmlists)
+{
+    GraphExporter* exporter = format->create();
+    BufferedWriter out(output);
+    exporter->Begin(out);
+    for(size_t i = 0; i < count; i++)
+        exporter->Graph(out, *graphs[i], disasmlists ? disasmlists[i] : 0);
+    exporter->End(out);
+    delete exporter;
+    return out.Flush();
+}
@@ -0,0 +1,33 @@
+#ifndef _GRAPHEXPORT_H
+#define _GRAPHEXPORT_H
+
+#include "FunctionGraph.h"
+
+//streams any number of graphs into one document, nothing is built up in memory
+class GraphExporter
+{
+public:
+    virtual ~GraphExporter() {}
+    virtual void Begin(BufferedWriter &) {} //document header, formats without one keep the default
+    //disasmlist holds the text of every graph instruction in the same order, it may be null
+    virtual void Graph(BufferedWriter & out, const ControlFlowGraph & graph, const InstrList* disasmlist) = 0;
+    virtual void End(BufferedWriter &) {}
+};
+
+typedef GraphExporter* (*GRAPHEXPORTERCREATE)();
+
+struct graph_format
+{
+    const char* name;
+    const char* extension;
+    GRAPHEXPORTERCREATE create;
+};
+
+//registered formats, terminated by an entry with a null name
+const graph_format* graph_formats();
+const graph_format* graph_format_find(const char* name);
+
+//writes every graph with the given format
+bool graph_export(const graph_format* format, OutputSink & output, const ControlFlowGraph* const* graphs, size_t count, const InstrList* const* disasmlists = 0);
+
+#endif //_GRAPHEXPORT_H
@@ -0,0 +1,184 @@
+#include "Hash.h"
+#include "Adler32.h"
+#include "Crc32c.h"
+#include "XxHash64.h"
+#include "Sha256.h"
+#include "Md5.h"
+#include <stdio.h>
+
+//every provider sees the data in slices this big, so the slice stays in cache between providers
+#define HASH_SLICE_SIZE 0x10000
+
+static void store32be(unsigned char* digest, DWORD value)
+{
+    for(int i = 0; i < 4; i++)
+        digest[i] = (unsigned char)(value >> (24 - i * 8));
+}
+
+static void store64be(unsigned char* digest, ULONGLONG value)
+{
+    for(int i = 0; i < 8; i++)
+        digest[i] = (unsigned char)(value >> (56 - i * 8));
+}
+
+//checksums are stored big endian so the string matches the usual "%08X" form
+class Adler32Provider : public HashProvider
+{
+public:
+    void Reset() { hash.Reset(); }
+    void Update(const unsigned char* data, size_t len) { hash.Update(data, len); }
+    void Final(unsigned char* digest) { store32be(digest, hash.Digest()); }
+    static HashProvider* Create() { return new Adler32Provider(); }
+
+private:
+    Adler32 hash;
+};
+
+class Crc32cProvider : public HashProvider
+{
+public:
+    void Reset() { hash.Reset(); }
+    void Update(const unsigned char* data, size_t len) { hash.Update(data, len); }
+    void Final(unsigned char* digest) { store32be(digest, hash.Digest()); }
+    static HashProvider* Create() { return new Crc32cProvider(); }
+
+private:
+    Crc32c hash;
+};
+
+class XxHash64Provider : public HashProvider
+{
+public:
+    void Reset() { hash.Reset(); }
+    void Update(const unsigned char* data, size_t len) { hash.Update(data, len); }
+    void Final(unsigned char* digest) { store64be(digest, hash.Digest()); }
+    static HashProvider* Create() { return new XxHash64Provider(); }
+
+private:
+    XxHash64 hash;
+};
+
+class Sha256Provider : public HashProvider
+{
+public:
+    void Reset() { hash.Reset(); }
+    void Update(const unsigned char* data, size_t len) { hash.Update(data, len); }
+    void Final(unsigned char* digest) { hash.Final(digest); }
+    static HashProvider* Create() { return new Sha256Provider(); }
+
+private:
+    Sha256 hash;
+};
+
+class Md5Provider : public HashProvider
+{
+public:
+    void Reset() { hash.Reset(); }
+    void Update(const unsigned char* data, size_t len) { hash.Update(data, len); }
+    void Final(unsigned char* digest) { hash.Final(digest); }
+    static HashProvider* Create() { return new Md5Provider(); }
+
+private:
+    Md5 hash;
+};
+
+static const hash_algorithm registered[] =
+{
+    { "adler32", 4, Adler32Provider::Create },
+    { "crc32c", 4, Crc32cProvider::Create },
+    { "xxhash64", 8, XxHash64Provider::Create },
+    { "sha256", SHA256_DIGEST_SIZE, Sha256Provider::Create },
+    { "md5", MD5_DIGEST_SIZE, Md5Provider::Create },
+    { 0, 0, 0 }
+};
+
+const hash_algorithm* hash_algorithms()
+{
+    return registered;
+}
+
+const hash_algorithm* hash_find(const char* name)
+{
+    for(const hash_algorithm* algorithm = registered; algorithm->name; algorithm++)
+        if(!_stricmp(algorithm->name, name))
+            return algorithm;
+    return 0;
+}
+
+void hash_tostring(const unsigned char* digest, size_t size, char* str)
+{
+    for(size_t i = 0; i < size; i++)
+        sprintf(str + i * 2, "%02X", digest[i]);
+    str[size * 2] = '\0';
+}
+
+HashSet::HashSet(const char* names)
+{
+    if(!names)
+    {
+        for(const hash_algorithm* algorithm = hash_algorithms(); algorithm->name; algorithm++)
+            algorithms.push_back(algorithm);
+    }
+    else
+    {
+        char name[64];
+        while(*names)
+        {
+            size_t len = strcspn(names, ",");
+            if(len < sizeof(name))
+            {
+                memcpy(name, names, len);
+                name[len] = '\0';
+                const hash_algorithm* algorithm = hash_find(name);
+                if(algorithm)
+                    algorithms.push_back(algorithm);
+            }
+            names += len;
+            if(*names)
+                names++;
+        }
+    }
+    for(size_t i = 0; i < algorithms.size(); i++)
+        providers.push_back(algorithms[i]->create());
+}
+
+HashSet::~HashSet()
+{
+    for(size_t i = 0; i < providers.size(); i++)
+        delete providers[i];
+}
+
+void HashSet::Reset()
+{
+    for(size_t i = 0; i < providers.size(); i++)
+        providers[i]->Reset();
+}
+
+void HashSet::Update(const unsigned char* data, size_t len)
+{
+    while(len)
+    {
+        size_t slice = len < HASH_SLICE_SIZE ? len : HASH_SLICE_SIZE;
+        for(size_t i = 0; i < providers.size(); i++)
+            providers[i]->Update(data, slice);
+        data += slice;
+        len -= slice;
+    }
+}
+
+size_t HashSet::Count() const
+{
+    return providers.size();
+}
+
+const char* HashSet::Name(size_t index) const
+{
+    return algorithms[index]->name;
+}
+
+void HashSet::Final(size_t index, char str[HASH_MAX_STRING_SIZE])
+{
+    unsigned char digest[HASH_MAX_DIGEST_SIZE];
+    providers[index]->Final(digest);
+    hash_tostring(digest, algorithms[index]->digestsize, str);
+}
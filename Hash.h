@@ -0,0 +1,53 @@
+#ifndef _HASH_H
+#define _HASH_H
+
+#include <windows.h>
+#include <vector>
+
+#define HASH_MAX_DIGEST_SIZE 32
+#define HASH_MAX_STRING_SIZE (HASH_MAX_DIGEST_SIZE * 2 + 1)
+
+class HashProvider
+{
+public:
+    virtual ~HashProvider() {}
+    virtual void Reset() = 0;
+    virtual void Update(const unsigned char* data, size_t len) = 0;
+    virtual void Final(unsigned char* digest) = 0; //writes hash_algorithm::digestsize bytes
+};
+
+typedef HashProvider* (*HASHCREATE)();
+
+struct hash_algorithm
+{
+    const char* name;
+    size_t digestsize;
+    HASHCREATE create;
+};
+
+//registered algorithms, terminated by an entry with a null name
+const hash_algorithm* hash_algorithms();
+const hash_algorithm* hash_find(const char* name);
+void hash_tostring(const unsigned char* digest, size_t size, char* str);
+
+//computes a set of algorithms in a single pass over the data
+class HashSet
+{
+public:
+    explicit HashSet(const char* names = 0); //comma separated list of algorithms, null for all of them
+    ~HashSet();
+    void Reset();
+    void Update(const unsigned char* data, size_t len);
+    size_t Count() const;
+    const char* Name(size_t index) const;
+    void Final(size_t index, char str[HASH_MAX_STRING_SIZE]);
+
+private:
+    HashSet(const HashSet &);
+    HashSet & operator=(const HashSet &);
+
+    std::vector<const hash_algorithm*> algorithms;
+    std::vector<HashProvider*> providers;
+};
+
+#endif //_HASH_H
@@ -0,0 +1,101 @@
+#include "InstrCache.h"
+
+#define ICACHE_DECODED 0x80
+#define ICACHE_INVALID 0x40
+#define ICACHE_FLOW 0x0F
+#define ICACHE_MAX_INSTRUCTION 16
+
+InstrCache::InstrCache(size_t maxBlocks)
+    : maxBlocks(maxBlocks ? maxBlocks : 1),
+      hits(0),
+      misses(0)
+{
+}
+
+//block of base, moved to the front. With create a missing block is added, reusing the oldest one when full
+InstrCache::icache_block* InstrCache::Find(ULONG_PTR base, bool create)
+{
+    std::unordered_map<ULONG_PTR, BLOCKLIST::iterator>::iterator found = index.find(base);
+    if(found != index.end())
+    {
+        if(found->second != blocks.begin())
+            blocks.splice(blocks.begin(), blocks, found->second);
+        return &blocks.front();
+    }
+    if(!create)
+        return 0;
+    if(blocks.size() < maxBlocks)
+        blocks.emplace_front();
+    else
+    {
+        index.erase(blocks.back().base);
+        blocks.splice(blocks.begin(), blocks, --blocks.end());
+    }
+    icache_block & block = blocks.front();
+    block.base = base;
+    memset(block.flags, 0, sizeof(block.flags));
+    index[base] = blocks.begin();
+    return &block;
+}
+
+bool InstrCache::Lookup(ULONG_PTR addr, cfg_instr & instr)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    icache_block* block = Find(addr & ~(ULONG_PTR)(ICACHE_BLOCK_SIZE - 1), false);
+    size_t offset = addr & (ICACHE_BLOCK_SIZE - 1);
+    if(!block || !(block->flags[offset] & ICACHE_DECODED))
+    {
+        misses++;
+        return false;
+    }
+    hits++;
+    unsigned char flags = block->flags[offset];
+    memset(&instr, 0, sizeof(instr));
+    instr.addr = addr;
+    if(flags & ICACHE_INVALID)
+        return true;
+    instr.size = block->length[offset];
+    instr.flow = (cfg_flow)(flags & ICACHE_FLOW);
+    if(instr.flow == FLOW_INDIRECT)
+        instr.table = block->target[offset];
+    else
+        instr.target = block->target[offset];
+    return true;
+}
+
+void InstrCache::Store(ULONG_PTR addr, const cfg_instr* instr)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    icache_block* block = Find(addr & ~(ULONG_PTR)(ICACHE_BLOCK_SIZE - 1), true);
+    size_t offset = addr & (ICACHE_BLOCK_SIZE - 1);
+    if(!instr || !instr->size || instr->size > ICACHE_MAX_INSTRUCTION)
+    {
+        block->flags[offset] = ICACHE_DECODED | ICACHE_INVALID;
+        return;
+    }
+    block->length[offset] = (unsigned char)instr->size;
+    block->flags[offset] = ICACHE_DECODED | (unsigned char)instr->flow;
+    block->target[offset] = instr->flow == FLOW_INDIRECT ? instr->table : instr->target;
+}
+
+void InstrCache::Invalidate(ULONG_PTR start, ULONG_PTR end)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    start = start > ICACHE_MAX_INSTRUCTION - 1 ? start - (ICACHE_MAX_INSTRUCTION - 1) : 0;
+    //there are never many blocks, so walking all of them is cheaper than probing every page of a large range
+    for(BLOCKLIST::iterator block = blocks.begin(); block != blocks.end(); ++block)
+    {
+        if(block->base > end || block->base + (ICACHE_BLOCK_SIZE - 1) < start)
+            continue;
+        ULONG_PTR first = start > block->base ? start - block->base : 0;
+        ULONG_PTR last = end - block->base < ICACHE_BLOCK_SIZE ? end - block->base : ICACHE_BLOCK_SIZE - 1;
+        memset(block->flags + first, 0, (size_t)(last - first + 1));
+    }
+}
+
+void InstrCache::Clear()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    blocks.clear();
+    index.clear();
+}
@@ -0,0 +1,50 @@
+#ifndef _INSTRCACHE_H
+#define _INSTRCACHE_H
+
+#include <windows.h>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include "ControlFlow.h"
+
+#define ICACHE_BLOCK_SIZE 0x1000 //addresses per block, one page
+#define ICACHE_MAX_BLOCKS 512
+
+//decoded instructions by address, only valid while the debuggee memory does not change
+//blocks hold the fields of a page in separate arrays and the least recently used block is reused when full
+class InstrCache
+{
+public:
+    explicit InstrCache(size_t maxBlocks = ICACHE_MAX_BLOCKS);
+    //true when addr was decoded before, instr.size is 0 if it did not decode then
+    bool Lookup(ULONG_PTR addr, cfg_instr & instr);
+    void Store(ULONG_PTR addr, const cfg_instr* instr); //0 for bytes that do not decode
+    void Invalidate(ULONG_PTR start, ULONG_PTR end); //also drops instructions running into start
+    void Clear();
+    ULONGLONG Hits() const { return hits; }
+    ULONGLONG Misses() const { return misses; }
+
+private:
+    InstrCache(const InstrCache &);
+    InstrCache & operator=(const InstrCache &);
+
+    struct icache_block
+    {
+        ULONG_PTR base;
+        unsigned char length[ICACHE_BLOCK_SIZE];
+        unsigned char flags[ICACHE_BLOCK_SIZE]; //cfg_flow in the low bits, 0 when not decoded yet
+        ULONG_PTR target[ICACHE_BLOCK_SIZE]; //branch target, or the table of an indirect jump
+    };
+    typedef std::list<icache_block> BLOCKLIST;
+
+    icache_block* Find(ULONG_PTR base, bool create);
+
+    size_t maxBlocks;
+    BLOCKLIST blocks; //most recently used first
+    std::unordered_map<ULONG_PTR, BLOCKLIST::iterator> index;
+    std::mutex lock;
+    ULONGLONG hits;
+    ULONGLONG misses;
+};
+
+#endif //_INSTRCACHE_H
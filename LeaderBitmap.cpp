@@ -0,0 +1,136 @@
+#include "LeaderBitmap.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif //_MSC_VER
+
+//index of the lowest set bit, value must not be 0
+static unsigned int lowestbit(ULONGLONG value)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+#ifdef _WIN64
+    _BitScanForward64(&index, value);
+#else
+    if(!_BitScanForward(&index, (unsigned long)value))
+    {
+        _BitScanForward(&index, (unsigned long)(value >> 32));
+        index += 32;
+    }
+#endif //_WIN64
+    return index;
+#else
+    return __builtin_ctzll(value);
+#endif //_MSC_VER
+}
+
+LeaderBitmap::LeaderBitmap()
+{
+    Reset(1, 0);
+}
+
+LeaderBitmap::LeaderBitmap(ULONG_PTR start, ULONG_PTR end)
+{
+    Reset(start, end);
+}
+
+void LeaderBitmap::Reset(ULONG_PTR start, ULONG_PTR end)
+{
+    this->start = start;
+    this->end = end;
+    table.clear();
+    directories.clear();
+    pages.clear();
+    bits.clear();
+    count = 0;
+    //a range like the whole user address space would need gigabytes of table, it only gets the directories it uses
+    ULONG_PTR dircount = start <= end ? ((end - start) >> (LEADER_PAGE_SHIFT + LEADER_DIR_SHIFT)) + 1 : 0;
+    if(dircount && dircount <= LEADER_TABLE_DIRS)
+        table.resize(dircount, 0);
+}
+
+unsigned int LeaderBitmap::MapDirectory(ULONG_PTR dirindex) const
+{
+    DIRECTORYMAP::const_iterator found = directories.find(dirindex);
+    return found == directories.end() ? 0 : found->second;
+}
+
+//first allocated directory at or after dirindex
+bool LeaderBitmap::NextDirectory(ULONG_PTR & dirindex, unsigned int & directory) const
+{
+    if(!table.empty())
+    {
+        for(; dirindex < table.size(); dirindex++)
+            if(table[dirindex])
+            {
+                directory = table[dirindex];
+                return true;
+            }
+        return false;
+    }
+    DIRECTORYMAP::const_iterator found = directories.lower_bound(dirindex);
+    if(found == directories.end())
+        return false;
+    dirindex = found->first;
+    directory = found->second;
+    return true;
+}
+
+unsigned int LeaderBitmap::AddDirectory(ULONG_PTR dirindex)
+{
+    pages.resize(pages.size() + LEADER_DIR_PAGES, 0);
+    unsigned int directory = (unsigned int)(pages.size() / LEADER_DIR_PAGES);
+    if(!table.empty())
+        table[dirindex] = directory;
+    else
+        directories[dirindex] = directory;
+    return directory;
+}
+
+unsigned int LeaderBitmap::AddPage()
+{
+    bits.resize(bits.size() + LEADER_PAGE_WORDS, 0);
+    return (unsigned int)(bits.size() / LEADER_PAGE_WORDS);
+}
+
+bool LeaderBitmap::Next(ULONG_PTR addr, ULONG_PTR & found) const
+{
+    if(addr < start)
+        addr = start;
+    if(addr > end || !count)
+        return false;
+    ULONG_PTR offset = addr - start;
+    ULONG_PTR firstdir = offset >> (LEADER_PAGE_SHIFT + LEADER_DIR_SHIFT);
+    size_t slot = (offset >> LEADER_PAGE_SHIFT) & (LEADER_DIR_PAGES - 1);
+    size_t wordindex = (offset >> 6) & (LEADER_PAGE_WORDS - 1);
+    ULONGLONG mask = ~0ULL << (offset & 63); //only bits at or after addr in the first word
+    unsigned int directory;
+    for(ULONG_PTR dirindex = firstdir; NextDirectory(dirindex, directory); dirindex++)
+    {
+        if(dirindex != firstdir)
+        {
+            slot = 0;
+            wordindex = 0;
+            mask = ~0ULL;
+        }
+        const unsigned int* dirpages = &pages[(directory - 1) * LEADER_DIR_PAGES];
+        for(; slot < LEADER_DIR_PAGES; slot++, wordindex = 0, mask = ~0ULL)
+        {
+            unsigned int page = dirpages[slot];
+            if(!page)
+                continue;
+            const ULONGLONG* words = &bits[(page - 1) * LEADER_PAGE_WORDS];
+            for(; wordindex < LEADER_PAGE_WORDS; wordindex++, mask = ~0ULL)
+            {
+                ULONGLONG word = words[wordindex] & mask;
+                if(!word)
+                    continue;
+                ULONG_PTR result = start + (((dirindex << LEADER_DIR_SHIFT) + slot) << LEADER_PAGE_SHIFT) + wordindex * 64 + lowestbit(word);
+                if(result > end)
+                    return false;
+                found = result;
+                return true;
+            }
+        }
+    }
+    return false;
+}
@@ -0,0 +1,85 @@
+#ifndef _LEADERBITMAP_H
+#define _LEADERBITMAP_H
+
+#include <windows.h>
+#include <map>
+#include <vector>
+
+#define LEADER_PAGE_SHIFT 12 //one page covers 4096 addresses
+#define LEADER_PAGE_WORDS ((1 << LEADER_PAGE_SHIFT) / 64)
+#define LEADER_DIR_SHIFT 6 //one directory holds 64 pages, 256 KiB of addresses
+#define LEADER_DIR_PAGES (1 << LEADER_DIR_SHIFT)
+#define LEADER_TABLE_DIRS (1 << 16) //ranges up to 16 GiB index their directories with a table, larger ones with a map
+
+//one bit per address of [start, end], directories and pages of bits are only allocated once something is set in them
+class LeaderBitmap
+{
+public:
+    LeaderBitmap();
+    LeaderBitmap(ULONG_PTR start, ULONG_PTR end);
+    void Reset(ULONG_PTR start, ULONG_PTR end); //clears every bit and releases the pages and directories
+
+    //true when addr was not set before, addresses outside of the range are ignored
+    bool Set(ULONG_PTR addr)
+    {
+        if(addr < start || addr > end)
+            return false;
+        ULONG_PTR offset = addr - start;
+        ULONG_PTR dirindex = offset >> (LEADER_PAGE_SHIFT + LEADER_DIR_SHIFT);
+        unsigned int directory = Directory(dirindex);
+        if(!directory)
+            directory = AddDirectory(dirindex);
+        unsigned int & page = pages[(directory - 1) * LEADER_DIR_PAGES + ((offset >> LEADER_PAGE_SHIFT) & (LEADER_DIR_PAGES - 1))];
+        if(!page)
+            page = AddPage();
+        ULONGLONG & word = bits[(page - 1) * LEADER_PAGE_WORDS + ((offset >> 6) & (LEADER_PAGE_WORDS - 1))];
+        ULONGLONG mask = 1ULL << (offset & 63);
+        if(word & mask)
+            return false;
+        word |= mask;
+        count++;
+        return true;
+    }
+
+    bool Test(ULONG_PTR addr) const
+    {
+        if(addr < start || addr > end)
+            return false;
+        ULONG_PTR offset = addr - start;
+        unsigned int directory = Directory(offset >> (LEADER_PAGE_SHIFT + LEADER_DIR_SHIFT));
+        if(!directory)
+            return false;
+        unsigned int page = pages[(directory - 1) * LEADER_DIR_PAGES + ((offset >> LEADER_PAGE_SHIFT) & (LEADER_DIR_PAGES - 1))];
+        if(!page)
+            return false;
+        return (bits[(page - 1) * LEADER_PAGE_WORDS + ((offset >> 6) & (LEADER_PAGE_WORDS - 1))] >> (offset & 63)) & 1;
+    }
+
+    //first set address at or after addr, false if there is none
+    bool Next(ULONG_PTR addr, ULONG_PTR & found) const;
+    size_t Count() const { return count; } //number of set addresses
+
+private:
+    typedef std::map<ULONG_PTR, unsigned int> DIRECTORYMAP;
+
+    //1-based directory number in pages, 0 when not allocated
+    unsigned int Directory(ULONG_PTR dirindex) const
+    {
+        return table.empty() ? MapDirectory(dirindex) : table[dirindex];
+    }
+
+    unsigned int MapDirectory(ULONG_PTR dirindex) const;
+    bool NextDirectory(ULONG_PTR & dirindex, unsigned int & directory) const;
+    unsigned int AddDirectory(ULONG_PTR dirindex);
+    unsigned int AddPage();
+
+    ULONG_PTR start;
+    ULONG_PTR end;
+    std::vector<unsigned int> table; //directory number per directory index of the range, empty for large ranges
+    DIRECTORYMAP directories; //the same for large ranges, only the allocated directories
+    std::vector<unsigned int> pages; //LEADER_DIR_PAGES per directory, 1-based page number in bits, 0 when not allocated
+    std::vector<ULONGLONG> bits;
+    size_t count;
+};
+
+#endif //_LEADERBITMAP_H
@@ -0,0 +1,24 @@
+#ifndef _MD5_H
+#define _MD5_H
+
+#include <windows.h>
+
+#define MD5_DIGEST_SIZE 16
+
+//streaming MD5
+class Md5
+{
+public:
+    Md5();
+    void Reset();
+    void Update(const unsigned char* data, size_t len);
+    void Final(unsigned char digest[MD5_DIGEST_SIZE]);
+
+private:
+    DWORD state[4];
+    ULONGLONG total;
+    unsigned char buffer[64];
+    size_t buffered;
+};
+
+#endif //_MD5_H
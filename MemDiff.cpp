@@ -0,0 +1,125 @@
+#include "MemDiff.h"
+#include "CpuFeatures.h"
+#include <emmintrin.h>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif //_MSC_VER
+
+//first offset where the bytes are equal (equal) or differ (!equal), size if there is none
+typedef size_t (*MEMSCAN)(const unsigned char* a, const unsigned char* b, size_t size, bool equal);
+
+static unsigned int lowestbit(unsigned int value)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, value);
+    return index;
+#else
+    return __builtin_ctz(value);
+#endif //_MSC_VER
+}
+
+static size_t memscan_sw(const unsigned char* a, const unsigned char* b, size_t size, bool equal)
+{
+    size_t i = 0;
+    //eight bytes at a time until a block holds the byte looked for
+    for(; i + 8 <= size; i += 8)
+    {
+        ULONGLONG x, y;
+        memcpy(&x, a + i, sizeof(x));
+        memcpy(&y, b + i, sizeof(y));
+        ULONGLONG diff = x ^ y;
+        bool found = equal ? ((diff - 0x0101010101010101ULL) & ~diff & 0x8080808080808080ULL) != 0 : diff != 0;
+        if(found)
+            break;
+    }
+    for(; i < size; i++)
+        if((a[i] == b[i]) == equal)
+            return i;
+    return size;
+}
+
+TARGET_SSE2 static size_t memscan_sse2(const unsigned char* a, const unsigned char* b, size_t size, bool equal)
+{
+    unsigned int flip = equal ? 0 : 0xFFFF;
+    size_t i = 0;
+    for(; i + 16 <= size; i += 16)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i y = _mm_loadu_si128((const __m128i*)(b + i));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) ^ flip;
+        if(mask)
+            return i + lowestbit(mask);
+    }
+    return i + memscan_sw(a + i, b + i, size - i, equal);
+}
+
+TARGET_AVX2 static size_t memscan_avx2(const unsigned char* a, const unsigned char* b, size_t size, bool equal)
+{
+    unsigned int flip = equal ? 0 : 0xFFFFFFFF;
+    size_t i = 0;
+    //two vectors per iteration, only the rare hit is looked at closer
+    for(; i + 64 <= size; i += 64)
+    {
+        __m256i eq0 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(a + i)), _mm256_loadu_si256((const __m256i*)(b + i)));
+        __m256i eq1 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(a + i + 32)), _mm256_loadu_si256((const __m256i*)(b + i + 32)));
+        unsigned int mask0 = (unsigned int)_mm256_movemask_epi8(eq0) ^ flip;
+        unsigned int mask1 = (unsigned int)_mm256_movemask_epi8(eq1) ^ flip;
+        if(mask0 | mask1)
+        {
+            _mm256_zeroupper();
+            return mask0 ? i + lowestbit(mask0) : i + 32 + lowestbit(mask1);
+        }
+    }
+    for(; i + 32 <= size; i += 32)
+    {
+        __m256i eq = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(a + i)), _mm256_loadu_si256((const __m256i*)(b + i)));
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(eq) ^ flip;
+        if(mask)
+        {
+            _mm256_zeroupper();
+            return i + lowestbit(mask);
+        }
+    }
+    _mm256_zeroupper();
+    return i + memscan_sw(a + i, b + i, size - i, equal);
+}
+
+static MEMSCAN memscan()
+{
+    const cpu_features & features = cpu_get_features();
+    if(features.avx2)
+        return memscan_avx2;
+    if(features.sse2)
+        return memscan_sse2;
+    return memscan_sw;
+}
+
+size_t mem_mismatch(const unsigned char* a, const unsigned char* b, size_t size)
+{
+    return memscan()(a, b, size, false);
+}
+
+size_t mem_match(const unsigned char* a, const unsigned char* b, size_t size)
+{
+    return memscan()(a, b, size, true);
+}
+
+void mem_diff(const unsigned char* a, const unsigned char* b, size_t size, size_t mergeGap, DIFFLIST & ranges)
+{
+    MEMSCAN scan = memscan();
+    size_t first = ranges.size();
+    for(size_t pos = 0; pos < size;)
+    {
+        size_t start = pos + scan(a + pos, b + pos, size - pos, false);
+        if(start >= size)
+            break;
+        size_t end = start + scan(a + start, b + start, size - start, true);
+        if(ranges.size() > first && start - ranges.back().second < mergeGap)
+            ranges.back().second = end;
+        else
+            ranges.push_back(std::make_pair(start, end));
+        pos = end;
+    }
+}
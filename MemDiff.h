@@ -0,0 +1,17 @@
+#ifndef _MEMDIFF_H
+#define _MEMDIFF_H
+
+#include <windows.h>
+#include <utility>
+#include <vector>
+
+typedef std::vector<std::pair<size_t, size_t>> DIFFLIST; //[start, end) offsets
+
+//first offset where a and b differ, size if they are equal
+size_t mem_mismatch(const unsigned char* a, const unsigned char* b, size_t size);
+//first offset where a and b are equal, size if they differ everywhere
+size_t mem_match(const unsigned char* a, const unsigned char* b, size_t size);
+//appends every range where a and b differ, ranges less than mergeGap bytes apart are reported as one
+void mem_diff(const unsigned char* a, const unsigned char* b, size_t size, size_t mergeGap, DIFFLIST & ranges);
+
+#endif //_MEMDIFF_H
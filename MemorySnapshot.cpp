@@ -0,0 +1,186 @@
+#include "MemorySnapshot.h"
+
+#define SNAPSHOT_RUN_PAGES (SNAPSHOT_ARENA_BLOCK / SNAPSHOT_PAGE_SIZE) //most pages read in one call
+
+MemorySnapshot::MemorySnapshot(SNAPSHOTREAD readMemory, size_t maxBytes)
+    : readMemory(readMemory),
+      maxBytes(maxBytes),
+      arenaUsed(0),
+      arenaBytes(0),
+      generation(0)
+{
+    memset(&stats, 0, sizeof(stats));
+}
+
+MemorySnapshot::~MemorySnapshot()
+{
+    Clear();
+}
+
+unsigned char* MemorySnapshot::Allocate(size_t size)
+{
+    if(arena.empty() || arenaUsed + size > SNAPSHOT_ARENA_BLOCK)
+    {
+        arena.push_back(new unsigned char[SNAPSHOT_ARENA_BLOCK]);
+        arenaBytes += SNAPSHOT_ARENA_BLOCK;
+        arenaUsed = 0;
+    }
+    unsigned char* result = arena.back() + arenaUsed;
+    arenaUsed += size;
+    return result;
+}
+
+//reads count pages from base with one call where possible, unreadable pages are zero filled and marked in readable
+//returns the number of calls to the read function
+size_t MemorySnapshot::ReadPages(ULONG_PTR base, unsigned char* data, size_t count, std::vector<unsigned char> & readable)
+{
+    readable.assign(count, 1);
+    if(readMemory(base, data, count * SNAPSHOT_PAGE_SIZE))
+        return 1;
+    //some page in the run is unreadable, find out which
+    for(size_t i = 0; i < count; i++)
+    {
+        unsigned char* page = data + i * SNAPSHOT_PAGE_SIZE;
+        if(!readMemory(base + i * SNAPSHOT_PAGE_SIZE, page, SNAPSHOT_PAGE_SIZE))
+        {
+            memset(page, 0, SNAPSHOT_PAGE_SIZE);
+            readable[i] = 0;
+        }
+    }
+    return count + 1;
+}
+
+size_t MemorySnapshot::Read(ULONG_PTR addr, unsigned char* data, size_t size)
+{
+    size_t unreadable = 0;
+    std::vector<unsigned char> run;
+    std::vector<unsigned char> readable;
+    std::unique_lock<std::mutex> guard(lock);
+    while(size)
+    {
+        ULONG_PTR base = addr & ~(ULONG_PTR)(SNAPSHOT_PAGE_SIZE - 1);
+        size_t offset = (size_t)(addr - base);
+        std::unordered_map<ULONG_PTR, unsigned char*>::const_iterator found = pages.find(base);
+        if(found != pages.end())
+        {
+            stats.hits++;
+            size_t chunk = SNAPSHOT_PAGE_SIZE - offset < size ? SNAPSHOT_PAGE_SIZE - offset : size;
+            if(found->second)
+                memcpy(data, found->second + offset, chunk);
+            else
+            {
+                memset(data, 0, chunk);
+                unreadable++;
+            }
+            addr += chunk;
+            data += chunk;
+            size -= chunk;
+            continue;
+        }
+
+        //the missing pages from base on are read without holding the lock, other readers are not held up by the debuggee
+        size_t count = 1;
+        size_t wanted = (offset + size + SNAPSHOT_PAGE_SIZE - 1) / SNAPSHOT_PAGE_SIZE;
+        while(count < wanted && count < SNAPSHOT_RUN_PAGES && !pages.count(base + count * SNAPSHOT_PAGE_SIZE))
+            count++;
+        ULONGLONG readGeneration = generation;
+        guard.unlock();
+        run.resize(count * SNAPSHOT_PAGE_SIZE);
+        size_t reads = ReadPages(base, run.data(), count, readable);
+        guard.lock();
+        stats.misses += count;
+        stats.reads += reads;
+        //once full, or when pages were dropped meanwhile, the pages are only passed through
+        bool keep = readGeneration == generation && arenaBytes + SNAPSHOT_ARENA_BLOCK <= maxBytes;
+        for(size_t i = 0; i < count && size; i++)
+        {
+            ULONG_PTR page = base + i * SNAPSHOT_PAGE_SIZE;
+            if(keep && !pages.count(page))
+            {
+                unsigned char* copy = 0;
+                if(readable[i])
+                {
+                    copy = Allocate(SNAPSHOT_PAGE_SIZE);
+                    memcpy(copy, run.data() + i * SNAPSHOT_PAGE_SIZE, SNAPSHOT_PAGE_SIZE);
+                }
+                pages[page] = copy;
+            }
+            size_t chunk = SNAPSHOT_PAGE_SIZE - offset < size ? SNAPSHOT_PAGE_SIZE - offset : size;
+            memcpy(data, run.data() + i * SNAPSHOT_PAGE_SIZE + offset, chunk);
+            if(!readable[i])
+                unreadable++;
+            offset = 0;
+            addr += chunk;
+            data += chunk;
+            size -= chunk;
+        }
+    }
+    return unreadable;
+}
+
+size_t MemorySnapshot::ReadDirect(ULONG_PTR addr, unsigned char* data, size_t size)
+{
+    if(!size || readMemory(addr, data, size))
+        return 0;
+    size_t unreadable = 0;
+    while(size)
+    {
+        ULONG_PTR base = addr & ~(ULONG_PTR)(SNAPSHOT_PAGE_SIZE - 1);
+        size_t chunk = SNAPSHOT_PAGE_SIZE - (size_t)(addr - base) < size ? SNAPSHOT_PAGE_SIZE - (size_t)(addr - base) : size;
+        if(!readMemory(addr, data, chunk))
+        {
+            memset(data, 0, chunk);
+            unreadable++;
+        }
+        addr += chunk;
+        data += chunk;
+        size -= chunk;
+    }
+    return unreadable;
+}
+
+void MemorySnapshot::Invalidate(ULONG_PTR start, ULONG_PTR end)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    generation++;
+    ULONG_PTR first = start & ~(ULONG_PTR)(SNAPSHOT_PAGE_SIZE - 1);
+    ULONG_PTR last = end & ~(ULONG_PTR)(SNAPSHOT_PAGE_SIZE - 1);
+    //the copies stay in the arena until Clear, a page read again gets new space
+    if((last - first) / SNAPSHOT_PAGE_SIZE < pages.size())
+    {
+        for(ULONG_PTR base = first;; base += SNAPSHOT_PAGE_SIZE)
+        {
+            pages.erase(base);
+            if(base == last)
+                break;
+        }
+        return;
+    }
+    for(std::unordered_map<ULONG_PTR, unsigned char*>::iterator i = pages.begin(); i != pages.end();)
+    {
+        if(i->first >= first && i->first <= last)
+            i = pages.erase(i);
+        else
+            ++i;
+    }
+}
+
+void MemorySnapshot::Clear()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    generation++;
+    pages.clear();
+    for(size_t i = 0; i < arena.size(); i++)
+        delete[] arena[i];
+    arena.clear();
+    arenaUsed = 0;
+    arenaBytes = 0;
+}
+
+snapshot_stats MemorySnapshot::Stats()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    snapshot_stats result = stats;
+    result.pages = pages.size();
+    return result;
+}
@@ -0,0 +1,56 @@
+#ifndef _MEMORYSNAPSHOT_H
+#define _MEMORYSNAPSHOT_H
+
+#include <windows.h>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#define SNAPSHOT_PAGE_SIZE 0x1000
+#define SNAPSHOT_ARENA_BLOCK 0x100000 //pages are carved out of blocks this big
+#define SNAPSHOT_MAX_BYTES 0x10000000 //pages past this are read but not kept
+
+//same signature as DbgMemRead
+typedef bool(*SNAPSHOTREAD)(ULONG_PTR addr, unsigned char* data, ULONG_PTR size);
+
+struct snapshot_stats
+{
+    ULONGLONG hits; //pages served from the snapshot
+    ULONGLONG misses; //pages that had to be read
+    ULONGLONG reads; //calls to the read function
+    size_t pages; //pages kept, unreadable ones included
+};
+
+//copy of the memory of a paused process, each page is read on first use and served from the copy afterwards
+//only valid until the process runs again, Clear drops everything
+class MemorySnapshot
+{
+public:
+    explicit MemorySnapshot(SNAPSHOTREAD readMemory, size_t maxBytes = SNAPSHOT_MAX_BYTES);
+    ~MemorySnapshot();
+    //unreadable pages are zero filled, returns how many of them the range touched
+    size_t Read(ULONG_PTR addr, unsigned char* data, size_t size);
+    //same as Read but nothing is kept, for bulk reads that would only push small repeated ones out
+    size_t ReadDirect(ULONG_PTR addr, unsigned char* data, size_t size);
+    void Invalidate(ULONG_PTR start, ULONG_PTR end);
+    void Clear();
+    snapshot_stats Stats();
+
+private:
+    MemorySnapshot(const MemorySnapshot &);
+    MemorySnapshot & operator=(const MemorySnapshot &);
+    size_t ReadPages(ULONG_PTR base, unsigned char* data, size_t count, std::vector<unsigned char> & readable);
+    unsigned char* Allocate(size_t size);
+
+    SNAPSHOTREAD readMemory;
+    size_t maxBytes;
+    std::unordered_map<ULONG_PTR, unsigned char*> pages; //page address -> copy, 0 when unreadable
+    std::vector<unsigned char*> arena;
+    size_t arenaUsed; //bytes used in the last arena block
+    size_t arenaBytes; //bytes in all arena blocks
+    ULONGLONG generation; //changes whenever pages are dropped, so pages read meanwhile are not kept
+    std::mutex lock;
+    snapshot_stats stats;
+};
+
+#endif //_MEMORYSNAPSHOT_H
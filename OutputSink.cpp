@@ -0,0 +1,116 @@
+#include "OutputSink.h"
+#include <stdarg.h>
+
+#ifdef _WIN32
+FileSink::FileSink(const wchar_t* szFileName)
+{
+    hFile = CreateFileW(szFileName, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+}
+
+FileSink::~FileSink()
+{
+    if(hFile != INVALID_HANDLE_VALUE)
+        CloseHandle(hFile);
+}
+
+bool FileSink::Write(const void* data, size_t size)
+{
+    const char* ptr = (const char*)data;
+    while(size)
+    {
+        DWORD chunk = size > 0x40000000 ? 0x40000000 : (DWORD)size;
+        DWORD written = 0;
+        if(!WriteFile(hFile, ptr, chunk, &written, NULL) || !written)
+            return false;
+        ptr += written;
+        size -= written;
+    }
+    return true;
+}
+#endif //_WIN32
+
+bool StdioSink::Write(const void* data, size_t size)
+{
+    return fwrite(data, 1, size, file) == size;
+}
+
+bool MemorySink::Write(const void* data, size_t size)
+{
+    this->data.append((const char*)data, size);
+    return true;
+}
+
+BufferedWriter::BufferedWriter(OutputSink & sink, size_t bufferSize)
+    : sink(sink),
+      buffer(bufferSize ? bufferSize : OUTPUT_BUFFER_SIZE),
+      used(0),
+      failed(false)
+{
+}
+
+BufferedWriter::~BufferedWriter()
+{
+    Flush();
+}
+
+void BufferedWriter::Write(const void* data, size_t size)
+{
+    if(used + size > buffer.size())
+    {
+        Flush();
+        //anything bigger than the buffer goes straight through
+        if(size >= buffer.size())
+        {
+            if(!failed && !sink.Write(data, size))
+                failed = true;
+            return;
+        }
+    }
+    memcpy(&buffer[used], data, size);
+    used += size;
+}
+
+void BufferedWriter::Pointer(ULONG_PTR value)
+{
+    const char* digits = "0123456789ABCDEF";
+    char text[sizeof(ULONG_PTR) * 2];
+    for(int i = sizeof(text) - 1; i >= 0; i--)
+    {
+        text[i] = digits[value & 0xF];
+        value >>= 4;
+    }
+    Write(text, sizeof(text));
+}
+
+void BufferedWriter::Decimal(ULONG_PTR value)
+{
+    char text[24];
+    int i = sizeof(text);
+    do
+    {
+        text[--i] = '0' + value % 10;
+        value /= 10;
+    }
+    while(value);
+    Write(text + i, sizeof(text) - i);
+}
+
+void BufferedWriter::Printf(const char* format, ...)
+{
+    char text[1024];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    if(len < 0 || len >= (int)sizeof(text))
+        len = sizeof(text) - 1;
+    Write(text, len);
+}
+
+bool BufferedWriter::Flush()
+{
+    if(used && !failed && !sink.Write(&buffer[0], used))
+        failed = true;
+    used = 0;
+    return !failed;
+}
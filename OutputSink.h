@@ -0,0 +1,86 @@
+#ifndef _OUTPUTSINK_H
+#define _OUTPUTSINK_H
+
+#include <windows.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+//destination for generated output, writes arrive in large blocks from a BufferedWriter
+class OutputSink
+{
+public:
+    virtual ~OutputSink() {}
+    virtual bool Write(const void* data, size_t size) = 0;
+};
+
+#ifdef _WIN32
+class FileSink : public OutputSink
+{
+public:
+    explicit FileSink(const wchar_t* szFileName);
+    ~FileSink();
+    bool IsOpen() const { return hFile != INVALID_HANDLE_VALUE; }
+    bool Write(const void* data, size_t size);
+
+private:
+    FileSink(const FileSink &);
+    FileSink & operator=(const FileSink &);
+
+    HANDLE hFile;
+};
+#endif //_WIN32
+
+class StdioSink : public OutputSink
+{
+public:
+    explicit StdioSink(FILE* file) : file(file) {}
+    bool Write(const void* data, size_t size);
+
+private:
+    FILE* file;
+};
+
+class MemorySink : public OutputSink
+{
+public:
+    bool Write(const void* data, size_t size);
+    const std::string & Data() const { return data; }
+
+private:
+    std::string data;
+};
+
+#define OUTPUT_BUFFER_SIZE 0x40000
+
+//formats into a large buffer and hands it to the sink only when full
+class BufferedWriter
+{
+public:
+    explicit BufferedWriter(OutputSink & sink, size_t bufferSize = OUTPUT_BUFFER_SIZE);
+    ~BufferedWriter();
+    void Write(const void* data, size_t size);
+    void Puts(const char* str) { Write(str, strlen(str)); }
+    void Putc(char c)
+    {
+        if(used == buffer.size())
+            Flush();
+        buffer[used++] = c;
+    }
+    void Pointer(ULONG_PTR value); //same as "%p" with the Microsoft CRT
+    void Decimal(ULONG_PTR value);
+    void Printf(const char* format, ...);
+    bool Flush();
+    bool Failed() const { return failed; }
+
+private:
+    BufferedWriter(const BufferedWriter &);
+    BufferedWriter & operator=(const BufferedWriter &);
+
+    OutputSink & sink;
+    std::vector<char> buffer;
+    size_t used;
+    bool failed;
+};
+
+#endif //_OUTPUTSINK_H
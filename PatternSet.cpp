@@ -0,0 +1,194 @@
+#include "PatternSet.h"
+
+#define PATTERN_OUTPUT 0x80000000
+#define PATTERN_LANES 4
+#define PATTERN_MIN_LANE 0x1000 //smaller data is scanned as one lane
+
+PatternSet::PatternSet()
+    : maxSize(0),
+      classes(1),
+      stateCount(0)
+{
+    memset(classmap, 0, sizeof(classmap));
+}
+
+int PatternSet::Add(const char* pattern, const char* name)
+{
+    Signature sig;
+    if(!sig.Compile(pattern))
+        return -1;
+    //the rarest window of known bytes among the longest ones
+    size_t bestOffset = 0;
+    size_t bestSize = 0;
+    unsigned int bestRank = ~0u;
+    for(size_t start = 0; start < sig.Size(); start++)
+    {
+        size_t size = 0;
+        unsigned int rank = 0;
+        while(size < PATTERN_MAX_ATOM && start + size < sig.Size() && sig.Known(start + size))
+            rank += Signature::Rank(sig.Byte(start + size++));
+        if(size > bestSize || (size && size == bestSize && rank < bestRank))
+        {
+            bestOffset = start;
+            bestSize = size;
+            bestRank = rank;
+        }
+    }
+    if(!bestSize)
+        return -1;
+    patterns.push_back(sig);
+    names.push_back(name);
+    atomOffset.push_back(bestOffset);
+    atomSize.push_back(bestSize);
+    if(sig.Size() > maxSize)
+        maxSize = sig.Size();
+    return (int)patterns.size() - 1;
+}
+
+void PatternSet::Build()
+{
+    //every byte value an atom uses gets its own class
+    memset(classmap, 0, sizeof(classmap));
+    classes = 1;
+    for(size_t i = 0; i < patterns.size(); i++)
+    {
+        for(size_t j = 0; j < atomSize[i]; j++)
+        {
+            unsigned char value = patterns[i].Byte(atomOffset[i] + j);
+            if(!classmap[value])
+                classmap[value] = classes++;
+        }
+    }
+
+    //trie of the atoms, 0 is a missing edge since nothing goes back to the root
+    table.assign(classes, 0);
+    stateCount = 1;
+    std::vector<std::vector<unsigned int>> output(1);
+    for(size_t i = 0; i < patterns.size(); i++)
+    {
+        unsigned int state = 0;
+        for(size_t j = 0; j < atomSize[i]; j++)
+        {
+            size_t edge = state * classes + classmap[patterns[i].Byte(atomOffset[i] + j)];
+            if(!table[edge])
+            {
+                table[edge] = (unsigned int)stateCount++;
+                table.resize(stateCount * classes, 0);
+                output.push_back(std::vector<unsigned int>());
+            }
+            state = table[edge];
+        }
+        output[state].push_back((unsigned int)i);
+    }
+
+    //breadth first, so the fail state of a state is always complete when it is reached
+    //missing edges become the edge of the fail state, which turns the trie into a full automaton
+    std::vector<unsigned int> fail(stateCount, 0);
+    std::vector<unsigned int> queue;
+    queue.reserve(stateCount);
+    for(unsigned int c = 0; c < classes; c++)
+        if(table[c])
+            queue.push_back(table[c]);
+    for(size_t head = 0; head < queue.size(); head++)
+    {
+        unsigned int state = queue[head];
+        const std::vector<unsigned int> & inherited = output[fail[state]];
+        output[state].insert(output[state].end(), inherited.begin(), inherited.end());
+        for(unsigned int c = 0; c < classes; c++)
+        {
+            unsigned int & next = table[state * classes + c];
+            unsigned int fallback = table[fail[state] * classes + c];
+            if(next)
+            {
+                fail[next] = fallback;
+                queue.push_back(next);
+            }
+            else
+                next = fallback;
+        }
+    }
+
+    outputStart.assign(stateCount + 1, 0);
+    outputs.clear();
+    for(size_t i = 0; i < stateCount; i++)
+    {
+        outputStart[i] = (unsigned int)outputs.size();
+        outputs.insert(outputs.end(), output[i].begin(), output[i].end());
+    }
+    outputStart[stateCount] = (unsigned int)outputs.size();
+
+    //row offsets instead of states keep the multiply out of the scan loop
+    for(size_t i = 0; i < table.size(); i++)
+    {
+        unsigned int next = table[i];
+        table[i] = next * classes | (output[next].empty() ? 0 : PATTERN_OUTPUT);
+    }
+}
+
+void PatternSet::Report(const unsigned char* data, size_t size, size_t pos, unsigned int row, std::vector<pattern_match> & matches) const
+{
+    unsigned int state = row / classes;
+    for(unsigned int i = outputStart[state]; i < outputStart[state + 1]; i++)
+    {
+        unsigned int pattern = outputs[i];
+        size_t atomEnd = atomOffset[pattern] + atomSize[pattern];
+        if(pos + 1 < atomEnd)
+            continue;
+        size_t start = pos + 1 - atomEnd;
+        if(size - start < patterns[pattern].Size() || !patterns[pattern].Match(data + start))
+            continue;
+        pattern_match match = { start, pattern };
+        matches.push_back(match);
+    }
+}
+
+void PatternSet::Scan(const unsigned char* data, size_t size, std::vector<pattern_match> & matches) const
+{
+    if(table.empty())
+        return;
+    const unsigned int* rows = table.data();
+    size_t laneSize = size / PATTERN_LANES;
+    if(laneSize < PATTERN_MIN_LANE)
+    {
+        unsigned int row = 0;
+        for(size_t i = 0; i < size; i++)
+        {
+            unsigned int next = rows[row + classmap[data[i]]];
+            row = next & ~PATTERN_OUTPUT;
+            if(next & PATTERN_OUTPUT)
+                Report(data, size, i, row, matches);
+        }
+        return;
+    }
+
+    //each step of the automaton waits for the previous one, independent lanes keep several in flight
+    //a lane starts PATTERN_MAX_ATOM - 1 bytes early, that is all the history a state depends on
+    unsigned int row[PATTERN_LANES];
+    size_t base[PATTERN_LANES];
+    for(size_t lane = 0; lane < PATTERN_LANES; lane++)
+    {
+        base[lane] = lane * laneSize;
+        row[lane] = 0;
+        for(size_t i = lane ? base[lane] - (PATTERN_MAX_ATOM - 1) : 0; i < base[lane]; i++)
+            row[lane] = rows[row[lane] + classmap[data[i]]] & ~PATTERN_OUTPUT;
+    }
+    for(size_t i = 0; i < laneSize; i++)
+    {
+        for(size_t lane = 0; lane < PATTERN_LANES; lane++)
+        {
+            unsigned int next = rows[row[lane] + classmap[data[base[lane] + i]]];
+            row[lane] = next & ~PATTERN_OUTPUT;
+            if(next & PATTERN_OUTPUT)
+                Report(data, size, base[lane] + i, row[lane], matches);
+        }
+    }
+    //the last lane also takes what is left after the split
+    unsigned int last = row[PATTERN_LANES - 1];
+    for(size_t i = PATTERN_LANES * laneSize; i < size; i++)
+    {
+        unsigned int next = rows[last + classmap[data[i]]];
+        last = next & ~PATTERN_OUTPUT;
+        if(next & PATTERN_OUTPUT)
+            Report(data, size, i, last, matches);
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef _PATTERNSET_H
+#define _PATTERNSET_H
+
+#include "Signature.h"
+#include <string>
+#include <vector>
+
+#define PATTERN_MAX_ATOM 4 //longest run of known bytes put in the automaton for one pattern
+
+struct pattern_match
+{
+    size_t offset;
+    unsigned int pattern; //index returned by Add
+};
+
+//many signatures searched for in a single pass
+//an atom of each pattern (its rarest run of known bytes) goes into an Aho-Corasick automaton,
+//the whole pattern is only compared where its atom was found
+class PatternSet
+{
+public:
+    PatternSet();
+    //returns the index of the pattern, -1 if it is invalid or has no known byte
+    int Add(const char* pattern, const char* name = "");
+    //compiles the automaton, call after the last Add
+    void Build();
+    size_t Count() const { return patterns.size(); }
+    size_t MaxSize() const { return maxSize; }
+    size_t StateCount() const { return stateCount; }
+    const std::string & Name(unsigned int pattern) const { return names[pattern]; }
+    //appends every match that fits in the data, not sorted by offset
+    void Scan(const unsigned char* data, size_t size, std::vector<pattern_match> & matches) const;
+
+private:
+    void Report(const unsigned char* data, size_t size, size_t pos, unsigned int row, std::vector<pattern_match> & matches) const;
+
+    std::vector<Signature> patterns;
+    std::vector<std::string> names;
+    std::vector<size_t> atomOffset; //where the atom starts in its pattern
+    std::vector<size_t> atomSize;
+    size_t maxSize;
+
+    //dense transition table, one row of classes entries per state
+    //entries are the row offset of the next state, the high bit is set when atoms end there
+    unsigned short classmap[256]; //byte value -> class, 0 for bytes no atom uses
+    unsigned int classes;
+    size_t stateCount;
+    std::vector<unsigned int> table;
+    std::vector<unsigned int> outputStart; //per state, into outputs
+    std::vector<unsigned int> outputs; //patterns whose atom ends in a state, fail links included
+};
+
+#endif //_PATTERNSET_H
@@ -0,0 +1,119 @@
+#include "RegionScanner.h"
+#include "ThreadPool.h"
+#include <condition_variable>
+#include <mutex>
+#include <queue>
+#include <thread>
+
+#define REGION_BUFFERS_PER_WORKER 2
+
+struct ready_chunk
+{
+    scan_chunk chunk;
+    size_t buffer;
+};
+
+RegionScanner::RegionScanner(const SCANREAD & read, size_t chunkSize, size_t overlap, size_t workers)
+    : read(read),
+      chunkSize(chunkSize ? chunkSize : REGION_CHUNK_SIZE),
+      overlap(overlap),
+      workers(workers)
+{
+    if(!this->workers)
+        this->workers = std::thread::hardware_concurrency();
+    if(!this->workers)
+        this->workers = 1;
+}
+
+scan_stats RegionScanner::Run(const std::vector<memory_region> & regions, const SCANTASK & task, const SCANDONE & done)
+{
+    scan_stats stats = { 0, 0, 0, 0 };
+    std::vector<std::vector<unsigned char>> buffers(workers * REGION_BUFFERS_PER_WORKER);
+    std::vector<size_t> freeBuffers;
+    for(size_t i = 0; i < buffers.size(); i++)
+        freeBuffers.push_back(i);
+    std::queue<ready_chunk> ready;
+    bool finished = false;
+    std::mutex lock;
+    std::condition_variable bufferFree;
+    std::condition_variable chunkReady;
+
+    ThreadPool pool(workers);
+    for(size_t worker = 0; worker < workers; worker++)
+    {
+        pool.Enqueue([&, worker]()
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            while(true)
+            {
+                if(ready.empty() && !finished)
+                {
+                    stats.workerStalls++;
+                    chunkReady.wait(guard, [&]() { return !ready.empty() || finished; });
+                }
+                if(ready.empty())
+                    break;
+                ready_chunk next = ready.front();
+                ready.pop();
+                guard.unlock();
+                task(next.chunk, worker);
+                guard.lock();
+                freeBuffers.push_back(next.buffer);
+                bufferFree.notify_one();
+            }
+            guard.unlock();
+            if(done)
+                done(worker);
+        });
+    }
+
+    for(size_t i = 0; i < regions.size(); i++)
+    {
+        const memory_region & region = regions[i];
+        for(ULONG_PTR offset = 0; offset < region.size; offset += chunkSize)
+        {
+            size_t buffer;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                if(freeBuffers.empty())
+                {
+                    stats.readerStalls++;
+                    bufferFree.wait(guard, [&]() { return !freeBuffers.empty(); });
+                }
+                buffer = freeBuffers.back();
+                freeBuffers.pop_back();
+            }
+
+            //buffers only ever grow, so they are allocated once
+            ready_chunk next;
+            next.buffer = buffer;
+            next.chunk.base = region.base + offset;
+            next.chunk.size = region.size - offset < chunkSize + overlap ? (size_t)(region.size - offset) : chunkSize + overlap;
+            bool last = offset + next.chunk.size == region.size;
+            next.chunk.keep = last ? next.chunk.size : chunkSize;
+            next.chunk.region = i;
+            if(buffers[buffer].size() < next.chunk.size)
+                buffers[buffer].resize(next.chunk.size);
+            read(next.chunk.base, buffers[buffer].data(), next.chunk.size);
+            next.chunk.data = buffers[buffer].data();
+
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                ready.push(next);
+                stats.chunks++;
+                stats.bytes += next.chunk.keep;
+            }
+            chunkReady.notify_one();
+            if(last)
+                break;
+        }
+    }
+
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        finished = true;
+    }
+    chunkReady.notify_all();
+    pool.Wait();
+    return stats;
+}
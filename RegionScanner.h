@@ -0,0 +1,57 @@
+#ifndef _REGIONSCANNER_H
+#define _REGIONSCANNER_H
+
+#include <windows.h>
+#include <functional>
+#include <vector>
+
+#define REGION_CHUNK_SIZE 0x100000
+
+struct memory_region
+{
+    ULONG_PTR base;
+    ULONG_PTR size;
+};
+
+struct scan_chunk
+{
+    ULONG_PTR base; //address of data[0]
+    const unsigned char* data;
+    size_t size; //the chunk and the overlap after it
+    size_t keep; //matches starting here or later are found again by the next chunk of the region
+    size_t region; //index in the region list
+};
+
+struct scan_stats
+{
+    size_t chunks;
+    ULONGLONG bytes; //region bytes, overlaps not counted twice
+    size_t readerStalls; //every buffer was still being worked on, the workers are the bottleneck
+    size_t workerStalls; //a worker found nothing to do, reading is the bottleneck
+};
+
+//fills data, unreadable memory has to be zero filled
+typedef std::function<void(ULONG_PTR addr, unsigned char* data, size_t size)> SCANREAD;
+//called on a worker thread, worker is 0..Workers()-1 for per worker state
+typedef std::function<void(const scan_chunk & chunk, size_t worker)> SCANTASK;
+typedef std::function<void(size_t worker)> SCANDONE;
+
+//reads regions chunk by chunk on the calling thread while workers process the chunks read before
+//every worker has two buffers, one it works on and one the reader fills next
+class RegionScanner
+{
+public:
+    //workers 0 uses one per logical processor
+    RegionScanner(const SCANREAD & read, size_t chunkSize = REGION_CHUNK_SIZE, size_t overlap = 0, size_t workers = 0);
+    size_t Workers() const { return workers; }
+    //returns once every chunk is processed, done (if set) runs on each worker thread at the end
+    scan_stats Run(const std::vector<memory_region> & regions, const SCANTASK & task, const SCANDONE & done = SCANDONE());
+
+private:
+    SCANREAD read;
+    size_t chunkSize;
+    size_t overlap;
+    size_t workers;
+};
+
+#endif //_REGIONSCANNER_H
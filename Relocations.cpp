@@ -0,0 +1,192 @@
+#include "Relocations.h"
+#include <stdarg.h>
+#include <stdio.h>
+
+#define RELOC_PAGE_SIZE 0x1000
+
+RelocTable::RelocTable()
+    : size(0),
+      blocks(0),
+      problems(0)
+{
+    memset(types, 0, sizeof(types));
+}
+
+void RelocTable::Problem(const char* format, ...)
+{
+    if(!problems++)
+    {
+        char text[256];
+        va_list args;
+        va_start(args, format);
+        vsnprintf(text, sizeof(text), format, args);
+        va_end(args);
+        firstProblem = text;
+    }
+}
+
+const char* RelocTable::TypeName(unsigned int type)
+{
+    static const char* names[RELOC_TYPES] =
+    {
+        "ABSOLUTE", "HIGH", "LOW", "HIGHLOW", "HIGHADJ", "MACHINE_5", "RESERVED", "MACHINE_7",
+        "MACHINE_8", "MACHINE_9", "DIR64", "TYPE_11", "TYPE_12", "TYPE_13", "TYPE_14", "TYPE_15"
+    };
+    return type < RELOC_TYPES ? names[type] : "?";
+}
+
+//bytes of the field a relocation type changes, 0 for types that are not applied
+static unsigned int fieldsize(unsigned int type)
+{
+    switch(type)
+    {
+    case IMAGE_REL_BASED_HIGH:
+    case IMAGE_REL_BASED_LOW:
+    case IMAGE_REL_BASED_HIGHADJ:
+        return 2;
+    case IMAGE_REL_BASED_HIGHLOW:
+        return 4;
+    case IMAGE_REL_BASED_DIR64:
+        return 8;
+    default:
+        return 0;
+    }
+}
+
+reloc_status RelocTable::Parse(const unsigned char* data, size_t datasize, DWORD imageSize)
+{
+    size = 0;
+    blocks = 0;
+    entries.clear();
+    memset(types, 0, sizeof(types));
+    problems = 0;
+    firstProblem.clear();
+    entries.reserve(datasize / 2);
+
+    size_t offset = 0;
+    while(true)
+    {
+        if(datasize - offset < sizeof(IMAGE_BASE_RELOCATION))
+            return RELOC_TRUNCATED;
+        IMAGE_BASE_RELOCATION block;
+        memcpy(&block, data + offset, sizeof(block));
+        if(!block.SizeOfBlock)
+            return RELOC_OK;
+        if(block.SizeOfBlock < sizeof(IMAGE_BASE_RELOCATION))
+        {
+            Problem("block at +%X is smaller than its header (%X bytes)", (unsigned int)offset, (unsigned int)block.SizeOfBlock);
+            return RELOC_INVALID;
+        }
+        if(block.SizeOfBlock > datasize - offset)
+            return RELOC_TRUNCATED;
+        if(block.SizeOfBlock % 2)
+            Problem("block at +%X has an odd size (%X bytes)", (unsigned int)offset, (unsigned int)block.SizeOfBlock);
+        if(block.VirtualAddress % RELOC_PAGE_SIZE)
+            Problem("block at +%X is for an unaligned page (rva %X)", (unsigned int)offset, (unsigned int)block.VirtualAddress);
+        if(imageSize && block.VirtualAddress >= imageSize)
+            Problem("block at +%X is for a page outside of the image (rva %X)", (unsigned int)offset, (unsigned int)block.VirtualAddress);
+
+        const unsigned char* words = data + offset + sizeof(IMAGE_BASE_RELOCATION);
+        size_t count = (block.SizeOfBlock - sizeof(IMAGE_BASE_RELOCATION)) / 2;
+        for(size_t i = 0; i < count; i++)
+        {
+            WORD word;
+            memcpy(&word, words + i * 2, sizeof(word));
+            reloc_entry entry;
+            entry.type = word >> 12;
+            entry.rva = block.VirtualAddress + (word & 0xFFF);
+            entry.adjust = 0;
+            types[entry.type]++;
+            if(entry.type == IMAGE_REL_BASED_ABSOLUTE)
+                continue;
+            unsigned int field = fieldsize(entry.type);
+            if(!field)
+            {
+                Problem("unsupported relocation type %s at rva %X", TypeName(entry.type), (unsigned int)entry.rva);
+                continue;
+            }
+            if(entry.type == IMAGE_REL_BASED_HIGHADJ)
+            {
+                //the next slot holds the low half of the value
+                if(++i == count)
+                {
+                    Problem("HIGHADJ at rva %X is missing its parameter", (unsigned int)entry.rva);
+                    break;
+                }
+                memcpy(&entry.adjust, words + i * 2, sizeof(entry.adjust));
+            }
+            if(imageSize && (entry.rva >= imageSize || imageSize - entry.rva < field))
+                Problem("%s at rva %X is outside of the image", TypeName(entry.type), (unsigned int)entry.rva);
+            entries.push_back(entry);
+        }
+
+        size += block.SizeOfBlock;
+        offset += block.SizeOfBlock;
+        blocks++;
+        if(!block.VirtualAddress)
+            return RELOC_OK;
+    }
+}
+
+size_t RelocTable::Apply(unsigned char* image, size_t imageSize, ULONGLONG delta) const
+{
+    size_t applied = 0;
+    for(size_t i = 0; i < entries.size(); i++)
+    {
+        const reloc_entry & entry = entries[i];
+        unsigned int field = fieldsize(entry.type);
+        if(entry.rva >= imageSize || imageSize - entry.rva < field)
+            continue;
+        unsigned char* ptr = image + entry.rva;
+        switch(entry.type)
+        {
+        case IMAGE_REL_BASED_HIGH:
+        {
+            WORD value;
+            memcpy(&value, ptr, sizeof(value));
+            value += (WORD)(delta >> 16);
+            memcpy(ptr, &value, sizeof(value));
+        }
+        break;
+
+        case IMAGE_REL_BASED_LOW:
+        {
+            WORD value;
+            memcpy(&value, ptr, sizeof(value));
+            value += (WORD)delta;
+            memcpy(ptr, &value, sizeof(value));
+        }
+        break;
+
+        case IMAGE_REL_BASED_HIGHLOW:
+        {
+            DWORD value;
+            memcpy(&value, ptr, sizeof(value));
+            value += (DWORD)delta;
+            memcpy(ptr, &value, sizeof(value));
+        }
+        break;
+
+        case IMAGE_REL_BASED_HIGHADJ:
+        {
+            WORD high;
+            memcpy(&high, ptr, sizeof(high));
+            DWORD value = ((DWORD)high << 16) + (DWORD)(LONG)(short)entry.adjust + (DWORD)delta;
+            high = (WORD)((value + 0x8000) >> 16);
+            memcpy(ptr, &high, sizeof(high));
+        }
+        break;
+
+        case IMAGE_REL_BASED_DIR64:
+        {
+            ULONGLONG value;
+            memcpy(&value, ptr, sizeof(value));
+            value += delta;
+            memcpy(ptr, &value, sizeof(value));
+        }
+        break;
+        }
+        applied++;
+    }
+    return applied;
+}
@@ -0,0 +1,53 @@
+#ifndef _RELOCATIONS_H
+#define _RELOCATIONS_H
+
+#include <windows.h>
+#include <string>
+#include <vector>
+
+#define RELOC_TYPES 16
+
+struct reloc_entry
+{
+    DWORD rva; //relocated field
+    unsigned char type; //IMAGE_REL_BASED_*
+    WORD adjust; //low half of the value, only for IMAGE_REL_BASED_HIGHADJ
+};
+
+enum reloc_status
+{
+    RELOC_OK, //ended by an empty block or the block for rva 0, like the original grs
+    RELOC_TRUNCATED, //the data ended before the table did, parse a longer buffer
+    RELOC_INVALID //a block too small for its own header, nothing after it can be trusted
+};
+
+//base relocation directory, parsed and checked block by block
+class RelocTable
+{
+public:
+    RelocTable();
+    //imageSize 0 skips the checks against the image bounds
+    reloc_status Parse(const unsigned char* data, size_t size, DWORD imageSize);
+    size_t Size() const { return size; } //bytes of every parsed block
+    size_t BlockCount() const { return blocks; }
+    const std::vector<reloc_entry> & Entries() const { return entries; } //without IMAGE_REL_BASED_ABSOLUTE padding
+    size_t TypeCount(unsigned int type) const { return type < RELOC_TYPES ? types[type] : 0; }
+    size_t ProblemCount() const { return problems; }
+    const std::string & FirstProblem() const { return firstProblem; }
+    //adds delta to every relocated field of an image laid out by rva, returns how many were applied
+    size_t Apply(unsigned char* image, size_t imageSize, ULONGLONG delta) const;
+
+    static const char* TypeName(unsigned int type);
+
+private:
+    void Problem(const char* format, ...);
+
+    size_t size;
+    size_t blocks;
+    std::vector<reloc_entry> entries;
+    size_t types[RELOC_TYPES];
+    size_t problems;
+    std::string firstProblem;
+};
+
+#endif //_RELOCATIONS_H
@@ -0,0 +1,200 @@
+#include "Sha256.h"
+#include "CpuFeatures.h"
+#include <immintrin.h>
+
+typedef void (*SHA256BLOCKS)(DWORD state[8], const unsigned char* data, size_t blocks);
+
+static const DWORD sha256_k[64] =
+{
+    0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+    0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+    0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+    0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+    0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+    0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+    0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+    0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+};
+
+static inline DWORD rotr32(DWORD x, int r)
+{
+    return (x >> r) | (x << (32 - r));
+}
+
+static void sha256_blocks_scalar(DWORD state[8], const unsigned char* data, size_t blocks)
+{
+    DWORD w[64];
+    while(blocks--)
+    {
+        for(int i = 0; i < 16; i++)
+            w[i] = (DWORD)data[i * 4] << 24 | (DWORD)data[i * 4 + 1] << 16 | (DWORD)data[i * 4 + 2] << 8 | data[i * 4 + 3];
+        for(int i = 16; i < 64; i++)
+        {
+            DWORD s0 = rotr32(w[i - 15], 7) ^ rotr32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            DWORD s1 = rotr32(w[i - 2], 17) ^ rotr32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        DWORD a = state[0], b = state[1], c = state[2], d = state[3];
+        DWORD e = state[4], f = state[5], g = state[6], h = state[7];
+        for(int i = 0; i < 64; i++)
+        {
+            DWORD t1 = h + (rotr32(e, 6) ^ rotr32(e, 11) ^ rotr32(e, 25)) + ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+            DWORD t2 = (rotr32(a, 2) ^ rotr32(a, 13) ^ rotr32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+        data += 64;
+    }
+}
+
+//four rounds on the SHA extensions, msg holds the next four schedule words
+#define SHA256_ROUNDS4(msg, i) \
+    tmp = _mm_add_epi32(msg, _mm_loadu_si128((const __m128i*)&sha256_k[i])); \
+    state1 = _mm_sha256rnds2_epu32(state1, state0, tmp); \
+    tmp = _mm_shuffle_epi32(tmp, 0x0E); \
+    state0 = _mm_sha256rnds2_epu32(state0, state1, tmp)
+
+//extend the schedule: m0 = f(m0, m1, m2, m3) for the next four words
+#define SHA256_SCHEDULE(m0, m1, m2, m3) \
+    m0 = _mm_sha256msg1_epu32(m0, m1); \
+    m0 = _mm_add_epi32(m0, _mm_alignr_epi8(m3, m2, 4)); \
+    m0 = _mm_sha256msg2_epu32(m0, m3)
+
+TARGET_SHA static void sha256_blocks_shani(DWORD state[8], const unsigned char* data, size_t blocks)
+{
+    const __m128i byteswap = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    //the instructions want the state as ABEF and CDGH
+    __m128i tmp = _mm_loadu_si128((const __m128i*)&state[0]);
+    __m128i state1 = _mm_loadu_si128((const __m128i*)&state[4]);
+    tmp = _mm_shuffle_epi32(tmp, 0xB1);
+    state1 = _mm_shuffle_epi32(state1, 0x1B);
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+    while(blocks--)
+    {
+        __m128i abef = state0;
+        __m128i cdgh = state1;
+        __m128i m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 0)), byteswap);
+        __m128i m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 16)), byteswap);
+        __m128i m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 32)), byteswap);
+        __m128i m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 48)), byteswap);
+
+        SHA256_ROUNDS4(m0, 0);
+        SHA256_ROUNDS4(m1, 4);
+        SHA256_ROUNDS4(m2, 8);
+        SHA256_ROUNDS4(m3, 12);
+        for(int i = 16; i < 64; i += 16)
+        {
+            SHA256_SCHEDULE(m0, m1, m2, m3);
+            SHA256_ROUNDS4(m0, i);
+            SHA256_SCHEDULE(m1, m2, m3, m0);
+            SHA256_ROUNDS4(m1, i + 4);
+            SHA256_SCHEDULE(m2, m3, m0, m1);
+            SHA256_ROUNDS4(m2, i + 8);
+            SHA256_SCHEDULE(m3, m0, m1, m2);
+            SHA256_ROUNDS4(m3, i + 12);
+        }
+
+        state0 = _mm_add_epi32(state0, abef);
+        state1 = _mm_add_epi32(state1, cdgh);
+        data += 64;
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);
+    state1 = _mm_shuffle_epi32(state1, 0xB1);
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+    state1 = _mm_alignr_epi8(state1, tmp, 8);
+    _mm_storeu_si128((__m128i*)&state[0], state0);
+    _mm_storeu_si128((__m128i*)&state[4], state1);
+}
+
+static SHA256BLOCKS sha256_select_blocks()
+{
+    const cpu_features & features = cpu_get_features();
+    if(features.sha && features.sse41 && features.ssse3)
+        return sha256_blocks_shani;
+    return sha256_blocks_scalar;
+}
+
+Sha256::Sha256()
+{
+    Reset();
+}
+
+void Sha256::Reset()
+{
+    state[0] = 0x6A09E667;
+    state[1] = 0xBB67AE85;
+    state[2] = 0x3C6EF372;
+    state[3] = 0xA54FF53A;
+    state[4] = 0x510E527F;
+    state[5] = 0x9B05688C;
+    state[6] = 0x1F83D9AB;
+    state[7] = 0x5BE0CD19;
+    total = 0;
+    buffered = 0;
+}
+
+void Sha256::Update(const unsigned char* data, size_t len)
+{
+    SHA256BLOCKS blocks = sha256_select_blocks();
+    total += len;
+    if(buffered)
+    {
+        size_t fill = sizeof(buffer) - buffered;
+        if(len < fill)
+        {
+            memcpy(buffer + buffered, data, len);
+            buffered += len;
+            return;
+        }
+        memcpy(buffer + buffered, data, fill);
+        blocks(state, buffer, 1);
+        data += fill;
+        len -= fill;
+        buffered = 0;
+    }
+    size_t count = len / 64;
+    if(count)
+    {
+        blocks(state, data, count);
+        data += count * 64;
+        len -= count * 64;
+    }
+    memcpy(buffer, data, len);
+    buffered = len;
+}
+
+void Sha256::Final(unsigned char digest[SHA256_DIGEST_SIZE])
+{
+    ULONGLONG bits = total * 8;
+    unsigned char pad[72];
+    size_t padlen = (buffered < 56 ? 56 : 120) - buffered;
+    memset(pad, 0, sizeof(pad));
+    pad[0] = 0x80;
+    for(int i = 0; i < 8; i++)
+        pad[padlen + i] = (unsigned char)(bits >> (56 - i * 8));
+    Update(pad, padlen + 8);
+    for(int i = 0; i < 8; i++)
+    {
+        digest[i * 4] = (unsigned char)(state[i] >> 24);
+        digest[i * 4 + 1] = (unsigned char)(state[i] >> 16);
+        digest[i * 4 + 2] = (unsigned char)(state[i] >> 8);
+        digest[i * 4 + 3] = (unsigned char)state[i];
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef _SHA256_H
+#define _SHA256_H
+
+#include <windows.h>
+
+#define SHA256_DIGEST_SIZE 32
+
+//streaming SHA-256, uses the SHA extensions when available
+class Sha256
+{
+public:
+    Sha256();
+    void Reset();
+    void Update(const unsigned char* data, size_t len);
+    void Final(unsigned char digest[SHA256_DIGEST_SIZE]);
+
+private:
+    DWORD state[8];
+    ULONGLONG total;
+    unsigned char buffer[64];
+    size_t buffered;
+};
+
+#endif //_SHA256_H
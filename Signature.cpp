@@ -0,0 +1,279 @@
+#include "Signature.h"
+#include "CpuFeatures.h"
+#include <emmintrin.h>
+#include <immintrin.h>
+#include <string.h>
+#include <string>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif //_MSC_VER
+
+//next match position in [pos, count), count if there is none
+typedef size_t (*SIGKERNEL)(const Signature & sig, const unsigned char* data, size_t count, size_t pos, const size_t* anchor, const unsigned char* anchorByte);
+
+static unsigned int lowestbit(unsigned int value)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, value);
+    return index;
+#else
+    return __builtin_ctz(value);
+#endif //_MSC_VER
+}
+
+//the lowest ranked known bytes become the anchors
+unsigned int Signature::Rank(unsigned char value)
+{
+    switch(value)
+    {
+    case 0x00:
+        return 16;
+    case 0xFF:
+    case 0xCC:
+        return 12;
+    case 0x48:
+    case 0x8B:
+    case 0x89:
+    case 0x90:
+    case 0x0F:
+        return 8;
+    case 0x01:
+    case 0x02:
+    case 0x04:
+    case 0x08:
+    case 0x10:
+    case 0x20:
+    case 0x24:
+    case 0x33:
+    case 0x40:
+    case 0x41:
+    case 0x44:
+    case 0x45:
+    case 0x49:
+    case 0x4C:
+    case 0x4D:
+    case 0x74:
+    case 0x75:
+    case 0x80:
+    case 0x83:
+    case 0x85:
+    case 0x8D:
+    case 0xC0:
+    case 0xC3:
+    case 0xE8:
+    case 0xE9:
+    case 0xEB:
+        return 4;
+    default:
+        //text is common in data
+        return value >= 'a' && value <= 'z' ? 2 : 1;
+    }
+}
+
+static int hexnibble(char ch)
+{
+    if(ch >= '0' && ch <= '9')
+        return ch - '0';
+    if(ch >= 'a' && ch <= 'f')
+        return ch - 'a' + 10;
+    if(ch >= 'A' && ch <= 'F')
+        return ch - 'A' + 10;
+    return -1;
+}
+
+Signature::Signature()
+    : anchored(false)
+{
+    anchor[0] = anchor[1] = 0;
+    anchorByte[0] = anchorByte[1] = 0;
+}
+
+bool Signature::Compile(const char* pattern)
+{
+    bytes.clear();
+    mask.clear();
+    anchored = false;
+
+    //a lone "?" between spaces is a whole byte
+    std::string nibbles;
+    for(const char* ptr = pattern; *ptr;)
+    {
+        if(*ptr == ' ' || *ptr == '\t')
+        {
+            ptr++;
+            continue;
+        }
+        const char* token = ptr;
+        while(*ptr && *ptr != ' ' && *ptr != '\t')
+            ptr++;
+        if(ptr - token == 1 && *token == '?')
+            nibbles += "??";
+        else
+            nibbles.append(token, ptr - token);
+    }
+    if(nibbles.empty() || nibbles.size() % 2)
+        return false;
+
+    for(size_t i = 0; i < nibbles.size(); i += 2)
+    {
+        unsigned char value = 0;
+        unsigned char bits = 0;
+        for(size_t j = 0; j < 2; j++)
+        {
+            value <<= 4;
+            bits <<= 4;
+            char ch = nibbles[i + j];
+            if(ch == '?')
+                continue;
+            int nibble = hexnibble(ch);
+            if(nibble < 0)
+            {
+                bytes.clear();
+                mask.clear();
+                return false;
+            }
+            value |= nibble;
+            bits |= 0xF;
+        }
+        bytes.push_back(value);
+        mask.push_back(bits);
+    }
+
+    //the two rarest known bytes at different offsets
+    size_t best[2] = { 0, 0 };
+    unsigned int bestRank[2] = { ~0u, ~0u };
+    for(size_t i = 0; i < bytes.size(); i++)
+    {
+        if(mask[i] != 0xFF)
+            continue;
+        unsigned int rank = Rank(bytes[i]);
+        if(rank < bestRank[0])
+        {
+            best[1] = best[0];
+            bestRank[1] = bestRank[0];
+            best[0] = i;
+            bestRank[0] = rank;
+        }
+        else if(rank < bestRank[1])
+        {
+            best[1] = i;
+            bestRank[1] = rank;
+        }
+    }
+    if(bestRank[0] != ~0u)
+    {
+        anchored = true;
+        anchor[0] = best[0];
+        anchor[1] = bestRank[1] != ~0u ? best[1] : best[0];
+        anchorByte[0] = bytes[anchor[0]];
+        anchorByte[1] = bytes[anchor[1]];
+    }
+    return true;
+}
+
+bool Signature::Match(const unsigned char* data) const
+{
+    for(size_t i = 0; i < bytes.size(); i++)
+        if((data[i] & mask[i]) != bytes[i])
+            return false;
+    return true;
+}
+
+static size_t sigscan_sw(const Signature & sig, const unsigned char* data, size_t count, size_t pos, const size_t* anchor, const unsigned char* anchorByte)
+{
+    while(pos < count)
+    {
+        const unsigned char* found = (const unsigned char*)memchr(data + pos + anchor[0], anchorByte[0], count - pos);
+        if(!found)
+            break;
+        pos = found - data - anchor[0];
+        if(data[pos + anchor[1]] == anchorByte[1] && sig.Match(data + pos))
+            return pos;
+        pos++;
+    }
+    return count;
+}
+
+TARGET_SSE2 static size_t sigscan_sse2(const Signature & sig, const unsigned char* data, size_t count, size_t pos, const size_t* anchor, const unsigned char* anchorByte)
+{
+    __m128i first = _mm_set1_epi8((char)anchorByte[0]);
+    __m128i second = _mm_set1_epi8((char)anchorByte[1]);
+    for(; pos + 16 <= count; pos += 16)
+    {
+        __m128i eq0 = _mm_cmpeq_epi8(first, _mm_loadu_si128((const __m128i*)(data + pos + anchor[0])));
+        __m128i eq1 = _mm_cmpeq_epi8(second, _mm_loadu_si128((const __m128i*)(data + pos + anchor[1])));
+        unsigned int candidates = (unsigned int)_mm_movemask_epi8(_mm_and_si128(eq0, eq1));
+        for(; candidates; candidates &= candidates - 1)
+        {
+            size_t candidate = pos + lowestbit(candidates);
+            if(sig.Match(data + candidate))
+                return candidate;
+        }
+    }
+    return sigscan_sw(sig, data, count, pos, anchor, anchorByte);
+}
+
+TARGET_AVX2 static size_t sigscan_avx2(const Signature & sig, const unsigned char* data, size_t count, size_t pos, const size_t* anchor, const unsigned char* anchorByte)
+{
+    __m256i first = _mm256_set1_epi8((char)anchorByte[0]);
+    __m256i second = _mm256_set1_epi8((char)anchorByte[1]);
+    for(; pos + 32 <= count; pos += 32)
+    {
+        __m256i eq0 = _mm256_cmpeq_epi8(first, _mm256_loadu_si256((const __m256i*)(data + pos + anchor[0])));
+        __m256i eq1 = _mm256_cmpeq_epi8(second, _mm256_loadu_si256((const __m256i*)(data + pos + anchor[1])));
+        unsigned int candidates = (unsigned int)_mm256_movemask_epi8(_mm256_and_si256(eq0, eq1));
+        for(; candidates; candidates &= candidates - 1)
+        {
+            size_t candidate = pos + lowestbit(candidates);
+            if(sig.Match(data + candidate))
+            {
+                _mm256_zeroupper();
+                return candidate;
+            }
+        }
+    }
+    _mm256_zeroupper();
+    return sigscan_sw(sig, data, count, pos, anchor, anchorByte);
+}
+
+static SIGKERNEL sigkernel()
+{
+    const cpu_features & features = cpu_get_features();
+    if(features.avx2)
+        return sigscan_avx2;
+    if(features.sse2)
+        return sigscan_sse2;
+    return sigscan_sw;
+}
+
+size_t Signature::Find(const unsigned char* data, size_t size, size_t pos) const
+{
+    if(bytes.empty() || size < bytes.size())
+        return size;
+    //positions a match can start at, every load of the kernels stays inside the data
+    size_t count = size - bytes.size() + 1;
+    if(pos >= count)
+        return size;
+    if(!anchored)
+    {
+        //only wildcards and half known bytes, nothing to search for first
+        for(; pos < count; pos++)
+            if(Match(data + pos))
+                return pos;
+        return size;
+    }
+    size_t found = sigkernel()(*this, data, count, pos, anchor, anchorByte);
+    return found < count ? found : size;
+}
+
+size_t Signature::FindAll(const unsigned char* data, size_t size, std::vector<size_t> & matches, size_t maxCount) const
+{
+    size_t added = 0;
+    for(size_t pos = Find(data, size); pos < size && added < maxCount; pos = Find(data, size, pos + 1))
+    {
+        matches.push_back(pos);
+        added++;
+    }
+    return added;
+}
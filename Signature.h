@@ -0,0 +1,36 @@
+#ifndef _SIGNATURE_H
+#define _SIGNATURE_H
+
+#include <windows.h>
+#include <vector>
+
+//IDA style byte signature like "48 8B ?? ?? 4? E8", compiled once and searched for with SIMD
+//the search looks for the two rarest known bytes first and only compares the whole pattern where both are found
+class Signature
+{
+public:
+    Signature();
+    //spaces are optional, "?" and "??" are whole byte wildcards, "4?" and "?8" half ones
+    bool Compile(const char* pattern);
+    size_t Size() const { return bytes.size(); }
+    bool Known(size_t offset) const { return mask[offset] == 0xFF; }
+    unsigned char Byte(size_t offset) const { return bytes[offset]; }
+    //true if the pattern matches at data, Size() bytes have to be readable
+    bool Match(const unsigned char* data) const;
+    //offset of the first match at or after pos, size if there is none
+    size_t Find(const unsigned char* data, size_t size, size_t pos = 0) const;
+    //appends the offsets of all matches (overlapping ones too), stops after maxCount, returns how many were added
+    size_t FindAll(const unsigned char* data, size_t size, std::vector<size_t> & matches, size_t maxCount = ~size_t(0)) const;
+
+    //rough frequency of a byte value in code and data, lower is rarer
+    static unsigned int Rank(unsigned char value);
+
+private:
+    std::vector<unsigned char> bytes; //wildcard bits are zero
+    std::vector<unsigned char> mask; //0xFF for known bytes, 0xF0/0x0F for half wildcards, 0x00 for wildcards
+    size_t anchor[2]; //offsets of the anchor bytes, the same one twice if only one byte is known
+    unsigned char anchorByte[2];
+    bool anchored; //false when no byte is fully known
+};
+
+#endif //_SIGNATURE_H
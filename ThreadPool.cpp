@@ -0,0 +1,69 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(size_t threads)
+    : pending(0),
+      stopping(false)
+{
+    if(!threads)
+        threads = std::thread::hardware_concurrency();
+    if(!threads)
+        threads = 1;
+    for(size_t i = 0; i < threads; i++)
+        this->threads.push_back(std::thread(&ThreadPool::Worker, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        stopping = true;
+    }
+    taskReady.notify_all();
+    for(size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+}
+
+void ThreadPool::Enqueue(const THREADTASK & task)
+{
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        tasks.push(task);
+        pending++;
+    }
+    taskReady.notify_one();
+}
+
+void ThreadPool::Wait()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    while(pending)
+        allDone.wait(guard);
+}
+
+size_t ThreadPool::Size() const
+{
+    return threads.size();
+}
+
+void ThreadPool::Worker()
+{
+    for(;;)
+    {
+        THREADTASK task;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            while(!stopping && tasks.empty())
+                taskReady.wait(guard);
+            if(tasks.empty())
+                return;
+            task = tasks.front();
+            tasks.pop();
+        }
+        task();
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            if(!--pending)
+                allDone.notify_all();
+        }
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef _THREADPOOL_H
+#define _THREADPOOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+typedef std::function<void()> THREADTASK;
+
+//fixed set of worker threads, meant to live for the duration of a single command
+class ThreadPool
+{
+public:
+    explicit ThreadPool(size_t threads = 0); //0 uses one thread per logical processor
+    ~ThreadPool();
+    void Enqueue(const THREADTASK & task);
+    void Wait(); //blocks until every enqueued task has finished
+    size_t Size() const;
+
+private:
+    ThreadPool(const ThreadPool &);
+    ThreadPool & operator=(const ThreadPool &);
+    void Worker();
+
+    std::vector<std::thread> threads;
+    std::queue<THREADTASK> tasks;
+    std::mutex lock;
+    std::condition_variable taskReady;
+    std::condition_variable allDone;
+    size_t pending;
+    bool stopping;
+};
+
+#endif //_THREADPOOL_H
@@ -0,0 +1,139 @@
+#include "XxHash64.h"
+
+#define PRIME64_1 0x9E3779B185EBCA87ULL
+#define PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3 0x165667B19E3779F9ULL
+#define PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define PRIME64_5 0x27D4EB2F165667C5ULL
+
+static inline ULONGLONG rotl64(ULONGLONG x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline ULONGLONG read64(const unsigned char* p)
+{
+    ULONGLONG x;
+    memcpy(&x, p, sizeof(x));
+    return x;
+}
+
+static inline DWORD read32(const unsigned char* p)
+{
+    DWORD x;
+    memcpy(&x, p, sizeof(x));
+    return x;
+}
+
+static inline ULONGLONG round64(ULONGLONG acc, ULONGLONG input)
+{
+    acc += input * PRIME64_2;
+    acc = rotl64(acc, 31);
+    return acc * PRIME64_1;
+}
+
+static inline ULONGLONG merge64(ULONGLONG acc, ULONGLONG val)
+{
+    acc ^= round64(0, val);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+XxHash64::XxHash64()
+{
+    Reset();
+}
+
+void XxHash64::Reset()
+{
+    v[0] = PRIME64_1 + PRIME64_2;
+    v[1] = PRIME64_2;
+    v[2] = 0;
+    v[3] = 0 - PRIME64_1;
+    total = 0;
+    buffered = 0;
+}
+
+void XxHash64::Update(const unsigned char* data, size_t len)
+{
+    total += len;
+    if(buffered + len < sizeof(buffer))
+    {
+        memcpy(buffer + buffered, data, len);
+        buffered += len;
+        return;
+    }
+    if(buffered)
+    {
+        size_t fill = sizeof(buffer) - buffered;
+        memcpy(buffer + buffered, data, fill);
+        v[0] = round64(v[0], read64(buffer));
+        v[1] = round64(v[1], read64(buffer + 8));
+        v[2] = round64(v[2], read64(buffer + 16));
+        v[3] = round64(v[3], read64(buffer + 24));
+        data += fill;
+        len -= fill;
+        buffered = 0;
+    }
+    //keep the four lanes in registers for the bulk of the data
+    ULONGLONG v1 = v[0], v2 = v[1], v3 = v[2], v4 = v[3];
+    while(len >= 32)
+    {
+        v1 = round64(v1, read64(data));
+        v2 = round64(v2, read64(data + 8));
+        v3 = round64(v3, read64(data + 16));
+        v4 = round64(v4, read64(data + 24));
+        data += 32;
+        len -= 32;
+    }
+    v[0] = v1;
+    v[1] = v2;
+    v[2] = v3;
+    v[3] = v4;
+    memcpy(buffer, data, len);
+    buffered = len;
+}
+
+ULONGLONG XxHash64::Digest() const
+{
+    ULONGLONG h;
+    if(total >= 32)
+    {
+        h = rotl64(v[0], 1) + rotl64(v[1], 7) + rotl64(v[2], 12) + rotl64(v[3], 18);
+        h = merge64(h, v[0]);
+        h = merge64(h, v[1]);
+        h = merge64(h, v[2]);
+        h = merge64(h, v[3]);
+    }
+    else
+        h = v[2] + PRIME64_5;
+    h += total;
+
+    const unsigned char* p = buffer;
+    size_t len = buffered;
+    while(len >= 8)
+    {
+        h ^= round64(0, read64(p));
+        h = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+        p += 8;
+        len -= 8;
+    }
+    if(len >= 4)
+    {
+        h ^= (ULONGLONG)read32(p) * PRIME64_1;
+        h = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+        len -= 4;
+    }
+    while(len--)
+    {
+        h ^= (*p++) * PRIME64_5;
+        h = rotl64(h, 11) * PRIME64_1;
+    }
+
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
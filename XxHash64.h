@@ -0,0 +1,22 @@
+#ifndef _XXHASH64_H
+#define _XXHASH64_H
+
+#include <windows.h>
+
+//streaming XXH64 with seed 0
+class XxHash64
+{
+public:
+    XxHash64();
+    void Reset();
+    void Update(const unsigned char* data, size_t len);
+    ULONGLONG Digest() const;
+
+private:
+    ULONGLONG v[4];
+    ULONGLONG total;
+    unsigned char buffer[32];
+    size_t buffered;
+};
+
+#endif //_XXHASH64_H
@@ -0,0 +1,163 @@
+#include "YaraRules.h"
+#include "XxHash64.h"
+#include "pluginsdk\yara\yara.h"
+#include "pluginsdk\yara\yara\rules.h"
+#include <stdio.h>
+
+#define YARA_HASH_CHUNK 0x10000
+
+YaraRules::YaraRules()
+    : rules(0),
+      initialized(false),
+      cached(false)
+{
+}
+
+YaraRules::~YaraRules()
+{
+    if(rules)
+        yr_rules_destroy(rules);
+    if(initialized)
+        yr_finalize();
+}
+
+void YaraRules::SetDirectory(const char* directory)
+{
+    this->directory = directory;
+}
+
+static void compilermessage(int error_level, const char* file_name, int line_number, const char* message, void* user_data)
+{
+    if(error_level != YARA_ERROR_LEVEL_ERROR)
+        return;
+    std::string & error = *(std::string*)user_data;
+    char line[1024];
+    snprintf(line, sizeof(line), "%s(%d): %s\n", file_name ? file_name : "", line_number, message);
+    error += line;
+}
+
+bool YaraRules::Load(const char* szFileName, std::string & error)
+{
+    error.clear();
+    cached = false;
+    if(rules)
+    {
+        yr_rules_destroy(rules);
+        rules = 0;
+    }
+    //yr_initialize is reference counted, the debugger initializes libyara for itself too
+    if(!initialized)
+    {
+        if(yr_initialize() != ERROR_SUCCESS)
+        {
+            error = "yr_initialize failed";
+            return false;
+        }
+        initialized = true;
+    }
+
+    FILE* file = fopen(szFileName, "rb");
+    if(!file)
+    {
+        error = "failed to open the file";
+        return false;
+    }
+    //the key only covers this file, an edited include is not noticed
+    std::string compiledName;
+    if(!directory.empty())
+    {
+        std::vector<unsigned char> chunk(YARA_HASH_CHUNK);
+        XxHash64 xxh;
+        size_t read;
+        while((read = fread(chunk.data(), 1, chunk.size(), file)) > 0)
+            xxh.Update(chunk.data(), read);
+        rewind(file);
+        char name[32];
+        sprintf(name, "\\%016llX.yarc", xxh.Digest());
+        compiledName = directory + name;
+        //rules saved by another libyara version fail to load and are compiled again
+        if(yr_rules_load(compiledName.c_str(), &rules) == ERROR_SUCCESS)
+        {
+            fclose(file);
+            cached = true;
+            return true;
+        }
+        rules = 0;
+    }
+
+    YR_COMPILER* compiler;
+    if(yr_compiler_create(&compiler) != ERROR_SUCCESS)
+    {
+        fclose(file);
+        error = "yr_compiler_create failed";
+        return false;
+    }
+    yr_compiler_set_callback(compiler, compilermessage, &error);
+    int errors = yr_compiler_add_file(compiler, file, 0, szFileName);
+    fclose(file);
+    if(!errors && yr_compiler_get_rules(compiler, &rules) != ERROR_SUCCESS)
+    {
+        rules = 0;
+        error = "yr_compiler_get_rules failed";
+    }
+    yr_compiler_destroy(compiler);
+    if(!rules)
+        return false;
+    if(!compiledName.empty())
+        yr_rules_save(rules, compiledName.c_str());
+    return true;
+}
+
+size_t YaraRules::RuleCount() const
+{
+    if(!rules)
+        return 0;
+    size_t count = 0;
+    YR_RULE* rule;
+    yr_rules_foreach(rules, rule)
+        count++;
+    return count;
+}
+
+static int scanmessage(int message, void* message_data, void* user_data)
+{
+    if(message != CALLBACK_MSG_RULE_MATCHING)
+        return CALLBACK_CONTINUE;
+    YR_RULE* rule = (YR_RULE*)message_data;
+    std::vector<yara_match> & matches = *(std::vector<yara_match>*)user_data;
+    bool found = false;
+    YR_STRING* string;
+    yr_rule_strings_foreach(rule, string)
+    {
+        YR_MATCH* match;
+        yr_string_matches_foreach(string, match)
+        {
+            yara_match entry;
+            entry.offset = (size_t)match->offset;
+            entry.rule = rule->identifier;
+            entry.string = string->identifier;
+            matches.push_back(entry);
+            found = true;
+        }
+    }
+    if(!found)
+    {
+        yara_match entry;
+        entry.offset = 0;
+        entry.rule = rule->identifier;
+        matches.push_back(entry);
+    }
+    return CALLBACK_CONTINUE;
+}
+
+int YaraRules::Scan(const unsigned char* data, size_t size, std::vector<yara_match> & matches) const
+{
+    if(!rules)
+        return ERROR_INVALID_ARGUMENT;
+    return yr_rules_scan_mem(rules, (uint8_t*)data, size, 0, scanmessage, &matches, 0);
+}
+
+void YaraRules::FinishThread()
+{
+    yr_finalize_thread();
+}
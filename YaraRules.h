@@ -0,0 +1,43 @@
+#ifndef _YARARULES_H
+#define _YARARULES_H
+
+#include <windows.h>
+#include <string>
+#include <vector>
+
+struct _YR_RULES;
+
+struct yara_match
+{
+    size_t offset; //0 for rules that match on their condition alone
+    std::string rule;
+    std::string string; //identifier like "$a", empty for condition only matches
+};
+
+//rules loaded through libyara, compiled rules are kept on disk by the hash of their source file
+class YaraRules
+{
+public:
+    YaraRules();
+    ~YaraRules();
+    void SetDirectory(const char* directory); //empty always compiles
+    //loads the compiled rules when the source did not change, compiles them otherwise, error holds the compiler messages
+    bool Load(const char* szFileName, std::string & error);
+    bool Cached() const { return cached; } //the last Load did not have to compile
+    size_t RuleCount() const;
+    //safe to call from several threads, libyara keeps the scan state per thread (MAX_THREADS at most)
+    int Scan(const unsigned char* data, size_t size, std::vector<yara_match> & matches) const;
+    //frees what libyara keeps for the calling thread, for workers that are done scanning
+    static void FinishThread();
+
+private:
+    YaraRules(const YaraRules &);
+    YaraRules & operator=(const YaraRules &);
+
+    _YR_RULES* rules;
+    std::string directory;
+    bool initialized;
+    bool cached;
+};
+
+#endif //_YARARULES_H
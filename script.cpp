@@ -1,4 +1,6 @@
 #include "script.h"
+#include "test.h"
+#include "Signature.h"
 #include "angelscript\angelscript.h"
 #include "angelscript\scriptstdstring.h"
 #include "pluginsdk\_scriptapi_debug.h"
@@ -32,6 +34,17 @@ static void PrintString_Generic(asIScriptGeneric* gen)
     PrintString(*(std::string*)gen->GetArgAddress(0));
 }
 
+// First match of an IDA style signature in [start, start + size), 0 if there is none
+static duint SigScan(duint start, duint size, const std::string & pattern)
+{
+    Signature sig;
+    if(!sig.Compile(pattern.c_str()))
+        return 0;
+    syncpatches();
+    std::vector<duint> matches;
+    return sigscanmemory(start, size, sig, matches, 1) ? matches[0] : 0;
+}
+
 #ifdef _DEBUG
 #define VERIFY(x) assert((x) >= 0)
 #else
@@ -153,6 +166,9 @@ static void ConfigureEngine(asIScriptEngine* engine)
     VERIFY(engine->RegisterGlobalFunction("duint ReadPtr(duint addr)", asFUNCTION(Script::Memory::ReadPtr), asCALL_CDECL));
     VERIFY(engine->RegisterGlobalFunction("bool WritePtr(duint addr, duint value)", asFUNCTION(Script::Memory::WritePtr), asCALL_CDECL));
 
+    VERIFY(engine->SetDefaultNamespace("Pattern"));
+    VERIFY(engine->RegisterGlobalFunction("duint SigScan(duint start, duint size, const string &in pattern)", asFUNCTION(SigScan), asCALL_CDECL));
+
     VERIFY(engine->SetDefaultNamespace("Register"));
     VERIFY(engine->RegisterGlobalFunction("duint GetDR0()", asFUNCTION(Script::Register::GetDR0), asCALL_CDECL));
     VERIFY(engine->RegisterGlobalFunction("bool SetDR0(duint value)", asFUNCTION(Script::Register::SetDR0), asCALL_CDECL));
@@ -1,4 +1,21 @@
 #include "FunctionGraph.h"
+#include "GraphExport.h"
+#include "GraphAnalysis.h"
+#include "GraphCache.h"
+#include "InstrCache.h"
+#include "MemorySnapshot.h"
+#include "Relocations.h"
+#include "Hash.h"
+#include "XxHash64.h"
+#include "ThreadPool.h"
+#include "DisasmStream.h"
+#include "BulkDisasm.h"
+#include "MemDiff.h"
+#include "Signature.h"
+#include "PatternSet.h"
+#include "YaraRules.h"
+#include "RegionScanner.h"
+#include "Entropy.h"
 #include "test.h"
 #include "pluginsdk\TitanEngine\TitanEngine.h"
 #include <windows.h>
@@ -7,21 +24,137 @@
 #include "icons.h"
 #include "script.h"
 #include "pluginsdk\_scriptapi_module.h"
+#include "pluginsdk\_scriptapi_comment.h"
+#include "pluginsdk\_scriptapi_function.h"
+#include "pluginsdk\yara\yara.h"
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <map>
+#include <unordered_set>
+#include <atomic>
 
-static void adler32selection(const SELECTIONDATA & sel)
+static MemorySnapshot memorySnapshot(DbgMemRead); //pages read while paused, dropped whenever the debuggee runs
+
+//reads a range through the memory snapshot, returns the number of unreadable pages (zero filled)
+//for small ranges read again and again while paused (graph decoding, relocation and jump tables)
+static duint readmemory(duint base, unsigned char* data, duint size)
+{
+    return memorySnapshot.Read(base, data, (size_t)size);
+}
+
+static duint readmemory(duint base, duint size, std::vector<unsigned char> & data)
+{
+    data.resize((size_t)size);
+    return readmemory(base, data.data(), size);
+}
+
+//same as readmemory without keeping the pages, for bulk reads and streams that go over the data once
+static duint streammemory(duint base, unsigned char* data, duint size)
+{
+    return memorySnapshot.ReadDirect(base, data, (size_t)size);
+}
+
+static duint streammemory(duint base, duint size, std::vector<unsigned char> & data)
+{
+    data.resize((size_t)size);
+    return streammemory(base, data.data(), size);
+}
+
+#define HASH_CHUNK_SIZE 0x100000
+
+static GraphCache graphCache;
+static std::map<duint, std::pair<std::string, ULONGLONG>> moduleHashes; //base -> (path, file hash)
+static std::mutex moduleHashLock;
+
+static void clearmodulehashes()
+{
+    std::unique_lock<std::mutex> guard(moduleHashLock);
+    moduleHashes.clear();
+}
+
+//xxHash64 of the module file on disk, stable across sessions and rebasing
+static bool modulehash(duint base, ULONGLONG & hash)
+{
+    char modpath[MAX_PATH] = "";
+    if(!DbgFunctions()->ModPathFromAddr(base, modpath, MAX_PATH))
+        return false;
+    {
+        std::unique_lock<std::mutex> guard(moduleHashLock);
+        auto found = moduleHashes.find(base);
+        if(found != moduleHashes.end() && found->second.first == modpath)
+        {
+            hash = found->second.second;
+            return true;
+        }
+    }
+    FILE* file = fopen(modpath, "rb");
+    if(!file)
+        return false;
+    std::vector<unsigned char> chunk(HASH_CHUNK_SIZE);
+    XxHash64 xxh;
+    size_t read;
+    while((read = fread(chunk.data(), 1, chunk.size(), file)) > 0)
+        xxh.Update(chunk.data(), read);
+    fclose(file);
+    hash = xxh.Digest();
+    std::unique_lock<std::mutex> guard(moduleHashLock);
+    moduleHashes[base] = std::make_pair(std::string(modpath), hash);
+    return true;
+}
+
+static InstrCache instrCache; //shared by every command, dropped whenever the debuggee runs
+static std::vector<std::pair<duint, unsigned char>> knownPatches; //patch list (address, new byte) the cache has seen
+static std::mutex knownPatchesLock; //commands, menu entries, scripts and the debug events all get here
+
+//memory written while paused shows up in the patch list, so cached memory and instructions are dropped wherever it changed
+//commands call this before reading anything
+void syncpatches()
+{
+    std::unique_lock<std::mutex> guard(knownPatchesLock);
+    std::vector<std::pair<duint, unsigned char>> patches;
+    size_t cbsize = 0;
+    if(DbgFunctions()->PatchEnum(0, &cbsize) && cbsize)
+    {
+        std::vector<DBGPATCHINFO> list(cbsize / sizeof(DBGPATCHINFO));
+        if(DbgFunctions()->PatchEnum(list.data(), &cbsize))
+            for(size_t i = 0; i < list.size(); i++)
+                patches.push_back(std::make_pair(list[i].addr, list[i].newbyte));
+    }
+    std::sort(patches.begin(), patches.end());
+    std::vector<std::pair<duint, unsigned char>> changed;
+    std::set_symmetric_difference(patches.begin(), patches.end(), knownPatches.begin(), knownPatches.end(), std::back_inserter(changed));
+    for(size_t i = 0; i < changed.size(); i++)
+    {
+        memorySnapshot.Invalidate(changed[i].first, changed[i].first);
+        instrCache.Invalidate(changed[i].first, changed[i].first);
+    }
+    knownPatches.swap(patches);
+}
+
+static void hashselection(const SELECTIONDATA & sel)
 {
     duint len = sel.end - sel.start + 1;
-    unsigned char* data = new unsigned char[len];
-    DbgMemRead(sel.start, data, len);
-    DWORD a = 1, b = 0;
-    for(duint index = 0; index < len; ++index)
+    //stream the selection through a fixed buffer and every algorithm at once
+    std::vector<unsigned char> chunk(len < HASH_CHUNK_SIZE ? (size_t)len : HASH_CHUNK_SIZE);
+    HashSet hashes;
+    for(duint offset = 0; offset < len;)
+    {
+        duint size = len - offset < chunk.size() ? len - offset : chunk.size();
+        if(streammemory(sel.start + offset, chunk.data(), size))
+        {
+            _plugin_logprintf("[TEST] failed to read memory at %p!\n", sel.start + offset);
+            return;
+        }
+        hashes.Update(chunk.data(), (size_t)size);
+        offset += size;
+    }
+    for(size_t i = 0; i < hashes.Count(); i++)
     {
-        a = (a + data[index]) % 65521;
-        b = (b + a) % 65521;
+        char digest[HASH_MAX_STRING_SIZE] = "";
+        hashes.Final(i, digest);
+        _plugin_logprintf("[TEST] %s of %p[%X] is: %s\n", hashes.Name(i), sel.start, len, digest);
     }
-    delete[] data;
-    DWORD checksum = (b << 16) | a;
-    _plugin_logprintf("[TEST] Adler32 of %p[%X] is: %08X\n", sel.start, len, checksum);
 }
 
 extern "C" __declspec(dllexport) void CBINITDEBUG(CBTYPE cbType, PLUG_CB_INITDEBUG* info)
@@ -32,6 +165,23 @@ extern "C" __declspec(dllexport) void CBINITDEBUG(CBTYPE cbType, PLUG_CB_INITDEB
 extern "C" __declspec(dllexport) void CBSTOPDEBUG(CBTYPE cbType, PLUG_CB_STOPDEBUG* info)
 {
     _plugin_logputs("[TEST] debugging stopped!");
+    clearmodulehashes();
+    memorySnapshot.Clear();
+    instrCache.Clear();
+    std::unique_lock<std::mutex> guard(knownPatchesLock);
+    knownPatches.clear();
+}
+
+extern "C" __declspec(dllexport) void CBRESUMEDEBUG(CBTYPE cbType, PLUG_CB_RESUMEDEBUG* info)
+{
+    memorySnapshot.Clear();
+    instrCache.Clear();
+}
+
+extern "C" __declspec(dllexport) void CBSTEPPED(CBTYPE cbType, PLUG_CB_STEPPED* info)
+{
+    memorySnapshot.Clear();
+    instrCache.Clear();
 }
 
 extern "C" __declspec(dllexport) void CBMENUENTRY(CBTYPE cbType, PLUG_CB_MENUENTRY* info)
@@ -164,7 +314,7 @@ extern "C" __declspec(dllexport) void CBMENUENTRY(CBTYPE cbType, PLUG_CB_MENUENT
     }
     break;
 
-    case MENU_DISASM_ADLER32:
+    case MENU_DISASM_HASH:
     {
         if(!DbgIsDebugging())
         {
@@ -173,11 +323,11 @@ extern "C" __declspec(dllexport) void CBMENUENTRY(CBTYPE cbType, PLUG_CB_MENUENT
         }
         SELECTIONDATA sel;
         GuiSelectionGet(GUI_DISASSEMBLY, &sel);
-        adler32selection(sel);
+        hashselection(sel);
     }
     break;
 
-    case MENU_DUMP_ADLER32:
+    case MENU_DUMP_HASH:
     {
         if(!DbgIsDebugging())
         {
@@ -186,11 +336,11 @@ extern "C" __declspec(dllexport) void CBMENUENTRY(CBTYPE cbType, PLUG_CB_MENUENT
         }
         SELECTIONDATA sel;
         GuiSelectionGet(GUI_DUMP, &sel);
-        adler32selection(sel);
+        hashselection(sel);
     }
     break;
 
-    case MENU_STACK_ADLER32:
+    case MENU_STACK_HASH:
     {
         if(!DbgIsDebugging())
         {
@@ -199,7 +349,7 @@ extern "C" __declspec(dllexport) void CBMENUENTRY(CBTYPE cbType, PLUG_CB_MENUENT
         }
         SELECTIONDATA sel;
         GuiSelectionGet(GUI_STACK, &sel);
-        adler32selection(sel);
+        hashselection(sel);
     }
     break;
 
@@ -295,7 +445,43 @@ static bool cbDumpProcessCommand(int argc, char* argv[])
     return true;
 }
 
-//grs addr
+#define RELOC_READ_CHUNK 0x10000
+#define RELOC_MAX_READ 0x4000000 //outside of a module the table is assumed to be smaller than this
+
+//relocated fields and where they point to, one per line
+static bool dumprelocations(const RelocTable & table, duint base, duint imageSize, const char* szFileName)
+{
+    wchar_t szFile[MAX_PATH] = L"";
+    MultiByteToWideChar(CP_UTF8, 0, szFileName, -1, szFile, MAX_PATH);
+    FileSink file(szFile);
+    if(!file.IsOpen())
+        return false;
+    std::vector<unsigned char> image;
+    if(base)
+        streammemory(base, imageSize, image);
+    BufferedWriter out(file);
+    const std::vector<reloc_entry> & entries = table.Entries();
+    for(size_t i = 0; i < entries.size(); i++)
+    {
+        const reloc_entry & entry = entries[i];
+        out.Pointer(base + entry.rva);
+        out.Putc(' ');
+        out.Puts(RelocTable::TypeName(entry.type));
+        //absolute pointers in the image as it is loaded now
+        size_t field = entry.type == IMAGE_REL_BASED_DIR64 ? 8 : entry.type == IMAGE_REL_BASED_HIGHLOW ? 4 : 0;
+        if(field && entry.rva + field <= image.size())
+        {
+            ULONGLONG value = 0;
+            memcpy(&value, image.data() + entry.rva, field);
+            out.Puts(" -> ");
+            out.Pointer((duint)value);
+        }
+        out.Putc('\n');
+    }
+    return out.Flush();
+}
+
+//grs addr[,file]
 static bool cbGrs(int argc, char* argv[])
 {
     //Original tool "GetRelocSize" by Killboy/SND
@@ -304,28 +490,41 @@ static bool cbGrs(int argc, char* argv[])
         _plugin_logputs("[TEST] not enough arguments!");
         return false;
     }
+    syncpatches();
     duint RelocDirAddr = DbgValFromString(argv[1]);
-    duint RelocSize = 0;
-    IMAGE_RELOCATION RelocDir;
-    do
+    duint base = DbgFunctions()->ModBaseFromAddr(RelocDirAddr);
+    duint imageSize = base ? DbgFunctions()->ModSizeFromAddr(base) : 0;
+    duint limit = base ? base + imageSize - RelocDirAddr : RELOC_MAX_READ;
+
+    //read in growing chunks until the table ends, never past the module it is in
+    std::vector<unsigned char> data;
+    RelocTable table;
+    reloc_status status = RELOC_TRUNCATED;
+    for(duint chunk = RELOC_READ_CHUNK; status == RELOC_TRUNCATED; chunk *= 4)
     {
-        if(!DbgMemRead(RelocDirAddr, (unsigned char*)&RelocDir, sizeof(IMAGE_RELOCATION)))
-        {
-            _plugin_logputs("[TEST] invalid relocation table!");
-            return false;
-        }
-        if(!RelocDir.SymbolTableIndex)
+        duint size = chunk < limit ? chunk : limit;
+        readmemory(RelocDirAddr, size, data);
+        status = table.Parse(data.data(), data.size(), (DWORD)imageSize);
+        if(size == limit)
             break;
-        RelocSize += RelocDir.SymbolTableIndex;
-        RelocDirAddr += RelocDir.SymbolTableIndex;
     }
-    while(RelocDir.VirtualAddress);
-
-    if(!RelocSize)
+    if(status != RELOC_OK || !table.Size())
     {
-        _plugin_logputs("[TEST] invalid relocation table!");
+        if(table.ProblemCount())
+            _plugin_logprintf("[TEST] %s\n", table.FirstProblem().c_str());
+        _plugin_logputs(status == RELOC_TRUNCATED ? "[TEST] invalid relocation table (no end found)!" : "[TEST] invalid relocation table!");
         return false;
     }
+    duint RelocSize = table.Size();
+
+    size_t highlow = table.TypeCount(IMAGE_REL_BASED_HIGHLOW);
+    size_t dir64 = table.TypeCount(IMAGE_REL_BASED_DIR64);
+    size_t other = table.Entries().size() - highlow - dir64;
+    _plugin_logprintf("[TEST] %d blocks, %d relocations (%d HIGHLOW, %d DIR64, %d other, %d padding)\n", (int)table.BlockCount(), (int)table.Entries().size(), (int)highlow, (int)dir64, (int)other, (int)table.TypeCount(IMAGE_REL_BASED_ABSOLUTE));
+    if(table.ProblemCount())
+        _plugin_logprintf("[TEST] %d problem(s), first: %s\n", (int)table.ProblemCount(), table.FirstProblem().c_str());
+    if(argc > 2 && *argv[2] && !dumprelocations(table, base, imageSize, argv[2]))
+        _plugin_logprintf("[TEST] failed to write \"%s\"!\n", argv[2]);
 
     DbgValToString("$result", RelocSize);
     DbgCmdExec("$result");
@@ -333,26 +532,290 @@ static bool cbGrs(int argc, char* argv[])
     return true;
 }
 
-static ULONG_PTR GetInstrInfo(ULONG_PTR addr, instr_info* info)
+#define MAX_INSTRUCTION_SIZE 16
+
+//all comments in [start, end], sorted by address
+static void getcomments(duint start, duint end, std::vector<std::pair<duint, std::string>> & comments)
+{
+    using namespace Script;
+    BridgeList<Comment::CommentInfo> commentList;
+    if(!Comment::GetList(&commentList))
+        return;
+    char lastmod[MAX_MODULE_SIZE] = "";
+    duint lastbase = 0;
+    for(int i = 0; i < commentList.Count(); i++)
+    {
+        const Comment::CommentInfo & info = commentList[i];
+        //comments are grouped by module, so the base lookup rarely happens
+        if(strcmp(lastmod, info.mod))
+        {
+            strcpy(lastmod, info.mod);
+            lastbase = *info.mod ? DbgModBaseFromName(info.mod) : 0;
+        }
+        if(*info.mod && !lastbase)
+            continue;
+        duint addr = lastbase + info.rva;
+        if(addr >= start && addr <= end)
+            comments.push_back(std::make_pair(addr, std::string(info.text)));
+    }
+    std::sort(comments.begin(), comments.end());
+}
+
+//comment at addr, the cursor only moves forward so addresses must be increasing
+static const char* nextcomment(const std::vector<std::pair<duint, std::string>> & comments, size_t & cursor, duint addr)
+{
+    while(cursor < comments.size() && comments[cursor].first < addr)
+        cursor++;
+    if(cursor < comments.size() && comments[cursor].first == addr)
+        return comments[cursor].second.c_str();
+    return "";
+}
+
+//debuggee memory decoded with DisasmFast, for a DisasmStream
+class DisasmFastSource : public StreamSource
+{
+public:
+    void Read(ULONG_PTR addr, unsigned char* data, size_t size)
+    {
+        streammemory(addr, data, size);
+    }
+
+    unsigned int Decode(const unsigned char* data, ULONG_PTR addr)
+    {
+        memset(&info, 0, sizeof(info));
+        DbgFunctions()->DisasmFast(data, addr, &info);
+        return info.size > 0 ? info.size : 0;
+    }
+
+    BASIC_INSTRUCTION_INFO info; //last decoded instruction
+};
+
+//one comment query for the whole range, the memory is streamed and decoded locally
+static bool GetInstrInfoBatch(ULONG_PTR start, ULONG_PTR end, InstrList* list)
+{
+    std::vector<std::pair<duint, std::string>> comments;
+    getcomments(start, end, comments);
+    list->Reserve((end - start) / 4 + 1, (end - start) * 8 + 1);
+    size_t cursor = 0;
+    DisasmFastSource source;
+    DisasmStream stream(source, start, end);
+    stream_instr instr;
+    while(stream.Next(instr))
+    {
+        const BASIC_INSTRUCTION_INFO & basicinfo = source.info;
+        const char* comment = nextcomment(comments, cursor, instr.addr);
+        list->Add(instr.addr, basicinfo.branch && !basicinfo.call ? basicinfo.addr : 0, basicinfo.instruction, comment);
+    }
+    return true;
+}
+
+//decodes a snapshot of [start, end] with DisasmFast, jump tables outside of it are read from the debuggee
+class SnapshotDecoder : public InstrDecoder
+{
+public:
+    SnapshotDecoder(duint start, duint end)
+        : start(start),
+          debuggee(true)
+    {
+        readmemory(start, end - start + MAX_INSTRUCTION_SIZE, data); //the last instruction may run past end
+        bytes = data.data();
+        size = data.size();
+    }
+
+    //shares an existing snapshot (padded by MAX_INSTRUCTION_SIZE) and never reads the debuggee, safe to use from any thread
+    //the shared instruction cache is not used either, its lock would serialize the workers decoding a private image
+    SnapshotDecoder(duint start, const std::vector<unsigned char> & snapshot)
+        : start(start),
+          bytes(snapshot.data()),
+          size(snapshot.size()),
+          debuggee(false)
+    {
+    }
+
+    //xxHash64 of the snapshot, the bytes every instruction of the range is decoded from
+    ULONGLONG Hash() const
+    {
+        XxHash64 xxh;
+        xxh.Update(bytes, size);
+        return xxh.Digest();
+    }
+
+    //xxHash64 of the snapshot as it was before the patches
+    ULONGLONG Hash(const std::vector<DBGPATCHINFO> & patches) const
+    {
+        std::vector<unsigned char> original(bytes, bytes + size);
+        for(size_t i = 0; i < patches.size(); i++)
+            if(patches[i].addr >= start && patches[i].addr - start < size)
+                original[patches[i].addr - start] = patches[i].oldbyte;
+        XxHash64 xxh;
+        xxh.Update(original.data(), original.size());
+        return xxh.Digest();
+    }
+
+    bool Disasm(ULONG_PTR addr, BASIC_INSTRUCTION_INFO & basicinfo)
+    {
+        memset(&basicinfo, 0, sizeof(basicinfo));
+        if(addr < start || addr - start + MAX_INSTRUCTION_SIZE > size)
+            return false;
+        DbgFunctions()->DisasmFast(bytes + (addr - start), addr, &basicinfo);
+        return basicinfo.size > 0;
+    }
+
+    //served from the instruction cache when possible, so a paused process is decoded only once
+    bool Decode(ULONG_PTR addr, cfg_instr & instr)
+    {
+        if(debuggee && instrCache.Lookup(addr, instr))
+            return instr.size != 0;
+        BASIC_INSTRUCTION_INFO basicinfo;
+        if(!Disasm(addr, basicinfo))
+        {
+            //bytes past the snapshot are unknown, not invalid
+            if(debuggee && addr >= start && addr - start + MAX_INSTRUCTION_SIZE <= size)
+                instrCache.Store(addr, 0);
+            return false;
+        }
+        const char* text = basicinfo.instruction;
+        instr.size = basicinfo.size;
+        if(!_strnicmp(text, "ret", 3) || !_strnicmp(text, "iret", 4) || !_strnicmp(text, "int3", 4) || !_strnicmp(text, "hlt", 3) || !_strnicmp(text, "ud2", 3))
+            instr.flow = FLOW_RETURN;
+        else if(basicinfo.call)
+        {
+            instr.flow = FLOW_CALL;
+            instr.target = basicinfo.addr;
+        }
+        else if(!basicinfo.branch)
+            instr.flow = FLOW_NORMAL;
+        else if(_strnicmp(text, "jmp", 3))
+        {
+            instr.flow = FLOW_CONDITIONAL;
+            instr.target = basicinfo.addr;
+        }
+        else if(basicinfo.addr)
+        {
+            instr.flow = FLOW_JUMP;
+            instr.target = basicinfo.addr;
+        }
+        else
+        {
+            instr.flow = FLOW_INDIRECT;
+            instr.table = (basicinfo.type & TYPE_MEMORY) ? basicinfo.memory.value : 0;
+        }
+        if(debuggee)
+            instrCache.Store(addr, &instr);
+        return true;
+    }
+
+    bool ReadPointer(ULONG_PTR addr, ULONG_PTR & value)
+    {
+        if(addr >= start && addr - start + sizeof(value) <= size)
+        {
+            memcpy(&value, bytes + (addr - start), sizeof(value));
+            return true;
+        }
+        return debuggee && !readmemory(addr, (unsigned char*)&value, sizeof(value));
+    }
+
+private:
+    duint start;
+    const unsigned char* bytes;
+    size_t size;
+    bool debuggee;
+    std::vector<unsigned char> data;
+};
+
+//text and comments of every graph instruction, in the same order
+static void GraphText(const ControlFlowGraph & graph, SnapshotDecoder & decoder, duint start, duint end, InstrList & list)
+{
+    std::vector<std::pair<duint, std::string>> comments;
+    getcomments(start, end, comments);
+    list.Reserve(graph.InstrCount(), graph.InstrCount() * 32 + 1);
+    size_t cursor = 0;
+    for(size_t i = 0; i < graph.InstrCount(); i++)
+    {
+        ULONG_PTR addr = graph.Instr(i).addr;
+        BASIC_INSTRUCTION_INFO basicinfo;
+        decoder.Disasm(addr, basicinfo);
+        list.Add(addr, graph.Instr(i).target, basicinfo.instruction, nextcomment(comments, cursor, addr));
+    }
+}
+
+//patches that can affect instructions in [start, end], the bytes of a SnapshotDecoder
+static void rangepatches(duint start, duint end, std::vector<DBGPATCHINFO> & patches)
+{
+    size_t cbsize = 0;
+    if(!DbgFunctions()->PatchEnum(0, &cbsize) || !cbsize)
+        return;
+    std::vector<DBGPATCHINFO> list(cbsize / sizeof(DBGPATCHINFO));
+    if(!DbgFunctions()->PatchEnum(list.data(), &cbsize))
+        return;
+    for(size_t i = 0; i < list.size(); i++)
+        if(list[i].addr >= start && list[i].addr < end + MAX_INSTRUCTION_SIZE)
+            patches.push_back(list[i]);
+}
+
+//patched bytes merged into sorted inclusive ranges
+static void patchedranges(const std::vector<DBGPATCHINFO> & patches, std::vector<std::pair<ULONG_PTR, ULONG_PTR>> & ranges)
+{
+    std::vector<duint> addrs;
+    for(size_t i = 0; i < patches.size(); i++)
+        addrs.push_back(patches[i].addr);
+    std::sort(addrs.begin(), addrs.end());
+    for(size_t i = 0; i < addrs.size(); i++)
+    {
+        if(!ranges.empty() && addrs[i] <= ranges.back().second + 1)
+            ranges.back().second = addrs[i];
+        else
+            ranges.push_back(std::make_pair(addrs[i], addrs[i]));
+    }
+}
+
+//recursive descent from start, only code reachable from it ends up in the graph
+//module code is cached by module file hash and the hash of the live bytes of the range,
+//code the debuggee changed in memory (unpacked, hooked, self-modifying) is decoded again.
+//Patched code starts from the cached graph of the bytes before the patches and only decodes
+//the instructions the patches touched.
+static bool BuildGraph(duint start, duint end, ControlFlowGraph & graph)
+{
+    duint base = DbgFunctions()->ModBaseFromAddr(start);
+    ULONGLONG hash = 0;
+    bool hashed = base && modulehash(base, hash);
+    SnapshotDecoder decoder(start, end);
+    ULONGLONG code = hashed ? decoder.Hash() : 0;
+    if(hashed && graphCache.Get(hash, base, start, end, code, graph))
+        return true;
+    std::vector<DBGPATCHINFO> patches;
+    rangepatches(start, end, patches);
+    //the cached graph only matches the live bytes outside the patches when the original bytes hash the same
+    if(hashed && !patches.empty() && graphCache.Get(hash, base, start, end, decoder.Hash(patches), graph))
+    {
+        std::vector<std::pair<ULONG_PTR, ULONG_PTR>> ranges;
+        patchedranges(patches, ranges);
+        return graph.Rebuild(ranges, start, end, decoder);
+    }
+    if(!graph.Build(start, start, end, decoder))
+        return false;
+    if(hashed && patches.empty())
+        graphCache.Put(hash, base, start, end, code, graph);
+    return true;
+}
+
+//file next to the debugger executable
+static void DebuggerFile(const wchar_t* szName, wchar_t szFile[MAX_PATH])
 {
-    info->addr = addr;
-    char comment[MAX_COMMENT_SIZE] = "";
-    DbgGetCommentAt(addr, comment);
-    info->comment = comment;
-    BASIC_INSTRUCTION_INFO basicinfo;
-    DbgDisasmFastAt(addr, &basicinfo);
-    char disasm[GUI_MAX_DISASSEMBLY_SIZE] = "";
-    GuiGetDisassembly(addr, disasm);
-    info->instrText = disasm;
-    info->jmpaddr = basicinfo.branch && !basicinfo.call ? basicinfo.addr : 0;
-    if(basicinfo.size <= 0)
-        basicinfo.size = 1;
-    return addr + basicinfo.size;
+    GetModuleFileNameW(GetModuleHandleW(0), szFile, MAX_PATH);
+    int len = (int)wcslen(szFile);
+    while(szFile[len] != '\\' && len)
+        len--;
+    if(len)
+        szFile[len] = L'\0';
+    wcscat(szFile, L"\\");
+    wcscat(szFile, szName);
 }
 
-//graph start,end
+//graph start,end[,vcg|linear|text|dot|graphml|json]
 bool cbGraph(int argc, char* argv[])
 {
+    syncpatches();
     if(argc < 3)
     {
         _plugin_logputs("[TEST] not enough arguments!");
@@ -365,21 +828,238 @@ bool cbGraph(int argc, char* argv[])
         _plugin_logputs("[TEST] invalid arguments!");
         return false;
     }
-    wchar_t szGraphFile[MAX_PATH] = L"";
-    GetModuleFileNameW(GetModuleHandleW(0), szGraphFile, MAX_PATH);
-    int len = (int)wcslen(szGraphFile);
-    while(szGraphFile[len] != '\\' && len)
-        len--;
-    if(len)
-        szGraphFile[len] = L'\0';
-    wcscat(szGraphFile, L"\\function.vcg");
-    if(!make_flowchart(start, end, szGraphFile, GetInstrInfo))
+    const char* mode = argc > 3 ? argv[3] : "";
+    const graph_format* format = *mode ? graph_format_find(mode) : 0;
+    if(*mode && !format && _stricmp(mode, "vcg") && _stricmp(mode, "linear"))
+    {
+        _plugin_logprintf("[TEST] unknown graph mode \"%s\"!\n", mode);
+        return false;
+    }
+
+    //linear sweep of every byte in the range, written as VCG like before
+    if(!_stricmp(mode, "linear"))
+    {
+        wchar_t szGraphFile[MAX_PATH] = L"";
+        DebuggerFile(L"function.vcg", szGraphFile);
+        if(!make_flowchart(start, end, szGraphFile, GetInstrInfoBatch))
+        {
+            _plugin_logputs("[TEST] failed to generate graph!");
+            return false;
+        }
+        _plugin_logputs("[TEST] graph generated!");
+        ShellExecuteW(GuiGetWindowHandle(), L"open", szGraphFile, 0, 0, SW_SHOWNORMAL);
+        return true;
+    }
+
+    ControlFlowGraph graph;
+    if(!BuildGraph(start, end, graph))
+    {
+        _plugin_logputs("[TEST] failed to generate graph!");
+        return false;
+    }
+
+    if(!_stricmp(mode, "vcg"))
+    {
+        wchar_t szGraphFile[MAX_PATH] = L"";
+        DebuggerFile(L"function.vcg", szGraphFile);
+        SnapshotDecoder decoder(start, end);
+        InstrList list;
+        GraphText(graph, decoder, start, end, list);
+        if(!make_flowchart(graph, list, szGraphFile))
+        {
+            _plugin_logputs("[TEST] failed to write graph!");
+            return false;
+        }
+        _plugin_logputs("[TEST] graph exported!");
+        ShellExecuteW(GuiGetWindowHandle(), L"open", szGraphFile, 0, 0, SW_SHOWNORMAL);
+        return true;
+    }
+
+    if(format)
+    {
+        char name[32] = "";
+        sprintf(name, "function.%s", format->extension);
+        wchar_t szName[32] = L"";
+        MultiByteToWideChar(CP_UTF8, 0, name, -1, szName, 32);
+        wchar_t szGraphFile[MAX_PATH] = L"";
+        DebuggerFile(szName, szGraphFile);
+        SnapshotDecoder decoder(start, end);
+        InstrList list;
+        GraphText(graph, decoder, start, end, list);
+        const ControlFlowGraph* graphs[] = { &graph };
+        const InstrList* disasmlists[] = { &list };
+        FileSink file(szGraphFile);
+        if(!file.IsOpen() || !graph_export(format, file, graphs, 1, disasmlists))
+        {
+            _plugin_logputs("[TEST] failed to write graph!");
+            return false;
+        }
+        _plugin_logprintf("[TEST] graph exported as %s!\n", format->name);
+        return true;
+    }
+
+    //in-process, the GUI takes ownership of the list data and frees it
+    BridgeCFGraphList graphList = graph.ToGraphList();
+    GuiLoadGraph(&graphList);
+    GuiUpdateGraphView();
+    _plugin_logprintf("[TEST] graph of %p loaded (%d nodes)\n", start, (int)graph.NodeCount());
+    return true;
+}
+
+//disasmstat start,end
+static bool cbDisasmStat(int argc, char* argv[])
+{
+    syncpatches();
+    if(argc < 3)
+    {
+        _plugin_logputs("[TEST] not enough arguments!");
+        return false;
+    }
+    duint start = DbgValFromString(argv[1]);
+    duint end = DbgValFromString(argv[2]);
+    if(!start || !end || end < start)
+    {
+        _plugin_logputs("[TEST] invalid arguments!");
+        return false;
+    }
+    //streamed, so even whole sections only need one window of memory
+    DWORD ticks = GetTickCount();
+    DisasmFastSource source;
+    DisasmStream stream(source, start, end);
+    stream_instr instr;
+    ULONGLONG count = 0, invalid = 0, calls = 0, branches = 0;
+    while(stream.Next(instr))
+    {
+        count++;
+        if(!instr.valid)
+            invalid++;
+        else if(source.info.call)
+            calls++;
+        else if(source.info.branch)
+            branches++;
+    }
+    DWORD elapsed = GetTickCount() - ticks;
+    _plugin_logprintf("[TEST] %llu instructions (%llu calls, %llu branches, %llu invalid) in %ums, %llu instructions/s\n", count, calls, branches, invalid, elapsed, count * 1000 / (elapsed ? elapsed : 1));
+    return true;
+}
+
+//disasmdump start,end,file[,text|binary][,detail]
+static bool cbDisasmDump(int argc, char* argv[])
+{
+    syncpatches();
+    if(argc < 4)
+    {
+        _plugin_logputs("[TEST] not enough arguments!");
+        return false;
+    }
+    duint start = DbgValFromString(argv[1]);
+    duint end = DbgValFromString(argv[2]);
+    if(!start || !end || end < start)
+    {
+        _plugin_logputs("[TEST] invalid arguments!");
+        return false;
+    }
+    dump_options options;
+    options.format = DUMP_TEXT;
+    options.detail = false;
+    options.threads = 0;
+    for(int i = 4; i < argc; i++)
+    {
+        if(!_stricmp(argv[i], "binary"))
+            options.format = DUMP_BINARY;
+        else if(!_stricmp(argv[i], "detail"))
+            options.detail = true;
+        else if(_stricmp(argv[i], "text"))
+        {
+            _plugin_logprintf("[TEST] unknown option \"%s\"!\n", argv[i]);
+            return false;
+        }
+    }
+    wchar_t szFileName[MAX_PATH] = L"";
+    MultiByteToWideChar(CP_UTF8, 0, argv[3], -1, szFileName, MAX_PATH);
+    FileSink file(szFileName);
+    if(!file.IsOpen())
+    {
+        _plugin_logprintf("[TEST] failed to create \"%s\"!\n", argv[3]);
+        return false;
+    }
+    DWORD ticks = GetTickCount();
+
+    //one snapshot, padded so the last instruction can be decoded, the workers never touch the debuggee
+    std::vector<unsigned char> data;
+    duint unreadable = streammemory(start, end - start + MAX_INSTRUCTION_SIZE, data);
+    if(unreadable)
+        _plugin_logprintf("[TEST] %d unreadable pages, decoded as zeroes\n", (int)unreadable);
+    dump_stats stats;
+    if(!disasm_dump(data.data(), (size_t)(end - start + 1), start, options, file, stats))
+    {
+        _plugin_logputs("[TEST] failed to write disassembly!");
+        return false;
+    }
+    DWORD elapsed = GetTickCount() - ticks;
+    _plugin_logprintf("[TEST] %llu instructions (%llu invalid bytes) dumped in %ums, %llu instructions/s\n", stats.instructions, stats.invalid, elapsed, stats.instructions * 1000 / (elapsed ? elapsed : 1));
+    return true;
+}
+
+//memstat
+static bool cbMemStat(int argc, char* argv[])
+{
+    snapshot_stats stats = memorySnapshot.Stats();
+    _plugin_logprintf("[TEST] memory snapshot: %d pages, %llu hits, %llu misses, %llu reads\n", (int)stats.pages, stats.hits, stats.misses, stats.reads);
+    _plugin_logprintf("[TEST] instruction cache: %llu hits, %llu misses\n", instrCache.Hits(), instrCache.Misses());
+    return true;
+}
+
+//graphloops start,end
+static bool cbGraphLoops(int argc, char* argv[])
+{
+    syncpatches();
+    if(argc < 3)
+    {
+        _plugin_logputs("[TEST] not enough arguments!");
+        return false;
+    }
+    duint start = DbgValFromString(argv[1]);
+    duint end = DbgValFromString(argv[2]);
+    if(!start || !end || end < start)
+    {
+        _plugin_logputs("[TEST] invalid arguments!");
+        return false;
+    }
+    ControlFlowGraph graph;
+    if(!BuildGraph(start, end, graph))
     {
         _plugin_logputs("[TEST] failed to generate graph!");
         return false;
     }
-    _plugin_logputs("[TEST] graph generated!");
-    ShellExecuteW(GuiGetWindowHandle(), L"open", szGraphFile, 0, 0, SW_SHOWNORMAL);
+    GraphAnalysis analysis;
+    analysis.Analyze(graph);
+
+    //a loop covers the address range of its body, nested loops included
+    std::vector<std::pair<duint, duint>> ranges(analysis.LoopCount(), std::make_pair(~(duint)0, (duint)0));
+    for(size_t i = 0; i < graph.NodeCount(); i++)
+    {
+        const cfg_node & node = graph.Node(i);
+        for(size_t loop = analysis.LoopOf(i); loop != CFG_NONE; loop = analysis.Loop(loop).parent)
+        {
+            if(node.start < ranges[loop].first)
+                ranges[loop].first = node.start;
+            if(node.end > ranges[loop].second)
+                ranges[loop].second = node.end;
+        }
+    }
+    //outer loops come first, x64dbg derives the depth from the loops already added
+    int added = 0;
+    size_t maxdepth = 0;
+    for(size_t i = 0; i < ranges.size(); i++)
+    {
+        if(DbgLoopAdd(ranges[i].first, ranges[i].second))
+            added++;
+        if(analysis.Loop(i).depth + 1 > maxdepth)
+            maxdepth = analysis.Loop(i).depth + 1;
+    }
+    GuiUpdateAllViews();
+    _plugin_logprintf("[TEST] %d blocks, %d strongly connected components, %d loops (%d added, nesting depth %d)\n", (int)graph.NodeCount(), (int)analysis.SccCount(), (int)analysis.LoopCount(), added, (int)maxdepth);
     return true;
 }
 
@@ -407,14 +1087,1014 @@ bool cbModuleEnum(int argc, char* argv[])
     return true;
 }
 
-static duint exprZero(int argc, duint* argv, void* userdata)
+struct range_hash
 {
-	return 0;
+    std::string name;
+    duint addr;
+    duint size;
+    std::vector<std::string> digests;
+};
+
+static void hashrange(const unsigned char* data, size_t size, const std::string & algorithms, range_hash & result)
+{
+    HashSet hashes(algorithms.c_str());
+    hashes.Update(data, size);
+    result.digests.resize(hashes.Count());
+    for(size_t i = 0; i < hashes.Count(); i++)
+    {
+        char digest[HASH_MAX_STRING_SIZE] = "";
+        hashes.Final(i, digest);
+        result.digests[i] = digest;
+    }
+}
+
+static void modhash(const Script::Module::ModuleInfo & mod, const std::string & algorithms, ThreadPool & pool)
+{
+    using namespace Script;
+    std::vector<unsigned char> image;
+    duint unreadable = streammemory(mod.base, mod.size, image);
+    if(unreadable)
+        _plugin_logprintf("[TEST] %d unreadable pages in %s, hashed as zeroes\n", (int)unreadable, mod.name);
+
+    //the whole image is hashed next to the sections, so it does not serialize behind them
+    std::vector<range_hash> ranges(1);
+    ranges[0].name = mod.name;
+    ranges[0].addr = mod.base;
+    ranges[0].size = mod.size;
+    BridgeList<Module::ModuleSectionInfo> sectionList;
+    if(Module::SectionListFromAddr(mod.base, &sectionList))
+    {
+        for(int i = 0; i < sectionList.Count(); i++)
+        {
+            const Module::ModuleSectionInfo & section = sectionList[i];
+            if(section.addr < mod.base || section.addr - mod.base >= mod.size)
+                continue;
+            range_hash range;
+            range.name = section.name;
+            range.addr = section.addr;
+            range.size = section.size < mod.size - (section.addr - mod.base) ? section.size : mod.size - (section.addr - mod.base);
+            ranges.push_back(range);
+        }
+    }
+    else
+        _plugin_logputs("[TEST] Module::SectionListFromAddr() failed...");
+
+    for(size_t i = 0; i < ranges.size(); i++)
+    {
+        range_hash* range = &ranges[i];
+        const unsigned char* data = image.data() + (range->addr - mod.base);
+        pool.Enqueue([data, range, &algorithms]()
+        {
+            hashrange(data, (size_t)range->size, algorithms, *range);
+        });
+    }
+    pool.Wait();
+
+    HashSet names(algorithms.c_str());
+    for(size_t i = 0; i < ranges.size(); i++)
+    {
+        const range_hash & range = ranges[i];
+        for(size_t j = 0; j < names.Count(); j++)
+            _plugin_logprintf("%s%s %p[%p] %s: %s\n", i ? "  " : "", range.name.c_str(), range.addr, range.size, names.Name(j), range.digests[j].c_str());
+    }
+}
+
+//modhash module|all[,algorithm...]
+static bool cbModHash(int argc, char* argv[])
+{
+    using namespace Script;
+    syncpatches();
+    if(argc < 2)
+    {
+        _plugin_logputs("[TEST] not enough arguments!");
+        return false;
+    }
+    std::string algorithms;
+    for(int i = 2; i < argc; i++)
+    {
+        if(!hash_find(argv[i]))
+        {
+            _plugin_logprintf("[TEST] unknown hash algorithm \"%s\"!\n", argv[i]);
+            return false;
+        }
+        if(!algorithms.empty())
+            algorithms += ',';
+        algorithms += argv[i];
+    }
+    if(algorithms.empty())
+        algorithms = "sha256";
+
+    BridgeList<Module::ModuleInfo> modList;
+    if(!Module::GetList(&modList))
+    {
+        _plugin_logputs("[TEST] Module::GetList() failed...");
+        return false;
+    }
+    bool all = !_stricmp(argv[1], "all");
+    DWORD ticks = GetTickCount();
+    ThreadPool pool;
+    int hashed = 0;
+    for(int i = 0; i < modList.Count(); i++)
+    {
+        if(!all && _stricmp(modList[i].name, argv[1]))
+            continue;
+        modhash(modList[i], algorithms, pool);
+        hashed++;
+    }
+    if(!hashed)
+    {
+        _plugin_logprintf("[TEST] no module named \"%s\"!\n", argv[1]);
+        return false;
+    }
+    _plugin_logprintf("[TEST] hashed %d module(s) in %ums\n", hashed, GetTickCount() - ticks);
+    return true;
+}
+
+#define MODDIFF_MERGE_GAP 16 //differences closer than this are reported as one range
+#define MODDIFF_MAX_LOG 64
+
+struct diff_section
+{
+    char name[IMAGE_SIZEOF_SHORT_NAME + 1];
+    DWORD rva;
+    DWORD size;
+};
+
+struct mapped_image
+{
+    std::vector<unsigned char> data; //laid out by rva
+    std::vector<diff_section> sections; //the headers first
+    DWORD iatRva;
+    DWORD iatSize;
+    size_t relocations; //fields relocated for the live base
+};
+
+//the file of a module laid out like the loader does it, relocated for base
+static bool mapfile(const unsigned char* file, duint filesize, duint base, mapped_image & image)
+{
+    if(filesize < sizeof(IMAGE_DOS_HEADER))
+        return false;
+    const IMAGE_DOS_HEADER* dos = (const IMAGE_DOS_HEADER*)file;
+    if(dos->e_magic != IMAGE_DOS_SIGNATURE || dos->e_lfanew < 0 || (duint)dos->e_lfanew + sizeof(IMAGE_NT_HEADERS) > filesize)
+        return false;
+    const IMAGE_NT_HEADERS* nt = (const IMAGE_NT_HEADERS*)(file + dos->e_lfanew);
+    if(nt->Signature != IMAGE_NT_SIGNATURE || nt->OptionalHeader.Magic != IMAGE_NT_OPTIONAL_HDR_MAGIC)
+        return false;
+    DWORD imageSize = nt->OptionalHeader.SizeOfImage;
+    DWORD headerSize = nt->OptionalHeader.SizeOfHeaders < imageSize ? nt->OptionalHeader.SizeOfHeaders : imageSize;
+    if(headerSize > filesize)
+        headerSize = (DWORD)filesize;
+    image.data.assign(imageSize, 0);
+    image.sections.clear();
+    memcpy(image.data.data(), file, headerSize);
+    diff_section headers = { "headers", 0, headerSize };
+    image.sections.push_back(headers);
+
+    const IMAGE_SECTION_HEADER* section = IMAGE_FIRST_SECTION(nt);
+    for(WORD i = 0; i < nt->FileHeader.NumberOfSections; i++, section++)
+    {
+        if((const unsigned char*)(section + 1) > file + filesize)
+            break;
+        if(section->VirtualAddress >= imageSize)
+            continue;
+        DWORD room = imageSize - section->VirtualAddress;
+        DWORD size = section->Misc.VirtualSize ? section->Misc.VirtualSize : section->SizeOfRawData;
+        if(size > room)
+            size = room;
+        DWORD rawSize = section->SizeOfRawData < size ? section->SizeOfRawData : size;
+        if(section->PointerToRawData >= filesize)
+            rawSize = 0;
+        else if(rawSize > filesize - section->PointerToRawData)
+            rawSize = (DWORD)(filesize - section->PointerToRawData);
+        memcpy(image.data.data() + section->VirtualAddress, file + section->PointerToRawData, rawSize);
+        diff_section info;
+        memcpy(info.name, section->Name, IMAGE_SIZEOF_SHORT_NAME);
+        info.name[IMAGE_SIZEOF_SHORT_NAME] = '\0';
+        info.rva = section->VirtualAddress;
+        info.size = size;
+        image.sections.push_back(info);
+    }
+
+    const IMAGE_DATA_DIRECTORY & iat = nt->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IAT];
+    image.iatRva = iat.VirtualAddress;
+    image.iatSize = iat.Size;
+
+    //the table is parsed from the laid out image, like the loader reads it
+    image.relocations = 0;
+    const IMAGE_DATA_DIRECTORY & relocDir = nt->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_BASERELOC];
+    duint delta = base - (duint)nt->OptionalHeader.ImageBase;
+    if(delta && relocDir.VirtualAddress && relocDir.VirtualAddress < imageSize)
+    {
+        DWORD size = relocDir.Size < imageSize - relocDir.VirtualAddress ? relocDir.Size : imageSize - relocDir.VirtualAddress;
+        RelocTable table;
+        table.Parse(image.data.data() + relocDir.VirtualAddress, size, imageSize);
+        image.relocations = table.Apply(image.data.data(), imageSize, (ULONGLONG)delta);
+    }
+    //the loader stores the base it picked in the headers
+    if((duint)dos->e_lfanew + sizeof(IMAGE_NT_HEADERS) <= headerSize)
+        ((IMAGE_NT_HEADERS*)(image.data.data() + dos->e_lfanew))->OptionalHeader.ImageBase = base;
+    return true;
+}
+
+//moddiff module
+static bool cbModDiff(int argc, char* argv[])
+{
+    using namespace Script;
+    if(argc < 2)
+    {
+        _plugin_logputs("[TEST] not enough arguments!");
+        return false;
+    }
+    syncpatches();
+    Module::ModuleInfo mod;
+    if(!Module::InfoFromName(argv[1], &mod))
+    {
+        _plugin_logprintf("[TEST] module \"%s\" not found!\n", argv[1]);
+        return false;
+    }
+    DWORD ticks = GetTickCount();
+
+    wchar_t szPath[MAX_PATH] = L"";
+    MultiByteToWideChar(CP_UTF8, 0, mod.path, -1, szPath, MAX_PATH);
+    HANDLE FileHandle;
+    DWORD LoadedSize;
+    HANDLE FileMap;
+    ULONG_PTR FileMapVA;
+    if(!StaticFileLoadW(szPath, UE_ACCESS_READ, false, &FileHandle, &LoadedSize, &FileMap, &FileMapVA))
+    {
+        _plugin_logprintf("[TEST] failed to map \"%s\"!\n", mod.path);
+        return false;
+    }
+    mapped_image image;
+    bool mapped = mapfile((const unsigned char*)FileMapVA, LoadedSize, mod.base, image);
+    StaticFileUnloadW(szPath, false, FileHandle, LoadedSize, FileMap, FileMapVA);
+    if(!mapped)
+    {
+        _plugin_logprintf("[TEST] \"%s\" is not a valid PE file!\n", mod.path);
+        return false;
+    }
+
+    std::vector<unsigned char> live;
+    duint unreadable = streammemory(mod.base, mod.size, live);
+    size_t compareSize = image.data.size() < live.size() ? image.data.size() : live.size();
+    //the loader fills the import address table, it is expected to differ
+    if(image.iatSize && image.iatRva < compareSize)
+    {
+        size_t iatSize = image.iatSize < compareSize - image.iatRva ? image.iatSize : compareSize - image.iatRva;
+        memcpy(image.data.data() + image.iatRva, live.data() + image.iatRva, iatSize);
+    }
+
+    size_t rangeCount = 0;
+    size_t byteCount = 0;
+    size_t logged = 0;
+    for(size_t i = 0; i < image.sections.size(); i++)
+    {
+        const diff_section & section = image.sections[i];
+        if(section.rva >= compareSize)
+            continue;
+        size_t size = section.size < compareSize - section.rva ? section.size : compareSize - section.rva;
+        DIFFLIST ranges;
+        mem_diff(image.data.data() + section.rva, live.data() + section.rva, size, MODDIFF_MERGE_GAP, ranges);
+        if(ranges.empty())
+            continue;
+        size_t bytes = 0;
+        for(size_t j = 0; j < ranges.size(); j++)
+            bytes += ranges[j].second - ranges[j].first;
+        _plugin_logprintf("[TEST] %s: %d range(s), %d bytes differ\n", section.name, (int)ranges.size(), (int)bytes);
+        for(size_t j = 0; j < ranges.size() && logged < MODDIFF_MAX_LOG; j++, logged++)
+        {
+            duint start = mod.base + section.rva + ranges[j].first;
+            _plugin_logprintf("[TEST]   %p[%X] %s+%X\n", start, (unsigned int)(ranges[j].second - ranges[j].first), section.name, (unsigned int)ranges[j].first);
+        }
+        rangeCount += ranges.size();
+        byteCount += bytes;
+    }
+    if(rangeCount > logged)
+        _plugin_logprintf("[TEST] %d more range(s) not shown\n", (int)(rangeCount - logged));
+    _plugin_logprintf("[TEST] %s: %d range(s), %d bytes differ, %d relocations applied, %d unreadable pages, %ums\n", mod.name, (int)rangeCount, (int)byteCount, (int)image.relocations, (int)unreadable, GetTickCount() - ticks);
+
+    DbgValToString("$result", rangeCount);
+    DbgCmdExec("$result");
+
+    return true;
+}
+
+#define SCAN_CHUNK 0x100000 //region scans read this much at a time
+#define SIGSCAN_MAX_LOG 64
+
+//region scans go over every byte once, keeping the pages would only fill the snapshot
+static void scanread(ULONG_PTR addr, unsigned char* data, size_t size)
+{
+    streammemory(addr, data, size);
+}
+
+//committed regions of the debuggee that can be read, or just the given module ("all" or none for every region)
+//names (if set) gets the module or memory map info of each region
+static bool scanregions(const char* module, std::vector<memory_region> & regions, std::vector<std::string>* names = 0)
+{
+    if(module && *module && _stricmp(module, "all"))
+    {
+        Script::Module::ModuleInfo mod;
+        if(!Script::Module::InfoFromName(module, &mod))
+        {
+            _plugin_logprintf("[TEST] module \"%s\" not found!\n", module);
+            return false;
+        }
+        memory_region region = { mod.base, mod.size };
+        regions.push_back(region);
+        if(names)
+            names->push_back(mod.name);
+        return true;
+    }
+    MEMMAP memmap;
+    if(!DbgMemMap(&memmap))
+        return true;
+    for(int i = 0; i < memmap.count; i++)
+    {
+        const MEMORY_BASIC_INFORMATION & mbi = memmap.page[i].mbi;
+        if(mbi.State != MEM_COMMIT || !mbi.Protect || (mbi.Protect & (PAGE_NOACCESS | PAGE_GUARD)))
+            continue;
+        memory_region region = { (duint)mbi.BaseAddress, (duint)mbi.RegionSize };
+        regions.push_back(region);
+        if(names)
+            names->push_back(memmap.page[i].info);
+    }
+    if(memmap.page)
+        BridgeFree(memmap.page);
+    return true;
+}
+
+//keeps the limit lowest values seen in heap (a max heap), whatever order they arrive in
+template<typename T>
+static void keeplowest(std::vector<T> & heap, size_t limit, const T & value)
+{
+    if(heap.size() < limit)
+    {
+        heap.push_back(value);
+        std::push_heap(heap.begin(), heap.end());
+    }
+    else if(limit && value < heap.front())
+    {
+        std::pop_heap(heap.begin(), heap.end());
+        heap.back() = value;
+        std::push_heap(heap.begin(), heap.end());
+    }
+}
+
+size_t sigscanmemory(duint start, duint size, const Signature & sig, std::vector<duint> & matches, size_t maxCount)
+{
+    //chunks overlap by the pattern size so matches on a boundary are found once
+    size_t overlap = sig.Size() - 1;
+    size_t found = 0;
+    std::vector<unsigned char> data;
+    std::vector<size_t> offsets;
+    for(duint offset = 0; offset < size && found < maxCount; offset += SCAN_CHUNK)
+    {
+        duint chunk = size - offset < SCAN_CHUNK + overlap ? size - offset : SCAN_CHUNK + overlap;
+        streammemory(start + offset, chunk, data);
+        offsets.clear();
+        found += sig.FindAll(data.data(), data.size(), offsets, maxCount - found);
+        for(size_t i = 0; i < offsets.size(); i++)
+            matches.push_back(start + offset + offsets[i]);
+        //the last chunk can reach past the next chunk start
+        if(offset + chunk == size)
+            break;
+    }
+    return found;
+}
+
+//sigscan pattern[,module]
+static bool cbSigScan(int argc, char* argv[])
+{
+    if(argc < 2)
+    {
+        _plugin_logputs("[TEST] not enough arguments!");
+        return false;
+    }
+    Signature sig;
+    if(!sig.Compile(argv[1]))
+    {
+        _plugin_logprintf("[TEST] invalid pattern \"%s\"!\n", argv[1]);
+        return false;
+    }
+    syncpatches();
+    std::vector<memory_region> regions;
+    if(!scanregions(argc > 2 ? argv[2] : 0, regions))
+        return false;
+
+    //only the count and the lowest addresses are kept, a common pattern can match a large part of the process
+    DWORD ticks = GetTickCount();
+    RegionScanner scanner(scanread, SCAN_CHUNK, sig.Size() - 1);
+    std::mutex matchLock;
+    size_t count = 0;
+    std::vector<duint> lowest;
+    scan_stats stats = scanner.Run(regions, [&](const scan_chunk & chunk, size_t worker)
+    {
+        std::vector<size_t> found;
+        sig.FindAll(chunk.data, chunk.size, found);
+        std::lock_guard<std::mutex> guard(matchLock);
+        for(size_t i = 0; i < found.size() && found[i] < chunk.keep; i++)
+        {
+            count++;
+            keeplowest(lowest, SIGSCAN_MAX_LOG, chunk.base + found[i]);
+        }
+    });
+    std::sort_heap(lowest.begin(), lowest.end());
+    DWORD elapsed = GetTickCount() - ticks;
+    for(size_t i = 0; i < lowest.size(); i++)
+        _plugin_logprintf("[TEST] %p\n", lowest[i]);
+    if(count > lowest.size())
+        _plugin_logprintf("[TEST] %d more match(es) not shown\n", (int)(count - lowest.size()));
+    _plugin_logprintf("[TEST] %d match(es) in %d region(s), %lluKB scanned in %ums with %d thread(s)\n", (int)count, (int)regions.size(), stats.bytes / 1024, elapsed, (int)scanner.Workers());
+
+    DbgValToString("$result", count);
+    DbgCmdExec("$result");
+
+    return true;
+}
+
+#define MULTISCAN_MAX_LOG 64
+
+//signatures from a file, one per line as "pattern" or "name=pattern", # starts a comment
+static bool loadpatterns(const char* szFileName, PatternSet & set)
+{
+    FILE* file = fopen(szFileName, "rb");
+    if(!file)
+        return false;
+    char line[1024];
+    int number = 0;
+    while(fgets(line, sizeof(line), file))
+    {
+        number++;
+        line[strcspn(line, "\r\n")] = '\0';
+        char* text = line;
+        while(*text == ' ' || *text == '\t')
+            text++;
+        if(!*text || *text == '#')
+            continue;
+        const char* name = text;
+        char* pattern = text;
+        char* equals = strchr(text, '=');
+        if(equals)
+        {
+            *equals = '\0';
+            pattern = equals + 1;
+        }
+        if(set.Add(pattern, name) < 0)
+            _plugin_logprintf("[TEST] line %d: invalid pattern \"%s\"\n", number, pattern);
+    }
+    fclose(file);
+    return true;
+}
+
+//multiscan file[,module]
+static bool cbMultiScan(int argc, char* argv[])
+{
+    if(argc < 2)
+    {
+        _plugin_logputs("[TEST] not enough arguments!");
+        return false;
+    }
+    PatternSet set;
+    if(!loadpatterns(argv[1], set))
+    {
+        _plugin_logprintf("[TEST] failed to read \"%s\"!\n", argv[1]);
+        return false;
+    }
+    if(!set.Count())
+    {
+        _plugin_logprintf("[TEST] no valid patterns in \"%s\"!\n", argv[1]);
+        return false;
+    }
+    set.Build();
+    syncpatches();
+    std::vector<memory_region> regions;
+    if(!scanregions(argc > 2 ? argv[2] : 0, regions))
+        return false;
+
+    //every region is read once, whatever the number of patterns
+    //only the counts and the lowest matches are kept, common patterns can match a large part of the process
+    DWORD ticks = GetTickCount();
+    RegionScanner scanner(scanread, SCAN_CHUNK, set.MaxSize() - 1);
+    std::mutex matchLock;
+    size_t count = 0;
+    std::vector<size_t> counts(set.Count(), 0);
+    std::vector<std::pair<duint, unsigned int>> lowest;
+    scan_stats stats = scanner.Run(regions, [&](const scan_chunk & chunk, size_t worker)
+    {
+        std::vector<pattern_match> found;
+        set.Scan(chunk.data, chunk.size, found);
+        std::lock_guard<std::mutex> guard(matchLock);
+        for(size_t i = 0; i < found.size(); i++)
+        {
+            if(found[i].offset >= chunk.keep)
+                continue;
+            count++;
+            counts[found[i].pattern]++;
+            keeplowest(lowest, MULTISCAN_MAX_LOG, std::make_pair(chunk.base + found[i].offset, found[i].pattern));
+        }
+    });
+    DWORD elapsed = GetTickCount() - ticks;
+
+    std::sort_heap(lowest.begin(), lowest.end());
+    for(size_t i = 0; i < lowest.size(); i++)
+        _plugin_logprintf("[TEST] %p %s\n", lowest[i].first, set.Name(lowest[i].second).c_str());
+    if(count > lowest.size())
+        _plugin_logprintf("[TEST] %d more match(es) not shown\n", (int)(count - lowest.size()));
+    for(size_t i = 0; i < counts.size(); i++)
+        if(counts[i])
+            _plugin_logprintf("[TEST] %s: %d match(es)\n", set.Name((unsigned int)i).c_str(), (int)counts[i]);
+    _plugin_logprintf("[TEST] %d pattern(s), %d state(s), %d match(es) in %d region(s), %lluKB scanned in %ums with %d thread(s)\n", (int)set.Count(), (int)set.StateCount(), (int)count, (int)regions.size(), stats.bytes / 1024, elapsed, (int)scanner.Workers());
+
+    DbgValToString("$result", count);
+    DbgCmdExec("$result");
+
+    return true;
+}
+
+#define YARASCAN_MAX_LOG 64
+
+static std::string yaraCacheDir;
+
+//yarascan rulesfile[,module|all]
+static bool cbYaraScan(int argc, char* argv[])
+{
+    if(argc < 2)
+    {
+        _plugin_logputs("[TEST] not enough arguments!");
+        return false;
+    }
+    DWORD ticks = GetTickCount();
+    YaraRules rules;
+    rules.SetDirectory(yaraCacheDir.c_str());
+    std::string error;
+    if(!rules.Load(argv[1], error))
+    {
+        _plugin_logprintf("[TEST] failed to load \"%s\": %s\n", argv[1], error.c_str());
+        return false;
+    }
+    DWORD loaded = GetTickCount() - ticks;
+    syncpatches();
+    std::vector<memory_region> regions;
+    if(!scanregions(argc > 2 ? argv[2] : 0, regions))
+        return false;
+
+    //every region is one buffer, offset conditions (uint16(0), $a at 0, filesize) and rules with
+    //strings far apart only mean the same as on a file when yara sees the whole region at once
+    duint largest = 0;
+    for(size_t i = 0; i < regions.size(); i++)
+        if(regions[i].size > largest)
+            largest = regions[i].size;
+
+    //one scanner per worker, libyara has a limit on the threads scanning with the same rules
+    unsigned int threads = std::thread::hardware_concurrency();
+    RegionScanner scanner(scanread, (size_t)largest, 0, !threads ? 1 : threads > MAX_THREADS ? MAX_THREADS : threads);
+    std::atomic<int> failed(0);
+    std::mutex hitLock;
+    std::vector<std::pair<duint, std::string>> hits; //address, "rule $string"
+    scan_stats stats = scanner.Run(regions, [&](const scan_chunk & chunk, size_t worker)
+    {
+        std::vector<yara_match> found;
+        if(rules.Scan(chunk.data, chunk.size, found) != ERROR_SUCCESS)
+        {
+            failed++;
+            return;
+        }
+        std::lock_guard<std::mutex> guard(hitLock);
+        for(size_t i = 0; i < found.size(); i++)
+        {
+            //rules without string matches have no address, they are reported at the region base
+            if(found[i].string.empty())
+                hits.push_back(std::make_pair(chunk.base, found[i].rule));
+            else
+                hits.push_back(std::make_pair(chunk.base + found[i].offset, found[i].rule + " " + found[i].string));
+        }
+    }, [](size_t worker)
+    {
+        YaraRules::FinishThread();
+    });
+    DWORD elapsed = GetTickCount() - ticks - loaded;
+
+    //one comment per address, naming every rule that hit it
+    std::sort(hits.begin(), hits.end());
+    hits.erase(std::unique(hits.begin(), hits.end()), hits.end());
+    size_t annotated = 0;
+    for(size_t i = 0; i < hits.size();)
+    {
+        duint addr = hits[i].first;
+        std::string comment = "yara: " + hits[i].second;
+        if(i < YARASCAN_MAX_LOG)
+            _plugin_logprintf("[TEST] %p %s\n", addr, hits[i].second.c_str());
+        for(i++; i < hits.size() && hits[i].first == addr; i++)
+        {
+            comment += ", " + hits[i].second;
+            if(i < YARASCAN_MAX_LOG)
+                _plugin_logprintf("[TEST] %p %s\n", addr, hits[i].second.c_str());
+        }
+        DbgSetAutoCommentAt(addr, comment.c_str());
+        annotated++;
+    }
+    if(hits.size() > YARASCAN_MAX_LOG)
+        _plugin_logprintf("[TEST] %d more hit(s) not shown\n", (int)(hits.size() - YARASCAN_MAX_LOG));
+    if(failed)
+        _plugin_logprintf("[TEST] %d region(s) failed to scan\n", (int)failed);
+    _plugin_logprintf("[TEST] %d rule(s) %s in %ums, %d hit(s) at %d address(es) in %d region(s), %lluKB scanned in %ums with %d thread(s)\n", (int)rules.RuleCount(), rules.Cached() ? "loaded" : "compiled", loaded, (int)hits.size(), (int)annotated, (int)regions.size(), stats.bytes / 1024, elapsed, (int)scanner.Workers());
+    GuiUpdateAllViews();
+
+    DbgValToString("$result", hits.size());
+    DbgCmdExec("$result");
+
+    return true;
+}
+
+#define ENTROPYMAP_WINDOW 256
+#define ENTROPYMAP_HIGH 218 //6.8 bits, random or compressed windows of 256 bytes reach about 7.2, code stays under 6.5
+#define ENTROPYMAP_MIN_BLOCK 4 //high entropy windows in a row before they are reported as a block
+#define ENTROPYMAP_PACKED 50 //percentage of high entropy windows that makes a region look packed or encrypted
+#define ENTROPYMAP_MAX_LOG 64
+
+struct entropy_block
+{
+    duint addr;
+    duint size;
+    size_t region;
+    unsigned int mean; //in ENTROPY_SCALE units
+};
+
+//the headers and every section of a module, so each section gets its own verdict
+static bool sectionregions(const char* module, std::vector<memory_region> & regions, std::vector<std::string> & names)
+{
+    using namespace Script;
+    Module::ModuleInfo mod;
+    if(!Module::InfoFromName(module, &mod))
+    {
+        _plugin_logprintf("[TEST] module \"%s\" not found!\n", module);
+        return false;
+    }
+    BridgeList<Module::ModuleSectionInfo> sectionList;
+    if(!Module::SectionListFromAddr(mod.base, &sectionList) || !sectionList.Count())
+    {
+        memory_region region = { mod.base, mod.size };
+        regions.push_back(region);
+        names.push_back(mod.name);
+        return true;
+    }
+    duint headers = mod.size;
+    for(int i = 0; i < sectionList.Count(); i++)
+        if(sectionList[i].addr >= mod.base && sectionList[i].addr - mod.base < headers)
+            headers = sectionList[i].addr - mod.base;
+    if(headers)
+    {
+        memory_region region = { mod.base, headers };
+        regions.push_back(region);
+        names.push_back(std::string(mod.name) + " headers");
+    }
+    for(int i = 0; i < sectionList.Count(); i++)
+    {
+        const Module::ModuleSectionInfo & section = sectionList[i];
+        if(section.addr < mod.base || section.addr - mod.base >= mod.size || !section.size)
+            continue;
+        memory_region region = { section.addr, section.size < mod.size - (section.addr - mod.base) ? section.size : mod.size - (section.addr - mod.base) };
+        regions.push_back(region);
+        names.push_back(std::string(mod.name) + " " + section.name);
+    }
+    return true;
+}
+
+//one line per region: base, size, a hex digit pair per window, name
+static bool writeentropymap(const char* szFileName, const std::vector<memory_region> & regions, const std::vector<std::string> & names, const std::vector<std::vector<unsigned char>> & maps)
+{
+    wchar_t szWideName[MAX_PATH] = L"";
+    MultiByteToWideChar(CP_UTF8, 0, szFileName, -1, szWideName, MAX_PATH);
+    FileSink file(szWideName);
+    if(!file.IsOpen())
+        return false;
+    const char* digits = "0123456789ABCDEF";
+    BufferedWriter writer(file);
+    for(size_t i = 0; i < regions.size(); i++)
+    {
+        writer.Pointer(regions[i].base);
+        writer.Putc(' ');
+        writer.Pointer(regions[i].size);
+        writer.Putc(' ');
+        for(size_t j = 0; j < maps[i].size(); j++)
+        {
+            writer.Putc(digits[maps[i][j] >> 4]);
+            writer.Putc(digits[maps[i][j] & 0xF]);
+        }
+        writer.Putc(' ');
+        writer.Puts(names[i].c_str());
+        writer.Putc('\n');
+    }
+    return writer.Flush() && !writer.Failed();
+}
+
+//entropymap module|all[,file]
+static bool cbEntropyMap(int argc, char* argv[])
+{
+    if(argc < 2)
+    {
+        _plugin_logputs("[TEST] not enough arguments!");
+        return false;
+    }
+    syncpatches();
+    std::vector<memory_region> regions;
+    std::vector<std::string> names;
+    if(!_stricmp(argv[1], "all") ? !scanregions(0, regions, &names) : !sectionregions(argv[1], regions, names))
+        return false;
+
+    //chunks start at a multiple of the window in their region, so every worker fills its own part of the map
+    DWORD ticks = GetTickCount();
+    std::vector<std::vector<unsigned char>> maps(regions.size());
+    for(size_t i = 0; i < regions.size(); i++)
+        maps[i].resize((size_t)((regions[i].size + ENTROPYMAP_WINDOW - 1) / ENTROPYMAP_WINDOW));
+    RegionScanner scanner(scanread, SCAN_CHUNK);
+    scan_stats stats = scanner.Run(regions, [&](const scan_chunk & chunk, size_t worker)
+    {
+        size_t window = (size_t)((chunk.base - regions[chunk.region].base) / ENTROPYMAP_WINDOW);
+        entropy_map(chunk.data, chunk.size, ENTROPYMAP_WINDOW, maps[chunk.region].data() + window);
+    });
+    DWORD elapsed = GetTickCount() - ticks;
+
+    std::vector<entropy_block> blocks;
+    size_t windowCount = 0;
+    size_t packed = 0;
+    for(size_t i = 0; i < regions.size(); i++)
+    {
+        const std::vector<unsigned char> & map = maps[i];
+        size_t high = 0;
+        ULONGLONG total = 0;
+        unsigned int peak = 0;
+        for(size_t j = 0; j < map.size(); j++)
+        {
+            total += map[j];
+            if(map[j] > peak)
+                peak = map[j];
+        }
+        //runs of high entropy windows, short ones are counted but not reported
+        size_t firstBlock = blocks.size();
+        for(size_t j = 0; j < map.size(); j++)
+        {
+            if(map[j] < ENTROPYMAP_HIGH)
+                continue;
+            size_t start = j;
+            ULONGLONG sum = 0;
+            for(; j < map.size() && map[j] >= ENTROPYMAP_HIGH; j++)
+                sum += map[j];
+            high += j - start;
+            if(j - start < ENTROPYMAP_MIN_BLOCK)
+                continue;
+            duint end = (duint)j * ENTROPYMAP_WINDOW < regions[i].size ? (duint)j * ENTROPYMAP_WINDOW : regions[i].size;
+            entropy_block block = { regions[i].base + start * ENTROPYMAP_WINDOW, end - start * ENTROPYMAP_WINDOW, i, (unsigned int)(sum / (j - start)) };
+            blocks.push_back(block);
+        }
+        windowCount += map.size();
+        if(map.empty())
+            continue;
+        bool looksPacked = high * 100 >= map.size() * ENTROPYMAP_PACKED;
+        if(looksPacked)
+            packed++;
+        if(looksPacked || blocks.size() > firstBlock)
+            _plugin_logprintf("[TEST] %p[%p] %s: mean %.2f, max %.2f bits, %d%% high, %d block(s)%s\n", regions[i].base, regions[i].size, names[i].c_str(), (double)total / map.size() / ENTROPY_SCALE, (double)peak / ENTROPY_SCALE, (int)(high * 100 / map.size()), (int)(blocks.size() - firstBlock), looksPacked ? ", looks packed or encrypted" : "");
+    }
+    for(size_t i = 0; i < blocks.size() && i < ENTROPYMAP_MAX_LOG; i++)
+        _plugin_logprintf("[TEST]   %p[%X] %.2f bits %s\n", blocks[i].addr, (unsigned int)blocks[i].size, (double)blocks[i].mean / ENTROPY_SCALE, names[blocks[i].region].c_str());
+    if(blocks.size() > ENTROPYMAP_MAX_LOG)
+        _plugin_logprintf("[TEST] %d more block(s) not shown\n", (int)(blocks.size() - ENTROPYMAP_MAX_LOG));
+    if(argc > 2 && !writeentropymap(argv[2], regions, names, maps))
+        _plugin_logprintf("[TEST] failed to write \"%s\"!\n", argv[2]);
+    _plugin_logprintf("[TEST] %d window(s) of %d bytes, %d high entropy block(s), %d of %d region(s) look packed, %lluKB mapped in %ums with %d thread(s)\n", (int)windowCount, ENTROPYMAP_WINDOW, (int)blocks.size(), (int)packed, (int)regions.size(), stats.bytes / 1024, elapsed, (int)scanner.Workers());
+
+    DbgValToString("$result", blocks.size());
+    DbgCmdExec("$result");
+
+    return true;
+}
+
+struct code_range
+{
+    duint start;
+    duint end; //inclusive
+};
+
+//executable sections from the PE headers of a module snapshot
+static void coderanges(duint base, const std::vector<unsigned char> & image, duint imagesize, std::vector<code_range> & ranges)
+{
+    if(imagesize < sizeof(IMAGE_DOS_HEADER))
+        return;
+    const IMAGE_DOS_HEADER* dos = (const IMAGE_DOS_HEADER*)image.data();
+    if(dos->e_magic != IMAGE_DOS_SIGNATURE || dos->e_lfanew < 0 || (duint)dos->e_lfanew + sizeof(IMAGE_NT_HEADERS) > imagesize)
+        return;
+    const IMAGE_NT_HEADERS* nt = (const IMAGE_NT_HEADERS*)(image.data() + dos->e_lfanew);
+    if(nt->Signature != IMAGE_NT_SIGNATURE)
+        return;
+    const IMAGE_SECTION_HEADER* section = IMAGE_FIRST_SECTION(nt);
+    for(WORD i = 0; i < nt->FileHeader.NumberOfSections; i++, section++)
+    {
+        if((const unsigned char*)(section + 1) > image.data() + imagesize)
+            break;
+        if(!(section->Characteristics & IMAGE_SCN_MEM_EXECUTE) || !section->Misc.VirtualSize || section->VirtualAddress >= imagesize)
+            continue;
+        duint size = section->Misc.VirtualSize < imagesize - section->VirtualAddress ? section->Misc.VirtualSize : imagesize - section->VirtualAddress;
+        code_range range = { base + section->VirtualAddress, base + section->VirtualAddress + size - 1 };
+        ranges.push_back(range);
+    }
+}
+
+struct function_graph
+{
+    duint start;
+    duint end;
+    ControlFlowGraph graph;
+};
+
+//shared by the workers of a graphall run, call targets found while graphing are queued as new functions
+struct module_graphs
+{
+    duint base;
+    const std::vector<unsigned char>* image;
+    std::vector<code_range> code;
+    std::mutex lock;
+    std::unordered_set<duint> queued;
+    std::vector<function_graph> functions;
+    size_t failed;
+};
+
+static const code_range* findcode(const module_graphs & state, duint addr)
+{
+    for(size_t i = 0; i < state.code.size(); i++)
+        if(addr >= state.code[i].start && addr <= state.code[i].end)
+            return &state.code[i];
+    return 0;
+}
+
+static void graphfunction(module_graphs & state, ThreadPool & pool, duint start, duint end)
+{
+    SnapshotDecoder decoder(state.base, *state.image);
+    function_graph function;
+    function.start = start;
+    function.end = end;
+    if(!function.graph.Build(start, start, end, decoder))
+    {
+        std::unique_lock<std::mutex> guard(state.lock);
+        state.failed++;
+        return;
+    }
+    std::vector<duint> calls;
+    for(size_t i = 0; i < function.graph.InstrCount(); i++)
+    {
+        const cfg_instr & instr = function.graph.Instr(i);
+        if(instr.flow == FLOW_CALL && findcode(state, instr.target))
+            calls.push_back(instr.target);
+    }
+    {
+        std::unique_lock<std::mutex> guard(state.lock);
+        state.functions.push_back(std::move(function));
+        calls.erase(std::remove_if(calls.begin(), calls.end(), [&state](duint target)
+        {
+            return !state.queued.insert(target).second;
+        }), calls.end());
+    }
+    //without annotated bounds a function may span its whole section, the paths end it
+    for(size_t i = 0; i < calls.size(); i++)
+    {
+        duint target = calls[i];
+        const code_range* range = findcode(state, target);
+        duint sectionEnd = range->end;
+        pool.Enqueue([&state, &pool, target, sectionEnd]()
+        {
+            graphfunction(state, pool, target, sectionEnd);
+        });
+    }
+}
+
+//graphall module[,file[,format]]
+static bool cbGraphAll(int argc, char* argv[])
+{
+    using namespace Script;
+    syncpatches();
+    if(argc < 2)
+    {
+        _plugin_logputs("[TEST] not enough arguments!");
+        return false;
+    }
+    Module::ModuleInfo mod;
+    if(!Module::InfoFromName(argv[1], &mod))
+    {
+        _plugin_logprintf("[TEST] no module named \"%s\"!\n", argv[1]);
+        return false;
+    }
+    const graph_format* format = graph_format_find(argc > 3 ? argv[3] : "text");
+    if(!format)
+    {
+        _plugin_logprintf("[TEST] unknown graph format \"%s\"!\n", argv[3]);
+        return false;
+    }
+    wchar_t szFileName[MAX_PATH] = L"";
+    if(argc > 2 && *argv[2])
+        MultiByteToWideChar(CP_UTF8, 0, argv[2], -1, szFileName, MAX_PATH);
+    else
+    {
+        char name[MAX_MODULE_SIZE + 16] = "";
+        sprintf(name, "%s.%s", mod.name, format->extension);
+        wchar_t szName[MAX_MODULE_SIZE + 16] = L"";
+        MultiByteToWideChar(CP_UTF8, 0, name, -1, szName, MAX_MODULE_SIZE + 16);
+        DebuggerFile(szName, szFileName);
+    }
+    DWORD ticks = GetTickCount();
+
+    //one snapshot of the image, padded so the last instruction can be decoded
+    std::vector<unsigned char> image;
+    duint unreadable = streammemory(mod.base, mod.size, image);
+    if(unreadable)
+        _plugin_logprintf("[TEST] %d unreadable pages in %s, decoded as zeroes\n", (int)unreadable, mod.name);
+    image.resize(image.size() + MAX_INSTRUCTION_SIZE, 0);
+
+    module_graphs state;
+    state.base = mod.base;
+    state.image = &image;
+    state.failed = 0;
+    coderanges(mod.base, image, mod.size, state.code);
+    if(state.code.empty())
+    {
+        _plugin_logprintf("[TEST] no executable sections in %s!\n", mod.name);
+        return false;
+    }
+
+    //seeds: the entry point and every function annotation in the module
+    std::vector<code_range> seeds;
+    if(findcode(state, mod.entry))
+    {
+        code_range entry = { mod.entry, findcode(state, mod.entry)->end };
+        seeds.push_back(entry);
+    }
+    BridgeList<Function::FunctionInfo> functionList;
+    if(Function::GetList(&functionList))
+    {
+        for(int i = 0; i < functionList.Count(); i++)
+        {
+            const Function::FunctionInfo & info = functionList[i];
+            code_range function = { mod.base + info.rvaStart, mod.base + info.rvaEnd };
+            if(!_stricmp(info.mod, mod.name) && findcode(state, function.start))
+                seeds.push_back(function);
+        }
+    }
+    //each worker gets a task per function, so large and small functions balance out across the pool
+    seeds.erase(std::remove_if(seeds.begin(), seeds.end(), [&state](const code_range & seed)
+    {
+        return !state.queued.insert(seed.start).second;
+    }), seeds.end());
+    ThreadPool pool;
+    for(size_t i = 0; i < seeds.size(); i++)
+    {
+        code_range seed = seeds[i];
+        pool.Enqueue([&state, &pool, seed]()
+        {
+            graphfunction(state, pool, seed.start, seed.end);
+        });
+    }
+    pool.Wait();
+
+    std::sort(state.functions.begin(), state.functions.end(), [](const function_graph & a, const function_graph & b)
+    {
+        return a.start < b.start;
+    });
+    std::vector<const ControlFlowGraph*> graphs(state.functions.size());
+    for(size_t i = 0; i < graphs.size(); i++)
+        graphs[i] = &state.functions[i].graph;
+    FileSink file(szFileName);
+    if(!file.IsOpen() || !graph_export(format, file, graphs.data(), graphs.size()))
+    {
+        _plugin_logputs("[TEST] failed to write graphs!");
+        return false;
+    }
+    ULONGLONG decoded = 0;
+    for(size_t i = 0; i < state.functions.size(); i++)
+        decoded += state.functions[i].graph.DecodeCount();
+    _plugin_logprintf("[TEST] %d functions of %s graphed in %ums (%d failed, %llu instructions decoded)\n", (int)state.functions.size(), mod.name, GetTickCount() - ticks, (int)state.failed, decoded);
+    return true;
+}
+
+static duint exprZero(int argc, duint* argv, void* userdata)
+{
+	return 0;
 }
 
 void testInit(PLUG_INITSTRUCT* initStruct)
 {
     _plugin_logprintf("[TEST] pluginHandle: %d\n", pluginHandle);
+    char cachedir[MAX_PATH] = "";
+    GetModuleFileNameA(GetModuleHandleA(0), cachedir, MAX_PATH);
+    char* slash = strrchr(cachedir, '\\');
+    if(slash)
+    {
+        strcpy(slash, "\\graphcache");
+        CreateDirectoryA(cachedir, 0);
+        graphCache.SetDirectory(cachedir);
+        strcpy(slash, "\\yaracache");
+        CreateDirectoryA(cachedir, 0);
+        yaraCacheDir = cachedir;
+    }
     if(!_plugin_registercommand(pluginHandle, "plugin1", cbTestCommand, false))
         _plugin_logputs("[TEST] error registering the \"plugin1\" command!");
     if(!_plugin_registercommand(pluginHandle, "DumpProcess", cbDumpProcessCommand, true))
@@ -425,6 +2105,28 @@ void testInit(PLUG_INITSTRUCT* initStruct)
         _plugin_logputs("[TEST] error registering the \"graph\" command!");
     if (!_plugin_registercommand(pluginHandle, "modenum", cbModuleEnum, true))
         _plugin_logputs("[TEST] error registering the \"modenum\" command!");
+    if(!_plugin_registercommand(pluginHandle, "modhash", cbModHash, true))
+        _plugin_logputs("[TEST] error registering the \"modhash\" command!");
+    if(!_plugin_registercommand(pluginHandle, "moddiff", cbModDiff, true))
+        _plugin_logputs("[TEST] error registering the \"moddiff\" command!");
+    if(!_plugin_registercommand(pluginHandle, "graphall", cbGraphAll, true))
+        _plugin_logputs("[TEST] error registering the \"graphall\" command!");
+    if(!_plugin_registercommand(pluginHandle, "graphloops", cbGraphLoops, true))
+        _plugin_logputs("[TEST] error registering the \"graphloops\" command!");
+    if(!_plugin_registercommand(pluginHandle, "disasmstat", cbDisasmStat, true))
+        _plugin_logputs("[TEST] error registering the \"disasmstat\" command!");
+    if(!_plugin_registercommand(pluginHandle, "disasmdump", cbDisasmDump, true))
+        _plugin_logputs("[TEST] error registering the \"disasmdump\" command!");
+    if(!_plugin_registercommand(pluginHandle, "memstat", cbMemStat, false))
+        _plugin_logputs("[TEST] error registering the \"memstat\" command!");
+    if(!_plugin_registercommand(pluginHandle, "sigscan", cbSigScan, true))
+        _plugin_logputs("[TEST] error registering the \"sigscan\" command!");
+    if(!_plugin_registercommand(pluginHandle, "multiscan", cbMultiScan, true))
+        _plugin_logputs("[TEST] error registering the \"multiscan\" command!");
+    if(!_plugin_registercommand(pluginHandle, "yarascan", cbYaraScan, true))
+        _plugin_logputs("[TEST] error registering the \"yarascan\" command!");
+    if(!_plugin_registercommand(pluginHandle, "entropymap", cbEntropyMap, true))
+        _plugin_logputs("[TEST] error registering the \"entropymap\" command!");
     if (!_plugin_registerexprfunction(pluginHandle, "testplugin.zero", 0, exprZero, 0))
         _plugin_logputs("[TEST] error registering the \"testplugin.zero\" expression function!");
 }
@@ -435,6 +2137,17 @@ void testStop()
     _plugin_unregistercommand(pluginHandle, "DumpProcess");
     _plugin_unregistercommand(pluginHandle, "grs");
     _plugin_unregistercommand(pluginHandle, "modenum");
+    _plugin_unregistercommand(pluginHandle, "modhash");
+    _plugin_unregistercommand(pluginHandle, "moddiff");
+    _plugin_unregistercommand(pluginHandle, "graphall");
+    _plugin_unregistercommand(pluginHandle, "graphloops");
+    _plugin_unregistercommand(pluginHandle, "disasmstat");
+    _plugin_unregistercommand(pluginHandle, "disasmdump");
+    _plugin_unregistercommand(pluginHandle, "memstat");
+    _plugin_unregistercommand(pluginHandle, "sigscan");
+    _plugin_unregistercommand(pluginHandle, "multiscan");
+    _plugin_unregistercommand(pluginHandle, "yarascan");
+    _plugin_unregistercommand(pluginHandle, "entropymap");
     _plugin_menuclear(hMenu);
     _plugin_menuclear(hMenuDisasm);
     _plugin_menuclear(hMenuDump);
@@ -464,13 +2177,13 @@ void testSetup()
     _plugin_menuaddentry(hGraphMenu, MENU_GRAPH_SELECTION, "&Selection");
     _plugin_menuaddentry(hGraphMenu, MENU_GRAPH_FUNCTION, "&Function");
 
-    _plugin_menuaddentry(hMenuDisasm, MENU_DISASM_ADLER32, "&Adler32 Selection");
-    _plugin_menuentryseticon(pluginHandle, MENU_DISASM_ADLER32, &adler32);
+    _plugin_menuaddentry(hMenuDisasm, MENU_DISASM_HASH, "&Hash Selection");
+    _plugin_menuentryseticon(pluginHandle, MENU_DISASM_HASH, &adler32);
     _plugin_menuaddseparator(hMenuDisasm);
     _plugin_menuaddentry(hMenuDisasm, MENU_DISASM_GRAPH_SELECTION, "&Graph Selection");
     _plugin_menuaddentry(hMenuDisasm, MENU_DISASM_GRAPH_FUNCTION, "Graph &Function");
-    _plugin_menuaddentry(hMenuDump, MENU_DUMP_ADLER32, "&Adler32 Selection");
-    _plugin_menuentryseticon(pluginHandle, MENU_DUMP_ADLER32, &adler32);
-    _plugin_menuaddentry(hMenuStack, MENU_STACK_ADLER32, "&Adler32 Selection");
-    _plugin_menuentryseticon(pluginHandle, MENU_STACK_ADLER32, &adler32);
+    _plugin_menuaddentry(hMenuDump, MENU_DUMP_HASH, "&Hash Selection");
+    _plugin_menuentryseticon(pluginHandle, MENU_DUMP_HASH, &adler32);
+    _plugin_menuaddentry(hMenuStack, MENU_STACK_HASH, "&Hash Selection");
+    _plugin_menuentryseticon(pluginHandle, MENU_STACK_HASH, &adler32);
 }
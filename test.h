@@ -2,6 +2,9 @@
 #define _TEST_H
 
 #include "pluginmain.h"
+#include <vector>
+
+class Signature;
 
 //menu identifiers
 #define MENU_DUMP 0
@@ -12,9 +15,9 @@
 #define MENU_GRAPH_FUNCTION 5
 #define MENU_SCRIPT 6
 
-#define MENU_DISASM_ADLER32 7
-#define MENU_DUMP_ADLER32 8
-#define MENU_STACK_ADLER32 9
+#define MENU_DISASM_HASH 7
+#define MENU_DUMP_HASH 8
+#define MENU_STACK_HASH 9
 #define MENU_DISASM_GRAPH_SELECTION 10
 #define MENU_DISASM_GRAPH_FUNCTION 11
 
@@ -22,5 +25,9 @@
 void testInit(PLUG_INITSTRUCT* initStruct);
 void testStop();
 void testSetup();
+//drops cached memory wherever the patch list changed, call before reading debuggee memory
+void syncpatches();
+//addresses of the matches of sig in [start, start + size), stops after maxCount
+size_t sigscanmemory(duint start, duint size, const Signature & sig, std::vector<duint> & matches, size_t maxCount);
 
 #endif // _TEST_H
@@ -0,0 +1,62 @@
+#include "UnitTest.h"
+#include "Adler32.h"
+#include "CpuFeatures.h"
+#include <random>
+#include <vector>
+
+//the per byte modulo loop adler32selection used before
+static DWORD adler32_reference(const unsigned char* data, size_t len)
+{
+    DWORD a = 1, b = 0;
+    for(size_t i = 0; i < len; i++)
+    {
+        a = (a + data[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    return (b << 16) | a;
+}
+
+static DWORD adler32_chunked(const unsigned char* data, size_t len, size_t chunk)
+{
+    Adler32 adler;
+    for(size_t pos = 0; pos < len; pos += chunk)
+        adler.Update(data + pos, len - pos < chunk ? len - pos : chunk);
+    return adler.Digest();
+}
+
+//usage: Adler32Bench [megabytes]
+int main(int argc, char* argv[])
+{
+    size_t size = unit_arg(argc, argv, 256) << 20;
+    std::vector<unsigned char> data(size);
+    std::mt19937 random(1);
+    for(size_t i = 0; i < size; i++)
+        data[i] = (unsigned char)random();
+
+    //known values, all ones bytes push a and b to their largest sums between reductions
+    CHECK(adler32_chunked((const unsigned char*)"", 0, 1) == 1);
+    CHECK(adler32_chunked((const unsigned char*)"Wikipedia", 9, 9) == 0x11E60398);
+    std::vector<unsigned char> ones(100000, 0xFF);
+    CHECK(adler32_chunked(ones.data(), ones.size(), ones.size()) == adler32_reference(ones.data(), ones.size()));
+
+    //every kernel tail and block boundary, fed in uneven pieces
+    for(size_t len = 0; len < 300; len++)
+        CHECK(adler32_chunked(data.data() + 3, len, len ? len : 1) == adler32_reference(data.data() + 3, len));
+    size_t small = size < 0x100000 ? size : 0x100000;
+    DWORD expected = adler32_reference(data.data(), small);
+    size_t chunks[] = { 1, 7, 16, 33, 5552, 5553, 65536 };
+    for(size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++)
+        CHECK(adler32_chunked(data.data(), small, chunks[i]) == expected);
+
+    const cpu_features & features = cpu_get_features();
+    printf("kernel: %s\n", features.avx2 ? "avx2" : features.sse2 ? "sse2" : "scalar");
+    UnitTimer referenceTimer;
+    DWORD reference = adler32_reference(data.data(), size);
+    double referenceSeconds = referenceTimer.Seconds();
+    UnitTimer timer;
+    DWORD digest = adler32_chunked(data.data(), size, 0x100000);
+    double seconds = timer.Seconds();
+    CHECK(digest == reference);
+    printf("%zu MB: reference %.2f GB/s, Adler32 %.2f GB/s\n", size >> 20, size / referenceSeconds / 1e9, size / seconds / 1e9);
+    return unit_result("Adler32");
+}
@@ -0,0 +1,115 @@
+#include "UnitTest.h"
+#include "DisasmStream.h"
+#include <random>
+
+#define MEMORY_BASE 0x401000
+#define INVALID_OPCODE 0xF1
+
+//in-memory source with a length-only decoder: x86-like lengths from the first byte, one invalid opcode
+class BufferSource : public StreamSource
+{
+public:
+    BufferSource(const std::vector<unsigned char> & memory) : memory(memory), reads(0), bytesRead(0), largestRead(0) {}
+
+    void Read(ULONG_PTR addr, unsigned char* data, size_t size)
+    {
+        reads++;
+        bytesRead += size;
+        if(size > largestRead)
+            largestRead = size;
+        memset(data, 0, size);
+        if(addr < MEMORY_BASE || addr - MEMORY_BASE >= memory.size())
+            return;
+        size_t offset = addr - MEMORY_BASE;
+        memcpy(data, &memory[offset], memory.size() - offset < size ? memory.size() - offset : size);
+    }
+
+    unsigned int Decode(const unsigned char* data, ULONG_PTR)
+    {
+        return Length(data[0]);
+    }
+
+    static unsigned int Length(unsigned char opcode)
+    {
+        if(opcode == INVALID_OPCODE)
+            return 0;
+        static const unsigned char lengths[16] = { 1, 2, 2, 3, 3, 3, 4, 4, 5, 5, 6, 7, 7, 8, 10, 15 };
+        return lengths[opcode & 15];
+    }
+
+    const std::vector<unsigned char> & memory;
+    size_t reads;
+    ULONGLONG bytesRead;
+    size_t largestRead;
+};
+
+//the same sweep over the whole buffer at once
+static bool matches(const std::vector<unsigned char> & memory, ULONG_PTR start, ULONG_PTR end, size_t windowSize)
+{
+    BufferSource source(memory);
+    DisasmStream stream(source, start, end, windowSize);
+    stream_instr instr;
+    ULONG_PTR addr = start;
+    bool ok = true;
+    bool finished = end < start;
+    while(stream.Next(instr))
+    {
+        if(finished)
+            return false;
+        unsigned int size = BufferSource::Length(memory[addr - MEMORY_BASE]);
+        bool valid = size != 0;
+        if(!valid)
+            size = 1;
+        if(instr.addr != addr || instr.size != size || instr.valid != valid)
+            ok = false;
+        //the bytes of an instruction that runs past end have to be there too
+        for(unsigned int i = 0; i < size && addr + i - MEMORY_BASE < memory.size(); i++)
+            if(instr.bytes[i] != memory[addr + i - MEMORY_BASE])
+                ok = false;
+        if(end - addr < size)
+            finished = true;
+        addr += size;
+    }
+    return ok && finished;
+}
+
+//usage: DisasmStreamBench [megabytes]
+int main(int argc, char* argv[])
+{
+    size_t size = unit_arg(argc, argv, 256) << 20;
+    std::vector<unsigned char> memory(size);
+    std::mt19937 random(1);
+    for(size_t i = 0; i < size; i++)
+        memory[i] = (unsigned char)random();
+
+    //windows smaller than an instruction, instructions across every window end, ranges ending inside an instruction
+    ULONG_PTR start = MEMORY_BASE;
+    size_t windows[] = { 1, 7, 16, 17, 4096, STREAM_WINDOW_SIZE };
+    for(size_t i = 0; i < sizeof(windows) / sizeof(windows[0]); i++)
+    {
+        CHECK(matches(memory, start, start + 100000, windows[i]));
+        CHECK(matches(memory, start + 3, start + 4097, windows[i]));
+        CHECK(matches(memory, start + 5, start + 5, windows[i]));
+        CHECK(matches(memory, start + 5, start + 4, windows[i]));
+    }
+
+    //memory use is the window, whatever the range
+    BufferSource source(memory);
+    DisasmStream stream(source, start, start + size - 1);
+    stream_instr instr;
+    size_t count = 0;
+    size_t invalid = 0;
+    UnitTimer timer;
+    while(stream.Next(instr))
+    {
+        count++;
+        invalid += !instr.valid;
+    }
+    double seconds = timer.Seconds();
+    CHECK(source.largestRead == STREAM_WINDOW_SIZE + STREAM_MAX_INSTRUCTION);
+    //each window is read with its padding and starts at the instruction that crossed the previous end
+    CHECK(source.bytesRead < size + source.reads * STREAM_MAX_INSTRUCTION * 2);
+    printf("%zu MB: %zu instructions (%zu invalid) in %.1f ms, %.0fM instructions/s, %.2f GB/s\n", size >> 20, count, invalid, seconds * 1000, count / seconds / 1e6, size / seconds / 1e9);
+    printf("%zu reads of at most %zu bytes\n", source.reads, source.largestRead);
+    return unit_result("DisasmStream");
+}
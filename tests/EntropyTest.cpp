@@ -0,0 +1,78 @@
+#include "UnitTest.h"
+#include "Entropy.h"
+#include <algorithm>
+#include <math.h>
+#include <random>
+#include <vector>
+
+//histogram and shannon entropy of every window in double precision
+static void bruteEntropy(const unsigned char* data, size_t size, size_t window, std::vector<double> & bits)
+{
+    for(size_t pos = 0; pos < size; pos += window)
+    {
+        size_t n = size - pos < window ? size - pos : window;
+        size_t counts[256] = { 0 };
+        for(size_t i = 0; i < n; i++)
+            counts[data[pos + i]]++;
+        double h = 0;
+        for(int v = 0; v < 256; v++)
+            if(counts[v])
+                h -= (double)counts[v] / n * log2((double)counts[v] / n);
+        bits.push_back(h);
+    }
+}
+
+//the map is rounded from float math, a value right at a rounding edge may land one step off
+static void crossCheck(const std::vector<unsigned char> & data, size_t window)
+{
+    std::vector<unsigned char> map((data.size() + window - 1) / window + 1, 0xCC);
+    entropy_map(data.data(), data.size(), window, map.data());
+    CHECK(map.back() == 0xCC); //nothing written past the last window
+    std::vector<double> bits;
+    bruteEntropy(data.data(), data.size(), window, bits);
+    bool close = true;
+    for(size_t i = 0; i < bits.size(); i++)
+    {
+        double expected = bits[i] * ENTROPY_SCALE;
+        expected = expected > 255 ? 255 : expected;
+        if(fabs(map[i] - expected) > 0.5 + 0.01)
+        {
+            printf("window %zu of %zu bytes: %u, expected %.3f\n", i, window, map[i], expected);
+            close = false;
+            break;
+        }
+    }
+    CHECK(close);
+}
+
+int main()
+{
+    std::mt19937 random(1);
+    static const size_t windows[] = { 1, 2, 16, 31, 256, 1000, ENTROPY_MAX_WINDOW };
+    for(size_t w = 0; w < sizeof(windows) / sizeof(windows[0]); w++)
+    {
+        size_t window = windows[w];
+        size_t size = window * 9 + random() % window; //a shorter last window most of the time
+        std::vector<unsigned char> data(size);
+        //uniform bytes, up to 8 bits per byte
+        for(size_t i = 0; i < size; i++)
+            data[i] = (unsigned char)random();
+        crossCheck(data, window);
+        //a small alphabet, between 0 and 2 bits
+        for(size_t i = 0; i < size; i++)
+            data[i] = (unsigned char)(random() % 4);
+        crossCheck(data, window);
+        //runs of one value, whole windows of it take the uniform shortcut
+        for(size_t i = 0; i < size; i++)
+            data[i] = (unsigned char)((i / (window / 2 + 1)) % 3 ? 0 : random() % 2);
+        crossCheck(data, window);
+        //all zero
+        std::fill(data.begin(), data.end(), 0);
+        crossCheck(data, window);
+    }
+    //an empty buffer writes nothing
+    unsigned char out = 0xCC;
+    entropy_map(0, 0, 256, &out);
+    CHECK(out == 0xCC);
+    return unit_result("EntropyTest");
+}
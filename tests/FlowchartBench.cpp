@@ -0,0 +1,247 @@
+#include "UnitTest.h"
+#include "FunctionGraph.h"
+#include <list>
+#include <new>
+#include <set>
+#include <string>
+
+//every heap allocation of the process goes through here
+static size_t allocations = 0;
+
+void* operator new(size_t size)
+{
+    allocations++;
+    void* ptr = malloc(size ? size : 1);
+    if(!ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+
+#define FAKE_START 0x401000
+#define FAKE_INSTR_SIZE 4
+
+static ULONG_PTR fakeEnd;
+
+//synthetic code: a conditional jump every 16 instructions, an unconditional one every 64
+static ULONG_PTR fakeInstrInfo(ULONG_PTR addr, instr_info* info)
+{
+    size_t index = (addr - FAKE_START) / FAKE_INSTR_SIZE;
+    info->addr = addr;
+    info->jmpaddr = 0;
+    if(index % 64 == 63)
+    {
+        info->jmpaddr = FAKE_START + ((index * 7919) % (index + 1)) * FAKE_INSTR_SIZE;
+        sprintf(info->instrText, "jmp 0x%X", (unsigned int)info->jmpaddr);
+    }
+    else if(index % 16 == 15)
+    {
+        info->jmpaddr = addr + 40 * FAKE_INSTR_SIZE;
+        if(info->jmpaddr > fakeEnd)
+            info->jmpaddr = FAKE_START;
+        sprintf(info->instrText, "jne 0x%X", (unsigned int)info->jmpaddr);
+    }
+    else
+        sprintf(info->instrText, "mov rax, qword ptr ss:[rsp+0x%X]", (unsigned int)(index % 0x100));
+    if(index % 5 == 0)
+        sprintf(info->comment, "\"string %u\" \\ %u", (unsigned int)index, (unsigned int)(index * 3));
+    return addr + FAKE_INSTR_SIZE;
+}
+
+static bool fakeInstrInfoBatch(ULONG_PTR start, ULONG_PTR end, InstrList* list)
+{
+    instr_info info;
+    for(ULONG_PTR addr = start; addr + FAKE_INSTR_SIZE - 1 <= end; addr += FAKE_INSTR_SIZE)
+    {
+        info.instrText[0] = '\0';
+        info.comment[0] = '\0';
+        fakeInstrInfo(addr, &info);
+        list->Add(info.addr, info.jmpaddr, info.instrText, info.comment);
+    }
+    return true;
+}
+
+//counts the writes that reach the sink, optionally keeping the data
+class CountingSink : public OutputSink
+{
+public:
+    CountingSink(bool keep) : writes(0), bytes(0), keep(keep) {}
+    bool Write(const void* data, size_t size)
+    {
+        writes++;
+        bytes += size;
+        if(keep)
+            memory.Write(data, size);
+        return true;
+    }
+
+    size_t writes;
+    size_t bytes;
+    bool keep;
+    MemorySink memory;
+};
+
+static void legacyPointer(char* text, ULONG_PTR value)
+{
+    sprintf(text, "%0*llX", (int)sizeof(ULONG_PTR) * 2, (unsigned long long)value);
+}
+
+//the std::list/std::set pass with one write per line that make_flowchart used to be
+struct legacy_instr
+{
+    ULONG_PTR addr;
+    ULONG_PTR jmpaddr;
+    std::string instrText;
+    std::string comment;
+};
+
+static void legacyFlowchart(ULONG_PTR start, ULONG_PTR end, OutputSink & output, GETINSTRINFO getInstrInfo, const std::string & params)
+{
+    char buffer[INSTR_TEXT_SIZE * 2 + 4];
+    char a[32], b[32];
+    ULONG_PTR currentnode = start;
+    legacyPointer(a, start);
+    output.Write(buffer, sprintf(buffer, "graph: {\ntitle: \"Graph of %s\"\n", a));
+    output.Write(params.c_str(), params.size());
+    output.Write(buffer, sprintf(buffer, "node: { title: \"%s\" vertical_order: 0 color: 83 fontname: \"courR12\" label: \"%s:", a, a));
+
+    std::set<ULONG_PTR> nodelist;
+    std::list<legacy_instr> disasmlist;
+    ULONG_PTR psize = 0;
+    ULONG_PTR current_addr = start;
+    do
+    {
+        current_addr += psize;
+        instr_info info;
+        info.instrText[0] = '\0';
+        info.comment[0] = '\0';
+        ULONG_PTR next_addr = getInstrInfo(current_addr, &info);
+        psize = next_addr - current_addr;
+        if(psize <= 0)
+            psize = 1;
+        legacy_instr instr = { info.addr, info.jmpaddr, info.instrText, info.comment };
+        disasmlist.push_back(instr);
+        if(currentnode == 0)
+        {
+            currentnode = current_addr;
+            nodelist.insert(currentnode);
+        }
+        if(info.jmpaddr >= start && info.jmpaddr < end)
+        {
+            nodelist.insert(info.jmpaddr);
+            currentnode = 0;
+        }
+    }
+    while(current_addr + psize <= end);
+
+    currentnode = start;
+    bool orphannode = true;
+    ULONG_PTR edgesource = 0, edgetrue = 0;
+    std::string edgelist;
+    for(std::list<legacy_instr>::iterator i = disasmlist.begin(); i != disasmlist.end(); ++i)
+    {
+        legacy_instr instr = *i;
+        current_addr = instr.addr;
+        if(nodelist.find(current_addr) != nodelist.end())
+        {
+            if(orphannode)
+            {
+                legacyPointer(a, currentnode);
+                legacyPointer(b, current_addr);
+                sprintf(buffer, "edge: { sourcename: \"%s\" targetname: \"%s\" }\n", a, b);
+                edgelist += buffer;
+            }
+            orphannode = true;
+            currentnode = current_addr;
+            output.Write(buffer, sprintf(buffer, "\" }\n"));
+            legacyPointer(a, current_addr);
+            output.Write(buffer, sprintf(buffer, "node: { title: \"%s\" color: 83 fontname: \"courR12\" label: \"%s:", a, a));
+        }
+        if(instr.comment.length())
+        {
+            std::string clean;
+            for(size_t j = 0; j < instr.comment.size(); j++)
+            {
+                if(instr.comment[j] == '"' || instr.comment[j] == '\\')
+                    clean += '\\';
+                clean += instr.comment[j];
+            }
+            output.Write(buffer, sprintf(buffer, "\n%s\t; %s", instr.instrText.c_str(), clean.c_str()));
+        }
+        else
+            output.Write(buffer, sprintf(buffer, "\n%s", instr.instrText.c_str()));
+        if(edgesource != 0)
+        {
+            legacyPointer(a, edgesource);
+            legacyPointer(b, currentnode);
+            sprintf(buffer, "edge: { sourcename: \"%s\" targetname: \"%s\" label: \"false\" color: red }\n", a, b);
+            edgelist += buffer;
+            legacyPointer(b, edgetrue);
+            sprintf(buffer, "edge: { sourcename: \"%s\" targetname: \"%s\" label: \"true\" color: darkgreen }\n", a, b);
+            edgelist += buffer;
+            edgesource = 0;
+        }
+        if(instr.jmpaddr >= start && instr.jmpaddr < end)
+        {
+            orphannode = false;
+            edgesource = currentnode;
+            edgetrue = instr.jmpaddr;
+            if(!_stricmp(instr.instrText.substr(0, 3).c_str(), "jmp"))
+            {
+                legacyPointer(a, edgesource);
+                legacyPointer(b, edgetrue);
+                sprintf(buffer, "edge: { sourcename: \"%s\" targetname: \"%s\" }\n", a, b);
+                edgelist += buffer;
+                edgesource = 0;
+            }
+        }
+    }
+    output.Write(buffer, sprintf(buffer, "\" vertical_order: %d }\n", (int)nodelist.size()));
+    output.Write(edgelist.c_str(), edgelist.length());
+    output.Write(buffer, sprintf(buffer, "}\n"));
+}
+
+//usage: FlowchartBench [instructions]
+int main(int argc, char* argv[])
+{
+    size_t count = unit_arg(argc, argv, 200000);
+    ULONG_PTR start = FAKE_START;
+    ULONG_PTR end = FAKE_START + count * FAKE_INSTR_SIZE - 1;
+    fakeEnd = end;
+
+    //all three writers have to produce the same graph, the layout parameters after the title are shared
+    CountingSink output(true);
+    CHECK(make_flowchart(start, end, output, fakeInstrInfo));
+    const std::string & text = output.memory.Data();
+    size_t paramsStart = text.find('\n', text.find('\n') + 1) + 1;
+    std::string params = text.substr(paramsStart, text.find("node: {") - paramsStart);
+    CountingSink legacyOutput(true);
+    legacyFlowchart(start, end, legacyOutput, fakeInstrInfo, params);
+    CountingSink batchOutput(true);
+    CHECK(make_flowchart(start, end, batchOutput, fakeInstrInfoBatch));
+    CHECK(output.memory.Data() == legacyOutput.memory.Data());
+    CHECK(batchOutput.memory.Data() == output.memory.Data());
+
+    CountingSink legacySink(false);
+    size_t before = allocations;
+    UnitTimer legacyTimer;
+    legacyFlowchart(start, end, legacySink, fakeInstrInfo, params);
+    double legacySeconds = legacyTimer.Seconds();
+    size_t legacyAllocations = allocations - before;
+
+    CountingSink sink(false);
+    before = allocations;
+    UnitTimer timer;
+    make_flowchart(start, end, sink, fakeInstrInfo);
+    double seconds = timer.Seconds();
+    size_t newAllocations = allocations - before;
+
+    printf("%zu instructions, %zu bytes of VCG\n", count, sink.bytes);
+    printf("std::list/std::set: %8.1f ms %8zu allocations %8zu writes\n", legacySeconds * 1000, legacyAllocations, legacySink.writes);
+    printf("InstrList/bitmap:   %8.1f ms %8zu allocations %8zu writes\n", seconds * 1000, newAllocations, sink.writes);
+    return unit_result("Flowchart");
+}
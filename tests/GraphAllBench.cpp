@@ -0,0 +1,302 @@
+#include "UnitTest.h"
+#include "GraphExport.h"
+#include "ThreadPool.h"
+#include "TestDecoders.h"
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <unordered_set>
+
+#define IMAGE_BASE 0x140001000
+
+//toy instruction set for the synthetic image, the opcode byte decides size and flow
+enum toy_opcode
+{
+    OP_NORMAL = 1, //3 bytes
+    OP_CONDITIONAL, //5 bytes, rel32
+    OP_JUMP, //5 bytes, rel32
+    OP_CALL, //5 bytes, rel32
+    OP_RETURN //1 byte
+};
+
+static unsigned int opsize(unsigned char opcode)
+{
+    switch(opcode)
+    {
+    case OP_NORMAL:
+        return 3;
+    case OP_RETURN:
+        return 1;
+    default:
+        return 5;
+    }
+}
+
+struct toy_function
+{
+    ULONG_PTR start;
+    ULONG_PTR end;
+    std::vector<unsigned char> ops;
+    std::vector<size_t> targets; //instruction index for branches, function index for calls
+};
+
+//functions with forward branches, loops and calls to each other, laid out back to back
+static void makeImage(size_t count, std::vector<toy_function> & functions, std::vector<unsigned char> & image)
+{
+    std::mt19937 random(1);
+    functions.resize(count);
+    ULONG_PTR addr = IMAGE_BASE;
+    for(size_t f = 0; f < count; f++)
+    {
+        toy_function & function = functions[f];
+        size_t length = 10 + random() % 190;
+        for(size_t i = 0; i + 1 < length; i++)
+        {
+            unsigned int kind = random() % 100;
+            unsigned char op = OP_NORMAL;
+            size_t target = 0;
+            if(kind < 10)
+            {
+                op = OP_CONDITIONAL;
+                target = std::min(i + 1 + random() % 8, length - 1);
+            }
+            else if(kind < 13 && i)
+            {
+                op = OP_CONDITIONAL;
+                target = i - 1 - random() % std::min(i, (size_t)10);
+            }
+            else if(kind < 21)
+            {
+                op = OP_CALL;
+                target = random() % count;
+            }
+            else if(kind < 22)
+            {
+                op = OP_JUMP;
+                target = i + 1;
+            }
+            function.ops.push_back(op);
+            function.targets.push_back(target);
+        }
+        function.ops.push_back(OP_RETURN);
+        function.targets.push_back(0);
+        function.start = addr;
+        for(size_t i = 0; i < function.ops.size(); i++)
+            addr += opsize(function.ops[i]);
+        function.end = addr - 1;
+        addr += 16 - addr % 16; //alignment padding
+    }
+    image.assign(addr - IMAGE_BASE + 16, 0);
+    for(size_t f = 0; f < count; f++)
+    {
+        const toy_function & function = functions[f];
+        std::vector<ULONG_PTR> offsets;
+        ULONG_PTR at = function.start;
+        for(size_t i = 0; i < function.ops.size(); i++)
+        {
+            offsets.push_back(at);
+            at += opsize(function.ops[i]);
+        }
+        for(size_t i = 0; i < function.ops.size(); i++)
+        {
+            unsigned char* data = &image[offsets[i] - IMAGE_BASE];
+            data[0] = function.ops[i];
+            if(opsize(data[0]) != 5)
+                continue;
+            ULONG_PTR target = data[0] == OP_CALL ? functions[function.targets[i]].start : offsets[function.targets[i]];
+            int rel = (int)(target - (offsets[i] + 5));
+            memcpy(data + 1, &rel, sizeof(rel));
+        }
+    }
+}
+
+class ToyDecoder : public CodeDecoder
+{
+public:
+    ToyDecoder(const std::vector<unsigned char> & image) : image(image) {}
+
+    bool Decode(ULONG_PTR addr, cfg_instr & instr)
+    {
+        if(addr < IMAGE_BASE || addr - IMAGE_BASE + 5 > image.size())
+            return false;
+        const unsigned char* data = &image[addr - IMAGE_BASE];
+        if(data[0] < OP_NORMAL || data[0] > OP_RETURN)
+            return false;
+        instr.addr = addr;
+        instr.size = opsize(data[0]);
+        instr.target = 0;
+        instr.table = 0;
+        if(instr.size == 5)
+        {
+            int rel;
+            memcpy(&rel, data + 1, sizeof(rel));
+            instr.target = addr + 5 + rel;
+        }
+        static const cfg_flow flows[] = { FLOW_NORMAL, FLOW_NORMAL, FLOW_CONDITIONAL, FLOW_JUMP, FLOW_CALL, FLOW_RETURN };
+        instr.flow = flows[data[0]];
+        return true;
+    }
+
+private:
+    const std::vector<unsigned char> & image;
+};
+
+struct function_graph
+{
+    ULONG_PTR start;
+    ControlFlowGraph graph;
+};
+
+//the graphall work distribution: one task per function, call targets are queued as new tasks
+struct module_graphs
+{
+    const std::vector<unsigned char>* image;
+    ULONG_PTR codeEnd;
+    std::mutex lock;
+    std::unordered_set<ULONG_PTR> queued;
+    std::vector<function_graph> functions;
+    size_t failed;
+};
+
+static void graphfunction(module_graphs & state, ThreadPool & pool, ULONG_PTR start, ULONG_PTR end)
+{
+    ToyDecoder decoder(*state.image);
+    function_graph function;
+    function.start = start;
+    if(!function.graph.Build(start, start, end, decoder))
+    {
+        std::unique_lock<std::mutex> guard(state.lock);
+        state.failed++;
+        return;
+    }
+    std::vector<ULONG_PTR> calls;
+    for(size_t i = 0; i < function.graph.InstrCount(); i++)
+    {
+        const cfg_instr & instr = function.graph.Instr(i);
+        if(instr.flow == FLOW_CALL && instr.target >= IMAGE_BASE && instr.target <= state.codeEnd)
+            calls.push_back(instr.target);
+    }
+    {
+        std::unique_lock<std::mutex> guard(state.lock);
+        state.functions.push_back(std::move(function));
+        calls.erase(std::remove_if(calls.begin(), calls.end(), [&state](ULONG_PTR target)
+        {
+            return !state.queued.insert(target).second;
+        }), calls.end());
+    }
+    for(size_t i = 0; i < calls.size(); i++)
+    {
+        ULONG_PTR target = calls[i];
+        ULONG_PTR codeEnd = state.codeEnd;
+        pool.Enqueue([&state, &pool, target, codeEnd]()
+        {
+            graphfunction(state, pool, target, codeEnd);
+        });
+    }
+}
+
+class CountingSink : public OutputSink
+{
+public:
+    CountingSink() : bytes(0) {}
+    bool Write(const void*, size_t size)
+    {
+        bytes += size;
+        return true;
+    }
+
+    size_t bytes;
+};
+
+//functions the seeds lead to through calls, by breadth first search over the generated code
+static size_t reachableFunctions(const std::vector<toy_function> & functions, const std::vector<size_t> & seeds)
+{
+    std::vector<bool> seen(functions.size(), false);
+    std::vector<size_t> queue(seeds);
+    for(size_t i = 0; i < seeds.size(); i++)
+        seen[seeds[i]] = true;
+    for(size_t q = 0; q < queue.size(); q++)
+    {
+        const toy_function & function = functions[queue[q]];
+        for(size_t i = 0; i < function.ops.size(); i++)
+            if(function.ops[i] == OP_CALL && !seen[function.targets[i]])
+            {
+                seen[function.targets[i]] = true;
+                queue.push_back(function.targets[i]);
+            }
+    }
+    return queue.size();
+}
+
+//usage: GraphAllBench [functions [workers]]
+int main(int argc, char* argv[])
+{
+    size_t count = unit_arg(argc, argv, 20000);
+    std::vector<toy_function> functions;
+    std::vector<unsigned char> image;
+    makeImage(count, functions, image);
+    //the entry point and every fourth function are annotated, the rest is only found through calls
+    std::vector<size_t> seeds;
+    for(size_t f = 0; f < count; f += 4)
+        seeds.push_back(f);
+    size_t expected = reachableFunctions(functions, seeds);
+    printf("%zu functions, %zu reachable, %zu KB image\n", count, expected, image.size() >> 10);
+
+    //powers of two up to every logical processor
+    size_t cores = argc > 2 ? (size_t)strtoul(argv[2], 0, 0) : std::thread::hardware_concurrency();
+    std::vector<size_t> workerCounts;
+    for(size_t workers = 1; workers < cores; workers *= 2)
+        workerCounts.push_back(workers);
+    workerCounts.push_back(cores ? cores : 1);
+    double single = 0;
+    ULONGLONG singleDecoded = 0;
+    for(size_t w = 0; w < workerCounts.size(); w++)
+    {
+        size_t workers = workerCounts[w];
+        module_graphs state;
+        state.image = &image;
+        state.codeEnd = functions.back().end;
+        state.failed = 0;
+        UnitTimer timer;
+        for(size_t i = 0; i < seeds.size(); i++)
+            state.queued.insert(functions[seeds[i]].start);
+        {
+            ThreadPool pool(workers);
+            for(size_t i = 0; i < seeds.size(); i++)
+            {
+                const toy_function & seed = functions[seeds[i]];
+                ULONG_PTR start = seed.start;
+                ULONG_PTR end = seed.end;
+                pool.Enqueue([&state, &pool, start, end]()
+                {
+                    graphfunction(state, pool, start, end);
+                });
+            }
+            pool.Wait();
+        }
+        std::sort(state.functions.begin(), state.functions.end(), [](const function_graph & a, const function_graph & b)
+        {
+            return a.start < b.start;
+        });
+        std::vector<const ControlFlowGraph*> graphs(state.functions.size());
+        for(size_t i = 0; i < graphs.size(); i++)
+            graphs[i] = &state.functions[i].graph;
+        CountingSink sink;
+        CHECK(graph_export(graph_format_find("text"), sink, graphs.data(), graphs.size()));
+        double seconds = timer.Seconds();
+
+        ULONGLONG decoded = 0;
+        for(size_t i = 0; i < state.functions.size(); i++)
+            decoded += state.functions[i].graph.DecodeCount();
+        CHECK(state.failed == 0);
+        CHECK(state.functions.size() == expected);
+        if(w == 0)
+        {
+            single = seconds;
+            singleDecoded = decoded;
+        }
+        CHECK(decoded == singleDecoded);
+        printf("%2zu workers: %8.1f ms, %.2fx, %llu instructions, %zu KB exported\n", workers, seconds * 1000, single / seconds, decoded, sink.bytes >> 10);
+    }
+    return unit_result("GraphAll");
+}
@@ -0,0 +1,280 @@
+#include "UnitTest.h"
+#include "GraphAnalysis.h"
+#include "TestDecoders.h"
+#include <random>
+#include <set>
+
+typedef std::vector<std::pair<size_t, size_t>> EDGELIST;
+
+//true when target can be reached from source without passing through removed
+static bool reaches(size_t nodeCount, const EDGELIST & edges, size_t source, size_t target, size_t removed = CFG_NONE)
+{
+    if(source == removed)
+        return false;
+    std::vector<unsigned char> seen(nodeCount, 0);
+    std::vector<size_t> stack(1, source);
+    seen[source] = 1;
+    while(!stack.empty())
+    {
+        size_t node = stack.back();
+        stack.pop_back();
+        if(node == target)
+            return true;
+        for(size_t i = 0; i < edges.size(); i++)
+        {
+            size_t next = edges[i].second;
+            if(edges[i].first == node && next != removed && !seen[next])
+            {
+                seen[next] = 1;
+                stack.push_back(next);
+            }
+        }
+    }
+    return false;
+}
+
+//checks every answer of the analysis against the definitions, by brute force
+static void verify(size_t nodeCount, const EDGELIST & edges, size_t entry)
+{
+    GraphAnalysis analysis;
+    analysis.Analyze(nodeCount, edges, entry);
+    CHECK(analysis.NodeCount() == nodeCount);
+
+    std::vector<bool> reachable(nodeCount);
+    for(size_t i = 0; i < nodeCount; i++)
+    {
+        reachable[i] = reaches(nodeCount, edges, entry, i);
+        CHECK(analysis.Reachable(i) == reachable[i]);
+    }
+
+    //a dominates b when every path from the entry to b passes a
+    std::vector<std::vector<bool>> dominates(nodeCount, std::vector<bool>(nodeCount, false));
+    for(size_t a = 0; a < nodeCount; a++)
+        for(size_t b = 0; b < nodeCount; b++)
+        {
+            if(reachable[a] && reachable[b])
+                dominates[a][b] = a == b || !reaches(nodeCount, edges, entry, b, a);
+            CHECK(analysis.Dominates(a, b) == dominates[a][b]);
+        }
+
+    //the immediate dominator is the strict dominator that every other strict dominator dominates
+    for(size_t b = 0; b < nodeCount; b++)
+    {
+        size_t idom = CFG_NONE;
+        if(reachable[b] && b != entry)
+            for(size_t a = 0; a < nodeCount; a++)
+            {
+                if(a == b || !dominates[a][b])
+                    continue;
+                bool immediate = true;
+                for(size_t c = 0; c < nodeCount; c++)
+                    if(c != a && c != b && dominates[c][b] && !dominates[c][a])
+                        immediate = false;
+                if(immediate)
+                    idom = a;
+            }
+        CHECK(analysis.Idom(b) == idom);
+    }
+
+    //natural loops, back edges to the same header share one body
+    std::vector<std::set<size_t>> bodies;
+    std::vector<size_t> headers;
+    for(size_t h = 0; h < nodeCount; h++)
+    {
+        std::set<size_t> body;
+        for(size_t i = 0; i < edges.size(); i++)
+        {
+            size_t source = edges[i].first;
+            if(edges[i].second != h || !reachable[source] || !dominates[h][source])
+                continue;
+            body.insert(h);
+            for(size_t n = 0; n < nodeCount; n++)
+                if(reachable[n] && (n == source || reaches(nodeCount, edges, n, source, h)))
+                    body.insert(n);
+        }
+        if(!body.empty())
+        {
+            bodies.push_back(body);
+            headers.push_back(h);
+        }
+    }
+    CHECK(analysis.LoopCount() == bodies.size());
+    if(analysis.LoopCount() != bodies.size())
+        return;
+    std::vector<size_t> loopOf(headers.size(), CFG_NONE); //brute force loop -> analysis loop
+    for(size_t i = 0; i < analysis.LoopCount(); i++)
+    {
+        const cfg_loop & loop = analysis.Loop(i);
+        for(size_t j = 0; j < headers.size(); j++)
+            if(headers[j] == loop.header)
+                loopOf[j] = i;
+    }
+    for(size_t j = 0; j < headers.size(); j++)
+    {
+        CHECK(loopOf[j] != CFG_NONE);
+        if(loopOf[j] == CFG_NONE)
+            return;
+        CHECK(analysis.Loop(loopOf[j]).size == bodies[j].size());
+    }
+    //innermost loop of a node is the smallest body holding it, the parent of a loop the smallest body around it
+    for(size_t n = 0; n < nodeCount; n++)
+    {
+        size_t inner = CFG_NONE;
+        for(size_t j = 0; j < bodies.size(); j++)
+            if(bodies[j].count(n) && (inner == CFG_NONE || bodies[j].size() < bodies[inner].size()))
+                inner = j;
+        CHECK(analysis.LoopOf(n) == (inner == CFG_NONE ? CFG_NONE : loopOf[inner]));
+    }
+    for(size_t j = 0; j < bodies.size(); j++)
+    {
+        const cfg_loop & loop = analysis.Loop(loopOf[j]);
+        size_t parent = CFG_NONE;
+        size_t depth = 0;
+        for(size_t k = 0; k < bodies.size(); k++)
+            if(k != j && bodies[k].count(headers[j]))
+            {
+                depth++;
+                if(parent == CFG_NONE || bodies[k].size() < bodies[parent].size())
+                    parent = k;
+            }
+        CHECK(loop.parent == (parent == CFG_NONE ? CFG_NONE : loopOf[parent]));
+        CHECK(loop.depth == depth);
+        if(loop.parent != CFG_NONE)
+            CHECK(loop.parent < loopOf[j]);
+    }
+
+    //components are the mutually reachable sets, numbered in reverse topological order
+    std::set<size_t> components;
+    for(size_t a = 0; a < nodeCount; a++)
+    {
+        components.insert(analysis.SccOf(a));
+        for(size_t b = 0; b < nodeCount; b++)
+        {
+            bool mutual = a == b || (reaches(nodeCount, edges, a, b) && reaches(nodeCount, edges, b, a));
+            CHECK((analysis.SccOf(a) == analysis.SccOf(b)) == mutual);
+        }
+    }
+    CHECK(analysis.SccCount() == components.size());
+    for(size_t i = 0; i < edges.size(); i++)
+        CHECK(analysis.SccOf(edges[i].first) >= analysis.SccOf(edges[i].second));
+}
+
+//two nested loops with a shared exit block
+static void nestedLoops()
+{
+    //0 -> 1 -> 2 <-> 3 -> 4 -> 1, 4 -> 5
+    EDGELIST edges;
+    edges.push_back(std::make_pair(0, 1));
+    edges.push_back(std::make_pair(1, 2));
+    edges.push_back(std::make_pair(2, 3));
+    edges.push_back(std::make_pair(3, 2));
+    edges.push_back(std::make_pair(3, 4));
+    edges.push_back(std::make_pair(4, 1));
+    edges.push_back(std::make_pair(4, 5));
+    GraphAnalysis analysis;
+    analysis.Analyze(6, edges, 0);
+    CHECK(analysis.LoopCount() == 2);
+    CHECK(analysis.Loop(0).header == 1);
+    CHECK(analysis.Loop(0).parent == CFG_NONE);
+    CHECK(analysis.Loop(0).size == 4);
+    CHECK(analysis.Loop(1).header == 2);
+    CHECK(analysis.Loop(1).parent == 0);
+    CHECK(analysis.Loop(1).depth == 1);
+    CHECK(analysis.Loop(1).size == 2);
+    CHECK(analysis.LoopOf(0) == CFG_NONE);
+    CHECK(analysis.LoopOf(3) == 1);
+    CHECK(analysis.LoopOf(4) == 0);
+    CHECK(analysis.LoopOf(5) == CFG_NONE);
+    CHECK(analysis.Idom(5) == 4);
+    CHECK(analysis.SccCount() == 3);
+    verify(6, edges, 0);
+}
+
+//the two entries into the cycle make it irreducible, so it is a component but not a natural loop
+static void irreducible()
+{
+    EDGELIST edges;
+    edges.push_back(std::make_pair(0, 1));
+    edges.push_back(std::make_pair(0, 2));
+    edges.push_back(std::make_pair(1, 2));
+    edges.push_back(std::make_pair(2, 1));
+    edges.push_back(std::make_pair(2, 3));
+    GraphAnalysis analysis;
+    analysis.Analyze(4, edges, 0);
+    CHECK(analysis.LoopCount() == 0);
+    CHECK(analysis.SccOf(1) == analysis.SccOf(2));
+    CHECK(analysis.Idom(1) == 0);
+    CHECK(analysis.Idom(2) == 0);
+    verify(4, edges, 0);
+}
+
+//unreachable nodes have no dominator and belong to no loop, but still get a component
+static void unreachable()
+{
+    EDGELIST edges;
+    edges.push_back(std::make_pair(0, 1));
+    edges.push_back(std::make_pair(2, 3));
+    edges.push_back(std::make_pair(3, 2));
+    edges.push_back(std::make_pair(3, 1));
+    GraphAnalysis analysis;
+    analysis.Analyze(4, edges, 0);
+    CHECK(!analysis.Reachable(2));
+    CHECK(analysis.Idom(2) == CFG_NONE);
+    CHECK(analysis.Idom(1) == 0);
+    CHECK(analysis.LoopCount() == 0);
+    CHECK(analysis.SccOf(2) == analysis.SccOf(3));
+    CHECK(analysis.SccCount() == 3);
+    verify(4, edges, 0);
+}
+
+//the node indices of a built graph go straight into the analysis
+static void controlFlowGraph()
+{
+    TableDecoder decoder;
+    decoder.Add(0x1000, 2, FLOW_NORMAL);
+    decoder.Add(0x1002, 2, FLOW_NORMAL); //loop header
+    decoder.Add(0x1004, 2, FLOW_CONDITIONAL, 0x100A);
+    decoder.Add(0x1006, 2, FLOW_NORMAL);
+    decoder.Add(0x1008, 2, FLOW_JUMP, 0x1002);
+    decoder.Add(0x100A, 1, FLOW_RETURN);
+    ControlFlowGraph graph;
+    CHECK(graph.Build(0x1000, 0x1000, 0x10FF, decoder));
+    CHECK(graph.NodeCount() == 4);
+    GraphAnalysis analysis;
+    analysis.Analyze(graph);
+    CHECK(analysis.NodeCount() == graph.NodeCount());
+    CHECK(analysis.LoopCount() == 1);
+    if(analysis.LoopCount() == 1)
+    {
+        CHECK(graph.Node(analysis.Loop(0).header).start == 0x1002);
+        CHECK(analysis.Loop(0).size == 2);
+    }
+    size_t exit = graph.FindNode(0x100A);
+    CHECK(analysis.LoopOf(exit) == CFG_NONE);
+    CHECK(graph.Node(analysis.Idom(exit)).start == 0x1002);
+}
+
+//random graphs of every shape, small enough for the brute force
+static void randomGraphs()
+{
+    std::mt19937 random(1);
+    for(int i = 0; i < 500; i++)
+    {
+        size_t nodeCount = 1 + random() % 14;
+        size_t edgeCount = random() % (nodeCount * 3);
+        EDGELIST edges;
+        for(size_t j = 0; j < edgeCount; j++)
+            edges.push_back(std::make_pair(random() % nodeCount, random() % nodeCount));
+        verify(nodeCount, edges, random() % nodeCount);
+    }
+}
+
+int main()
+{
+    nestedLoops();
+    irreducible();
+    unreachable();
+    controlFlowGraph();
+    randomGraphs();
+    return unit_result("GraphAnalysis");
+}
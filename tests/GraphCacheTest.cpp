@@ -0,0 +1,166 @@
+#include "UnitTest.h"
+#include "GraphCache.h"
+#include "TestDecoders.h"
+#include <string>
+
+#define MODULE_HASH 0x1122334455667788ULL
+#define MODULE_BASE 0x400000
+
+//the file GraphCache keeps for MODULE_HASH in the current directory
+static std::string cacheFile()
+{
+    char name[32] = "";
+    sprintf(name, "%016llX.cfg", MODULE_HASH);
+    return std::string(".\\") + name;
+}
+
+static long fileSize(const std::string & name)
+{
+    FILE* file = fopen(name.c_str(), "rb");
+    if(!file)
+        return -1;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+    return size;
+}
+
+static bool fileExists(const std::string & name)
+{
+    return fileSize(name) >= 0;
+}
+
+//a loop with an exit, enough for a graph with a few blocks
+static void buildGraph(ControlFlowGraph & graph)
+{
+    TableDecoder decoder;
+    decoder.Add(0x401000, 2, FLOW_NORMAL);
+    decoder.Add(0x401002, 2, FLOW_CONDITIONAL, 0x401008);
+    decoder.Add(0x401004, 4, FLOW_JUMP, 0x401000);
+    decoder.Add(0x401008, 1, FLOW_RETURN);
+    CHECK(graph.Build(0x401000, 0x401000, 0x401008, decoder));
+}
+
+static void roundTrip(const ControlFlowGraph & graph)
+{
+    remove(cacheFile().c_str());
+    {
+        GraphCache cache;
+        cache.SetDirectory(".");
+        cache.Put(MODULE_HASH, MODULE_BASE, 0x401000, 0x401008, 1, graph);
+    }
+    GraphCache cache;
+    cache.SetDirectory(".");
+    ControlFlowGraph loaded;
+    CHECK(cache.Get(MODULE_HASH, MODULE_BASE, 0x401000, 0x401008, 1, loaded));
+    CHECK(loaded.InstrCount() == graph.InstrCount());
+    CHECK(loaded.NodeCount() == graph.NodeCount());
+    CHECK(!cache.Get(MODULE_HASH, MODULE_BASE, 0x401000, 0x401008, 2, loaded));
+    //a rebased module finds the same graph at its new base
+    CHECK(cache.Get(MODULE_HASH, MODULE_BASE + 0x10000, 0x411000, 0x411008, 1, loaded));
+    CHECK(loaded.Instr(0).addr == 0x411000);
+}
+
+//a valid file followed by a record header with the given sizes and a few bytes of data
+static void writeDamaged(const ControlFlowGraph & graph, unsigned int rawsize, unsigned int storedsize)
+{
+    remove(cacheFile().c_str());
+    {
+        GraphCache cache;
+        cache.SetDirectory(".");
+        cache.Put(MODULE_HASH, MODULE_BASE, 0x401000, 0x401008, 1, graph);
+    }
+    FILE* file = fopen(cacheFile().c_str(), "ab");
+    ULONGLONG header[3] = { 0x1000, 0x1008, 2 };
+    fwrite(header, sizeof(header), 1, file);
+    fwrite(&rawsize, sizeof(rawsize), 1, file);
+    fwrite(&storedsize, sizeof(storedsize), 1, file);
+    fwrite("data", 1, 4, file);
+    fclose(file);
+}
+
+//sizes from a damaged header must not be allocated, the file is dropped
+static void damaged(const ControlFlowGraph & graph)
+{
+    static const unsigned int sizes[][2] =
+    {
+        { 0xFFFFFFF0, 0xFFFFFFF0 }, //far beyond the cap
+        { 0x100, 0x200 }, //stored larger than raw
+        { 0x1000, 0x1000 }, //runs past the end of the file
+    };
+    for(size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        writeDamaged(graph, sizes[i][0], sizes[i][1]);
+        GraphCache cache;
+        cache.SetDirectory(".");
+        ControlFlowGraph loaded;
+        CHECK(!cache.Get(MODULE_HASH, MODULE_BASE, 0x401000, 0x401008, 1, loaded));
+        CHECK(!fileExists(cacheFile()));
+        //the next Put starts a new file
+        cache.Put(MODULE_HASH, MODULE_BASE, 0x401000, 0x401008, 1, graph);
+        CHECK(fileExists(cacheFile()));
+    }
+
+    //a record header cut short by an interrupted append
+    remove(cacheFile().c_str());
+    {
+        GraphCache cache;
+        cache.SetDirectory(".");
+        cache.Put(MODULE_HASH, MODULE_BASE, 0x401000, 0x401008, 1, graph);
+    }
+    FILE* file = fopen(cacheFile().c_str(), "ab");
+    fwrite("short", 1, 5, file);
+    fclose(file);
+    GraphCache cache;
+    cache.SetDirectory(".");
+    ControlFlowGraph loaded;
+    CHECK(!cache.Get(MODULE_HASH, MODULE_BASE, 0x401000, 0x401008, 1, loaded));
+    CHECK(!fileExists(cacheFile()));
+}
+
+//every code hash of a range is a new record, loading keeps the newest few and shrinks the file
+static void compaction(const ControlFlowGraph & graph)
+{
+    remove(cacheFile().c_str());
+    const ULONGLONG versions = 20;
+    {
+        GraphCache cache;
+        cache.SetDirectory(".");
+        for(ULONGLONG codehash = 1; codehash <= versions; codehash++)
+            cache.Put(MODULE_HASH, MODULE_BASE, 0x401000, 0x401008, codehash, graph);
+        cache.Put(MODULE_HASH, MODULE_BASE, 0x402000, 0x402008, 1, graph); //another range keeps its record
+    }
+    long before = fileSize(cacheFile());
+    {
+        GraphCache cache;
+        cache.SetDirectory(".");
+        ControlFlowGraph loaded;
+        CHECK(cache.Get(MODULE_HASH, MODULE_BASE, 0x401000, 0x401008, versions, loaded));
+        CHECK(cache.Get(MODULE_HASH, MODULE_BASE, 0x402000, 0x402008, 1, loaded));
+        CHECK(!cache.Get(MODULE_HASH, MODULE_BASE, 0x401000, 0x401008, 1, loaded));
+    }
+    long after = fileSize(cacheFile());
+    CHECK(after > 0 && after * 3 < before);
+    CHECK(!fileExists(cacheFile() + ".tmp"));
+
+    //the rewritten file loads the same records and is left alone
+    GraphCache cache;
+    cache.SetDirectory(".");
+    ControlFlowGraph loaded;
+    for(ULONGLONG codehash = versions - 3; codehash <= versions; codehash++)
+        CHECK(cache.Get(MODULE_HASH, MODULE_BASE, 0x401000, 0x401008, codehash, loaded));
+    CHECK(!cache.Get(MODULE_HASH, MODULE_BASE, 0x401000, 0x401008, versions - 4, loaded));
+    CHECK(cache.Get(MODULE_HASH, MODULE_BASE, 0x402000, 0x402008, 1, loaded));
+    CHECK(fileSize(cacheFile()) == after);
+    remove(cacheFile().c_str());
+}
+
+int main()
+{
+    ControlFlowGraph graph;
+    buildGraph(graph);
+    roundTrip(graph);
+    damaged(graph);
+    compaction(graph);
+    return unit_result("GraphCacheTest");
+}
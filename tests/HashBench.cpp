@@ -0,0 +1,63 @@
+#include "UnitTest.h"
+#include "Hash.h"
+#include "CpuFeatures.h"
+#include <random>
+#include <string>
+
+static std::string digest(const char* name, const unsigned char* data, size_t len, size_t chunk)
+{
+    HashSet set(name);
+    for(size_t pos = 0; pos < len; pos += chunk)
+        set.Update(data + pos, len - pos < chunk ? len - pos : chunk);
+    char str[HASH_MAX_STRING_SIZE];
+    set.Final(0, str);
+    return str;
+}
+
+static bool known(const char* name, const char* text, const char* expected)
+{
+    std::string result = digest(name, (const unsigned char*)text, strlen(text), 64);
+    return _stricmp(result.c_str(), expected) == 0;
+}
+
+//usage: HashBench [megabytes]
+int main(int argc, char* argv[])
+{
+    size_t size = unit_arg(argc, argv, 256) << 20;
+    std::vector<unsigned char> data(size);
+    std::mt19937 random(1);
+    for(size_t i = 0; i < size; i++)
+        data[i] = (unsigned char)random();
+
+    CHECK(known("adler32", "abc", "024d0127"));
+    CHECK(known("crc32c", "123456789", "e3069283"));
+    CHECK(known("xxhash64", "", "ef46db3751d8e999"));
+    CHECK(known("sha256", "abc", "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"));
+    CHECK(known("md5", "abc", "900150983cd24fb0d6963f7d28e17f72"));
+
+    //the digest must not depend on how the data is split over Update calls
+    size_t chunks[] = { 1, 3, 31, 64, 65, 4096 };
+    for(const hash_algorithm* algorithm = hash_algorithms(); algorithm->name; algorithm++)
+        for(size_t len = 0; len < 600; len += 37)
+        {
+            std::string whole = digest(algorithm->name, data.data() + 1, len, len ? len : 1);
+            for(size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++)
+                CHECK(digest(algorithm->name, data.data() + 1, len, chunks[i]) == whole);
+        }
+
+    const cpu_features & features = cpu_get_features();
+    printf("cpu: sse2 %d, sse4.2 %d, avx2 %d, sha %d\n", features.sse2, features.sse42, features.avx2, features.sha);
+    for(const hash_algorithm* algorithm = hash_algorithms(); algorithm->name; algorithm++)
+    {
+        UnitTimer timer;
+        std::string result = digest(algorithm->name, data.data(), size, 0x100000);
+        printf("%-10s %6.2f GB/s %s\n", algorithm->name, size / timer.Seconds() / 1e9, result.c_str());
+    }
+    //one pass over the data for every algorithm, what the hash commands do
+    HashSet all;
+    UnitTimer timer;
+    for(size_t pos = 0; pos < size; pos += 0x100000)
+        all.Update(data.data() + pos, size - pos < 0x100000 ? size - pos : 0x100000);
+    printf("%-10s %6.2f GB/s\n", "all", size / timer.Seconds() / 1e9);
+    return unit_result("Hash");
+}
@@ -0,0 +1,107 @@
+#include "UnitTest.h"
+#include "LeaderBitmap.h"
+#include <algorithm>
+#include <random>
+#include <set>
+
+#define RANGE_START 0x10000000
+
+//usage: LeaderBitmapBench [megabytes]
+int main(int argc, char* argv[])
+{
+    size_t size = unit_arg(argc, argv, 64) << 20;
+    ULONG_PTR start = RANGE_START;
+    ULONG_PTR end = RANGE_START + size - 1;
+
+    //branch targets cluster in code, every eighth megabyte stays empty like padding between sections
+    std::mt19937 random(1);
+    std::vector<ULONG_PTR> leaders;
+    for(ULONG_PTR addr = start; addr <= end; addr += 1 + random() % 48)
+        if(((addr - start) >> 20) % 8 != 7)
+            leaders.push_back(addr);
+    std::shuffle(leaders.begin(), leaders.end(), random);
+
+    //edge cases first: range ends, addresses outside of it, duplicates
+    {
+        LeaderBitmap bitmap(start, start + 0x2FFF);
+        CHECK(!bitmap.Set(start - 1));
+        CHECK(!bitmap.Set(start + 0x3000));
+        CHECK(bitmap.Set(start));
+        CHECK(!bitmap.Set(start));
+        CHECK(bitmap.Set(start + 0x2FFF));
+        CHECK(bitmap.Test(start) && bitmap.Test(start + 0x2FFF) && !bitmap.Test(start + 1));
+        ULONG_PTR found = 0;
+        CHECK(bitmap.Next(start + 1, found) && found == start + 0x2FFF);
+        CHECK(!bitmap.Next(start + 0x3000, found));
+        CHECK(bitmap.Count() == 2);
+        bitmap.Reset(start, start + 0x2FFF);
+        CHECK(bitmap.Count() == 0 && !bitmap.Test(start));
+    }
+
+    //the whole user address space, as in graph 10000,7FFFFFFFFFFF: only the directories that get a bit cost memory
+    {
+        ULONG_PTR top = sizeof(ULONG_PTR) == 8 ? (ULONG_PTR)0x7FFFFFFFFFFFULL : 0x7FFFFFFF;
+        LeaderBitmap bitmap(0x10000, top);
+        CHECK(bitmap.Set(0x10000));
+        CHECK(bitmap.Set(top - 0x1000000 + 1));
+        CHECK(bitmap.Set(top));
+        CHECK(!bitmap.Test(0x10001) && !bitmap.Test(top - 1));
+        ULONG_PTR found = 0;
+        CHECK(bitmap.Next(0x10001, found) && found == top - 0x1000000 + 1);
+        CHECK(bitmap.Next(found + 1, found) && found == top);
+        CHECK(bitmap.Next(0, found) && found == 0x10000);
+        CHECK(bitmap.Count() == 3);
+    }
+
+    UnitTimer setTimer;
+    std::set<ULONG_PTR> set;
+    for(size_t i = 0; i < leaders.size(); i++)
+        set.insert(leaders[i]);
+    double setInsert = setTimer.Seconds();
+    UnitTimer bitmapTimer;
+    LeaderBitmap bitmap(start, end);
+    for(size_t i = 0; i < leaders.size(); i++)
+        bitmap.Set(leaders[i]);
+    double bitmapInsert = bitmapTimer.Seconds();
+    CHECK(bitmap.Count() == set.size());
+
+    //the second make_flowchart pass: one lookup per 4 byte instruction
+    setTimer = UnitTimer();
+    size_t setHits = 0;
+    for(ULONG_PTR addr = start; addr <= end; addr += 4)
+        setHits += set.find(addr) != set.end();
+    double setLookup = setTimer.Seconds();
+    bitmapTimer = UnitTimer();
+    size_t bitmapHits = 0;
+    for(ULONG_PTR addr = start; addr <= end; addr += 4)
+        bitmapHits += bitmap.Test(addr);
+    double bitmapLookup = bitmapTimer.Seconds();
+    CHECK(setHits == bitmapHits);
+
+    //walking the leaders in order
+    setTimer = UnitTimer();
+    ULONGLONG setSum = 0;
+    for(std::set<ULONG_PTR>::const_iterator i = set.begin(); i != set.end(); ++i)
+        setSum += *i;
+    double setWalk = setTimer.Seconds();
+    bitmapTimer = UnitTimer();
+    ULONGLONG bitmapSum = 0;
+    size_t walked = 0;
+    ULONG_PTR found = 0;
+    for(ULONG_PTR addr = start; bitmap.Next(addr, found); addr = found + 1)
+    {
+        bitmapSum += found;
+        walked++;
+        if(found == end)
+            break;
+    }
+    double bitmapWalk = bitmapTimer.Seconds();
+    CHECK(walked == set.size());
+    CHECK(bitmapSum == setSum);
+
+    printf("%zu MB range, %zu leaders\n", size >> 20, set.size());
+    printf("            %10s %10s %10s\n", "insert", "lookup", "walk");
+    printf("std::set     %8.1fms %8.1fms %8.1fms\n", setInsert * 1000, setLookup * 1000, setWalk * 1000);
+    printf("LeaderBitmap %8.1fms %8.1fms %8.1fms\n", bitmapInsert * 1000, bitmapLookup * 1000, bitmapWalk * 1000);
+    return unit_result("LeaderBitmap");
+}
@@ -0,0 +1,74 @@
+#include "UnitTest.h"
+#include "MemDiff.h"
+#include <random>
+
+//byte by byte reference of mem_diff
+static void bruteDiff(const std::vector<unsigned char> & a, const std::vector<unsigned char> & b, size_t mergeGap, DIFFLIST & ranges)
+{
+    for(size_t i = 0; i < a.size();)
+    {
+        if(a[i] == b[i])
+        {
+            i++;
+            continue;
+        }
+        size_t end = i;
+        while(end < a.size() && a[end] != b[end])
+            end++;
+        if(!ranges.empty() && i - ranges.back().second < mergeGap)
+            ranges.back().second = end;
+        else
+            ranges.push_back(std::make_pair(i, end));
+        i = end;
+    }
+}
+
+static size_t bruteScan(const std::vector<unsigned char> & a, const std::vector<unsigned char> & b, size_t offset, bool equal)
+{
+    for(size_t i = offset; i < a.size(); i++)
+        if((a[i] == b[i]) == equal)
+            return i - offset;
+    return a.size() - offset;
+}
+
+//b is a copy of a with some bytes changed, the density decides how long the equal and different runs are
+static void crossCheck(std::mt19937 & random, size_t size, unsigned int density)
+{
+    std::vector<unsigned char> a(size), b(size);
+    for(size_t i = 0; i < size; i++)
+    {
+        a[i] = (unsigned char)random();
+        b[i] = random() % 100 < density ? (unsigned char)(a[i] + 1 + random() % 255) : a[i];
+    }
+    //every start offset, so the vector loops see every alignment and tail length
+    bool same = true;
+    for(size_t offset = 0; offset < size && offset < 130; offset++)
+    {
+        same &= mem_mismatch(&a[offset], &b[offset], size - offset) == bruteScan(a, b, offset, false);
+        same &= mem_match(&a[offset], &b[offset], size - offset) == bruteScan(a, b, offset, true);
+    }
+    CHECK(same);
+    static const size_t gaps[] = { 0, 1, 8, 100 };
+    for(size_t g = 0; g < sizeof(gaps) / sizeof(gaps[0]); g++)
+    {
+        DIFFLIST ranges(1, std::make_pair((size_t)-1, (size_t)-1)), expected;
+        mem_diff(a.data(), b.data(), size, gaps[g], ranges);
+        bruteDiff(a, b, gaps[g], expected);
+        //ranges already in the list are left alone and never merged with
+        CHECK(ranges.size() == expected.size() + 1);
+        CHECK(ranges[0].first == (size_t)-1 && ranges[0].second == (size_t)-1);
+        ranges.erase(ranges.begin());
+        CHECK(ranges == expected);
+    }
+}
+
+int main()
+{
+    std::mt19937 random(1);
+    static const size_t sizes[] = { 0, 1, 7, 8, 15, 16, 31, 32, 63, 64, 65, 200, 4096, 100000 };
+    static const unsigned int densities[] = { 0, 1, 10, 50, 99, 100 };
+    for(size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+        for(size_t d = 0; d < sizeof(densities) / sizeof(densities[0]); d++)
+            crossCheck(random, sizes[s], densities[d]);
+    return unit_result("MemDiffTest");
+}
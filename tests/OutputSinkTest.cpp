@@ -0,0 +1,237 @@
+#include "UnitTest.h"
+#include "FunctionGraph.h"
+#include "TestDecoders.h"
+#include <string>
+
+//the golden files are written by a 64 bit build, pointers are 16 digits
+static bool golden(const std::string & text, const char* name)
+{
+    std::string path = std::string(GOLDEN_DIR) + "/" + name;
+    if(sizeof(ULONG_PTR) != 8)
+    {
+        printf("%s: skipped on 32 bit\n", name);
+        return true;
+    }
+    std::string expected;
+    FILE* file = fopen(path.c_str(), "rb");
+    if(file)
+    {
+        char buffer[4096];
+        size_t len;
+        while((len = fread(buffer, 1, sizeof(buffer), file)) != 0)
+            expected.append(buffer, len);
+        fclose(file);
+    }
+    if(text == expected)
+        return true;
+    //leave the actual output next to the test binary for diffing
+    std::string actual = std::string(name) + ".actual";
+    file = fopen(actual.c_str(), "wb");
+    if(file)
+    {
+        fwrite(text.data(), 1, text.size(), file);
+        fclose(file);
+    }
+    printf("%s differs from %s, see %s\n", name, path.c_str(), actual.c_str());
+    return false;
+}
+
+class FailingSink : public OutputSink
+{
+public:
+    FailingSink() : writes(0) {}
+    bool Write(const void*, size_t)
+    {
+        writes++;
+        return false;
+    }
+
+    size_t writes;
+};
+
+class CountingSink : public OutputSink
+{
+public:
+    CountingSink() : writes(0) {}
+    bool Write(const void* data, size_t size)
+    {
+        writes++;
+        return memory.Write(data, size);
+    }
+
+    size_t writes;
+    MemorySink memory;
+};
+
+static void formatting()
+{
+    MemorySink sink;
+    {
+        BufferedWriter out(sink);
+        out.Pointer(0x401000);
+        out.Putc(' ');
+        out.Pointer(0);
+        out.Putc(' ');
+        out.Decimal(0);
+        out.Putc(' ');
+        out.Decimal(1234567890);
+        out.Putc(' ');
+        out.Printf("%s=%d", "x", -5);
+        out.Puts("\n");
+        CHECK(sink.Data().empty()); //nothing reaches the sink before a flush
+    }
+    std::string expected = sizeof(ULONG_PTR) == 8 ? "0000000000401000 0000000000000000" : "00401000 00000000";
+    expected += " 0 1234567890 x=-5\n";
+    CHECK(sink.Data() == expected);
+}
+
+//small writes are gathered, writes larger than the buffer go straight to the sink in order
+static void buffering()
+{
+    CountingSink sink;
+    std::string expected;
+    {
+        BufferedWriter out(sink, 16);
+        for(int i = 0; i < 10; i++)
+        {
+            out.Puts("abcde");
+            expected += "abcde";
+        }
+        std::string big(40, 'x');
+        out.Write(big.c_str(), big.size());
+        expected += big;
+        out.Putc('!');
+        expected += '!';
+        CHECK(out.Flush());
+        CHECK(!out.Failed());
+    }
+    CHECK(sink.memory.Data() == expected);
+    CHECK(sink.writes == 6); //three full buffers, the pending bytes before the big write, the big write and the last flush
+}
+
+static void failure()
+{
+    FailingSink sink;
+    BufferedWriter out(sink, 16);
+    out.Puts("0123456789");
+    out.Puts("0123456789");
+    CHECK(out.Failed());
+    out.Puts("0123456789");
+    out.Puts("0123456789");
+    CHECK(!out.Flush());
+    CHECK(sink.writes == 1); //no more writes once one failed
+}
+
+static void stdio()
+{
+    FILE* file = tmpfile();
+    CHECK(file != 0);
+    if(!file)
+        return;
+    StdioSink sink(file);
+    {
+        BufferedWriter out(sink, 8);
+        out.Puts("graph: {\n");
+        out.Decimal(42);
+        out.Puts("\n}\n");
+    }
+    fflush(file);
+    rewind(file);
+    char text[64] = "";
+    size_t len = fread(text, 1, sizeof(text) - 1, file);
+    text[len] = '\0';
+    CHECK(strcmp(text, "graph: {\n42\n}\n") == 0);
+    fclose(file);
+}
+
+//a loop with a conditional exit, a comment that needs escaping and a jump back
+static ULONG_PTR fakeInstrInfo(ULONG_PTR addr, instr_info* info)
+{
+    static const struct
+    {
+        ULONG_PTR addr;
+        ULONG_PTR jmpaddr;
+        const char* text;
+        const char* comment;
+    } code[] =
+    {
+        { 0x401000, 0, "push rbp", "" },
+        { 0x401001, 0, "mov rbp, rsp", "" },
+        { 0x401004, 0, "xor eax, eax", "" },
+        { 0x401006, 0, "cmp byte ptr ds:[rcx+rax], 0", "\"text\" in C:\\dir" },
+        { 0x40100A, 0x401011, "je 0x401011", "" },
+        { 0x40100C, 0, "inc rax", "" },
+        { 0x40100F, 0x401006, "jmp 0x401006", "" },
+        { 0x401011, 0, "pop rbp", "" },
+        { 0x401012, 0, "ret", "" },
+    };
+    for(size_t i = 0; i < sizeof(code) / sizeof(code[0]); i++)
+        if(code[i].addr == addr)
+        {
+            info->addr = addr;
+            info->jmpaddr = code[i].jmpaddr;
+            strcpy(info->instrText, code[i].text);
+            strcpy(info->comment, code[i].comment);
+            return i + 1 < sizeof(code) / sizeof(code[0]) ? code[i + 1].addr : addr + 1;
+        }
+    info->addr = addr;
+    info->jmpaddr = 0;
+    strcpy(info->instrText, "???");
+    return addr + 1;
+}
+
+class FakeDecoder : public CodeDecoder
+{
+public:
+    bool Decode(ULONG_PTR addr, cfg_instr & instr)
+    {
+        instr_info info;
+        ULONG_PTR next = fakeInstrInfo(addr, &info);
+        if(!strcmp(info.instrText, "???"))
+            return false;
+        instr.addr = addr;
+        instr.size = (unsigned int)(next - addr);
+        instr.target = info.jmpaddr;
+        instr.table = 0;
+        if(!strncmp(info.instrText, "jmp", 3))
+            instr.flow = FLOW_JUMP;
+        else if(info.instrText[0] == 'j')
+            instr.flow = FLOW_CONDITIONAL;
+        else if(!strcmp(info.instrText, "ret"))
+            instr.flow = FLOW_RETURN;
+        else
+            instr.flow = FLOW_NORMAL;
+        return true;
+    }
+};
+
+static void flowchart()
+{
+    MemorySink sink;
+    CHECK(make_flowchart(0x401000, 0x401012, sink, fakeInstrInfo));
+    CHECK(golden(sink.Data(), "flowchart.vcg"));
+
+    ControlFlowGraph graph;
+    FakeDecoder decoder;
+    CHECK(graph.Build(0x401000, 0x401000, 0x401012, decoder));
+    InstrList disasmlist;
+    for(size_t i = 0; i < graph.InstrCount(); i++)
+    {
+        instr_info info;
+        fakeInstrInfo(graph.Instr(i).addr, &info);
+        disasmlist.Add(info.addr, info.jmpaddr, info.instrText, info.comment);
+    }
+    MemorySink graphSink;
+    CHECK(make_flowchart(graph, disasmlist, graphSink));
+    CHECK(golden(graphSink.Data(), "controlflow.vcg"));
+}
+
+int main()
+{
+    formatting();
+    buffering();
+    failure();
+    stdio();
+    flowchart();
+    return unit_result("OutputSink");
+}
@@ -0,0 +1,116 @@
+#include "UnitTest.h"
+#include "PatternSet.h"
+#include <algorithm>
+#include <random>
+
+//a few byte values that show up often, so short patterns match all over the data
+static const unsigned char alphabet[] = { 0x00, 0x48, 0x8B, 0xE8, 0x45, 0x54 };
+
+static unsigned char randomByte(std::mt19937 & random)
+{
+    return random() % 4 ? alphabet[random() % sizeof(alphabet)] : (unsigned char)random();
+}
+
+//text form of a random signature with whole and half wildcards
+static std::string randomPattern(std::mt19937 & random)
+{
+    std::string pattern;
+    size_t length = 1 + random() % 12;
+    for(size_t i = 0; i < length; i++)
+    {
+        char text[4];
+        unsigned char value = randomByte(random);
+        switch(random() % 8)
+        {
+        case 0:
+            strcpy(text, "??");
+            break;
+        case 1:
+            sprintf(text, "%X?", value >> 4);
+            break;
+        case 2:
+            sprintf(text, "?%X", value & 15);
+            break;
+        default:
+            sprintf(text, "%02X", value);
+            break;
+        }
+        if(i)
+            pattern += ' ';
+        pattern += text;
+    }
+    return pattern;
+}
+
+static bool before(const pattern_match & a, const pattern_match & b)
+{
+    return a.offset != b.offset ? a.offset < b.offset : a.pattern < b.pattern;
+}
+
+//every pattern compared at every offset
+static void bruteScan(const std::vector<Signature> & signatures, const std::vector<int> & indices, const std::vector<unsigned char> & data, std::vector<pattern_match> & matches)
+{
+    for(size_t p = 0; p < signatures.size(); p++)
+    {
+        if(indices[p] < 0)
+            continue;
+        for(size_t i = 0; i + signatures[p].Size() <= data.size(); i++)
+            if(signatures[p].Match(&data[i]))
+            {
+                pattern_match match = { i, (unsigned int)indices[p] };
+                matches.push_back(match);
+            }
+    }
+}
+
+//random pattern sets against random data, small buffers take the single lane path and large ones the four lane one
+static void crossCheck(std::mt19937 & random, size_t patternCount, size_t size)
+{
+    PatternSet set;
+    std::vector<Signature> signatures(patternCount);
+    std::vector<int> indices(patternCount);
+    for(size_t p = 0; p < patternCount; p++)
+    {
+        std::string pattern = randomPattern(random);
+        CHECK(signatures[p].Compile(pattern.c_str()));
+        indices[p] = set.Add(pattern.c_str());
+        bool known = false;
+        for(size_t i = 0; i < signatures[p].Size(); i++)
+            known |= signatures[p].Known(i);
+        CHECK((indices[p] >= 0) == known); //only patterns without a whole known byte are refused
+    }
+    set.Build();
+
+    std::vector<unsigned char> data(size);
+    for(size_t i = 0; i < size; i++)
+        data[i] = randomByte(random);
+    std::vector<pattern_match> matches, expected;
+    set.Scan(data.data(), data.size(), matches);
+    bruteScan(signatures, indices, data, expected);
+    std::sort(matches.begin(), matches.end(), before);
+    std::sort(expected.begin(), expected.end(), before);
+    CHECK(matches.size() == expected.size());
+    bool same = matches.size() == expected.size();
+    for(size_t i = 0; same && i < matches.size(); i++)
+        same = matches[i].offset == expected[i].offset && matches[i].pattern == expected[i].pattern;
+    CHECK(same);
+}
+
+int main()
+{
+    std::mt19937 random(1);
+    PatternSet empty;
+    empty.Build();
+    std::vector<pattern_match> matches;
+    empty.Scan(alphabet, sizeof(alphabet), matches);
+    CHECK(matches.empty());
+    PatternSet invalid;
+    CHECK(invalid.Add("48 8G") == -1);
+    CHECK(invalid.Add("?? ??") == -1);
+
+    static const size_t sizes[] = { 0, 1, 7, 100, 0x3FFF, 0x4000, 0x4003, 0x10001, 0x40000 };
+    for(size_t round = 0; round < 4; round++)
+        for(size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+            crossCheck(random, 1 + random() % 64, sizes[s]);
+    return unit_result("PatternSetTest");
+}
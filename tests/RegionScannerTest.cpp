@@ -0,0 +1,154 @@
+#include "UnitTest.h"
+#include "RegionScanner.h"
+#include <atomic>
+#include <map>
+#include <mutex>
+
+#define TEST_CHUNK_SIZE 0x1000
+#define TEST_PATTERN_SIZE 3
+
+//mock memory source, every address has a fixed value out of four so the pattern is common
+static unsigned char memoryAt(ULONG_PTR addr)
+{
+    ULONG_PTR x = addr * 0x9E3779B1;
+    return (unsigned char)((x >> 15) & 3);
+}
+
+static bool patternAt(const unsigned char* data)
+{
+    return data[0] == 1 && data[1] == 2 && data[2] == 3;
+}
+
+//matches of the pattern that lie completely inside the region
+static size_t bruteMatches(const memory_region & region)
+{
+    size_t count = 0;
+    for(ULONG_PTR i = 0; i + TEST_PATTERN_SIZE <= region.size; i++)
+    {
+        unsigned char data[TEST_PATTERN_SIZE];
+        for(size_t j = 0; j < TEST_PATTERN_SIZE; j++)
+            data[j] = memoryAt(region.base + i + j);
+        if(patternAt(data))
+            count++;
+    }
+    return count;
+}
+
+static void scan(const std::vector<memory_region> & regions, size_t workers, size_t overlap)
+{
+    std::atomic<size_t> reads(0);
+    RegionScanner scanner([&reads](ULONG_PTR addr, unsigned char* data, size_t size)
+    {
+        for(size_t i = 0; i < size; i++)
+            data[i] = memoryAt(addr + i);
+        reads++;
+    }, TEST_CHUNK_SIZE, overlap, workers);
+    CHECK(scanner.Workers() == workers);
+
+    std::mutex lock;
+    std::map<ULONG_PTR, size_t> coverage; //address -> times a chunk kept it
+    std::vector<size_t> matches(regions.size(), 0);
+    std::vector<size_t> chunksPerWorker(workers, 0);
+    std::vector<size_t> donePerWorker(workers, 0);
+    bool badData = false;
+    bool badBounds = false;
+    scan_stats stats = scanner.Run(regions, [&](const scan_chunk & chunk, size_t worker)
+    {
+        const memory_region & region = regions[chunk.region];
+        bool bounds = chunk.base >= region.base && chunk.base + chunk.size <= region.base + region.size && chunk.keep <= chunk.size;
+        bool last = chunk.base + chunk.size == region.base + region.size;
+        //only the last chunk of a region comes without the full overlap
+        if(last ? chunk.keep != chunk.size : chunk.keep != TEST_CHUNK_SIZE || chunk.size != TEST_CHUNK_SIZE + overlap)
+            bounds = false;
+        bool data = true;
+        for(size_t i = 0; i < chunk.size; i++)
+            if(chunk.data[i] != memoryAt(chunk.base + i))
+                data = false;
+        //a match belongs to the chunk it starts in, the overlap completes the ones crossing the end
+        size_t found = 0;
+        for(size_t i = 0; i < chunk.keep && i + TEST_PATTERN_SIZE <= chunk.size; i++)
+            if(patternAt(chunk.data + i))
+                found++;
+        std::lock_guard<std::mutex> guard(lock);
+        if(!bounds)
+            badBounds = true;
+        if(!data)
+            badData = true;
+        if(worker < workers)
+            chunksPerWorker[worker]++;
+        else
+            badBounds = true;
+        matches[chunk.region] += found;
+        for(size_t i = 0; i < chunk.keep; i++)
+            coverage[chunk.base + i]++;
+    }, [&](size_t worker)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        donePerWorker[worker]++;
+    });
+
+    CHECK(!badData);
+    CHECK(!badBounds);
+    ULONGLONG total = 0;
+    size_t chunks = 0;
+    bool once = true;
+    for(size_t i = 0; i < regions.size(); i++)
+    {
+        const memory_region & region = regions[i];
+        total += region.size;
+        chunks += region.size ? (size_t)((region.size - (region.size > overlap ? overlap : 0) + TEST_CHUNK_SIZE - 1) / TEST_CHUNK_SIZE) : 0;
+        for(ULONG_PTR addr = region.base; addr < region.base + region.size; addr++)
+        {
+            std::map<ULONG_PTR, size_t>::const_iterator found = coverage.find(addr);
+            if(found == coverage.end() || found->second != 1)
+                once = false;
+        }
+        //with enough overlap every match crossing a chunk end is found exactly once
+        if(overlap >= TEST_PATTERN_SIZE - 1)
+            CHECK(matches[i] == bruteMatches(region));
+        else
+            CHECK(matches[i] <= bruteMatches(region));
+    }
+    CHECK(once);
+    CHECK(coverage.size() == total);
+    CHECK(stats.bytes == total);
+    CHECK(stats.chunks == chunks);
+    CHECK(reads == stats.chunks);
+    size_t processed = 0;
+    for(size_t i = 0; i < workers; i++)
+    {
+        processed += chunksPerWorker[i];
+        CHECK(donePerWorker[i] == 1);
+    }
+    CHECK(processed == stats.chunks);
+}
+
+int main()
+{
+    std::vector<memory_region> regions;
+    memory_region region;
+    //a single page, exact multiples of the chunk, odd sizes and a tail shorter than the overlap
+    region.base = 0x10000;
+    region.size = 0x1000;
+    regions.push_back(region);
+    region.base = 0x400000;
+    region.size = 0x12345;
+    regions.push_back(region);
+    region.base = 0x7F0000;
+    region.size = 0x8000;
+    regions.push_back(region);
+    region.base = 0x1000000;
+    region.size = 0x3001;
+    regions.push_back(region);
+    region.base = 0x2000000;
+    region.size = 0x10;
+    regions.push_back(region);
+
+    for(size_t workers = 1; workers <= 4; workers++)
+    {
+        scan(regions, workers, 0);
+        scan(regions, workers, TEST_PATTERN_SIZE - 1);
+        scan(regions, workers, 0x20);
+    }
+    return unit_result("RegionScanner");
+}
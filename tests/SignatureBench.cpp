@@ -0,0 +1,82 @@
+#include "UnitTest.h"
+#include "Signature.h"
+#include "CpuFeatures.h"
+#include <algorithm>
+#include <random>
+
+//byte by byte compare of the whole pattern at every offset
+static void naiveFindAll(const Signature & signature, const unsigned char* data, size_t size, std::vector<size_t> & matches)
+{
+    for(size_t i = 0; i + signature.Size() <= size; i++)
+        if(signature.Match(data + i))
+            matches.push_back(i);
+}
+
+static void plant(std::vector<unsigned char> & data, const Signature & signature, std::mt19937 & random, size_t count)
+{
+    for(size_t n = 0; n < count; n++)
+    {
+        size_t offset = random() % (data.size() - signature.Size());
+        for(size_t i = 0; i < signature.Size(); i++)
+            if(signature.Known(i))
+                data[offset + i] = signature.Byte(i);
+    }
+}
+
+//usage: SignatureBench [megabytes]
+int main(int argc, char* argv[])
+{
+    size_t size = unit_arg(argc, argv, 1024) << 20;
+    std::vector<unsigned char> data(size);
+    std::mt19937 random(1);
+    //mostly zeroes and common opcodes like real images, so the anchors matter
+    for(size_t i = 0; i < size; i++)
+    {
+        unsigned int r = random() % 100;
+        data[i] = r < 30 ? 0 : r < 40 ? 0x48 : r < 45 ? 0x8B : r < 48 ? 0xFF : (unsigned char)random();
+    }
+
+    const char* patterns[] =
+    {
+        "48 8B ?? ?? 4? E8",
+        "E8 ?? ?? ?? ?? 48 8B 0D",
+        "0F 1F 44 00 00",
+        "?? ?? 5? C3",
+        "CC",
+        "00 00",
+    };
+    Signature invalid;
+    CHECK(!invalid.Compile("48 8G"));
+    CHECK(!invalid.Compile(""));
+
+    const cpu_features & features = cpu_get_features();
+    printf("kernel: %s\n", features.avx2 ? "avx2" : features.sse2 ? "sse2" : "scalar");
+    size_t checked = size < (16 << 20) ? size : 16 << 20; //the naive scan is slow, it checks a prefix
+    for(size_t p = 0; p < sizeof(patterns) / sizeof(patterns[0]); p++)
+    {
+        Signature signature;
+        CHECK(signature.Compile(patterns[p]));
+        plant(data, signature, random, 1000);
+
+        std::vector<size_t> expected;
+        naiveFindAll(signature, data.data(), checked, expected);
+        std::vector<size_t> found;
+        signature.FindAll(data.data(), checked, found);
+        CHECK(found == expected);
+        //Find from every position near the start, and the limit of FindAll
+        for(size_t pos = 0; pos < 300; pos++)
+        {
+            std::vector<size_t>::const_iterator next = std::lower_bound(expected.begin(), expected.end(), pos);
+            CHECK(signature.Find(data.data(), checked, pos) == (next == expected.end() ? checked : *next));
+        }
+        std::vector<size_t> limited;
+        CHECK(signature.FindAll(data.data(), checked, limited, 10) == (expected.size() < 10 ? expected.size() : 10));
+
+        std::vector<size_t> matches;
+        UnitTimer timer;
+        signature.FindAll(data.data(), size, matches);
+        double seconds = timer.Seconds();
+        printf("%-26s %6.2f GB/s %10zu matches\n", patterns[p], size / seconds / 1e9, matches.size());
+    }
+    return unit_result("Signature");
+}
@@ -0,0 +1,47 @@
+#ifndef _TESTDECODERS_H
+#define _TESTDECODERS_H
+
+#include "ControlFlow.h"
+#include <vector>
+
+//decoders of the synthetic code in the tests, none of it has jump tables
+class CodeDecoder : public InstrDecoder
+{
+public:
+    bool ReadPointer(ULONG_PTR, ULONG_PTR &)
+    {
+        return false;
+    }
+};
+
+//decoder over a fixed instruction table
+class TableDecoder : public CodeDecoder
+{
+public:
+    void Add(ULONG_PTR addr, unsigned int size, cfg_flow flow, ULONG_PTR target = 0)
+    {
+        cfg_instr instr;
+        instr.addr = addr;
+        instr.target = target;
+        instr.table = 0;
+        instr.size = size;
+        instr.flow = flow;
+        instrs.push_back(instr);
+    }
+
+    bool Decode(ULONG_PTR addr, cfg_instr & instr)
+    {
+        for(size_t i = 0; i < instrs.size(); i++)
+            if(instrs[i].addr == addr)
+            {
+                instr = instrs[i];
+                return true;
+            }
+        return false;
+    }
+
+private:
+    std::vector<cfg_instr> instrs;
+};
+
+#endif //_TESTDECODERS_H
@@ -0,0 +1,38 @@
+#ifndef _UNITTEST_H
+#define _UNITTEST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+
+//every test program is a single main that counts failed checks
+static int unit_failures = 0;
+
+#define CHECK(x) do { if(!(x)) { printf("%s(%d): CHECK(%s) failed\n", __FILE__, __LINE__, #x); unit_failures++; } } while(0)
+
+inline int unit_result(const char* name)
+{
+    if(unit_failures)
+        printf("%s: %d checks failed\n", name, unit_failures);
+    else
+        printf("%s: ok\n", name);
+    return unit_failures ? 1 : 0;
+}
+
+//benchmarks take an optional size argument so ctest can run them small
+inline size_t unit_arg(int argc, char* argv[], size_t fallback)
+{
+    return argc > 1 ? (size_t)strtoull(argv[1], 0, 0) : fallback;
+}
+
+class UnitTimer
+{
+public:
+    UnitTimer() : start(std::chrono::steady_clock::now()) {}
+    double Seconds() const { return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(); }
+
+private:
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif //_UNITTEST_H
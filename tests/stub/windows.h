@@ -0,0 +1,33 @@
+#ifndef _STUB_WINDOWS_H
+#define _STUB_WINDOWS_H
+
+//just enough of windows.h to build the portable modules on other platforms
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+
+typedef uintptr_t ULONG_PTR;
+typedef uint32_t DWORD;
+typedef int BOOL;
+typedef long LONG;
+typedef unsigned long long ULONGLONG;
+typedef unsigned char BYTE;
+typedef unsigned short WORD;
+
+#define _stricmp strcasecmp
+#define _strnicmp strncasecmp
+
+typedef struct _IMAGE_BASE_RELOCATION
+{
+    DWORD VirtualAddress;
+    DWORD SizeOfBlock;
+} IMAGE_BASE_RELOCATION;
+
+#define IMAGE_REL_BASED_ABSOLUTE 0
+#define IMAGE_REL_BASED_HIGH 1
+#define IMAGE_REL_BASED_LOW 2
+#define IMAGE_REL_BASED_HIGHLOW 3
+#define IMAGE_REL_BASED_HIGHADJ 4
+#define IMAGE_REL_BASED_DIR64 10
+
+#endif //_STUB_WINDOWS_H